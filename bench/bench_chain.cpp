@@ -0,0 +1,154 @@
+/* Chain scaling benchmarks: the main.cpp chain with n mobilized bodies.
+   Build and run with `make bench`; results go to bench_<mode>-<blas>.json. */
+#include "Dynamics_System.hpp"
+#include "Alloc_Counter.hpp"
+#include <benchmark/benchmark.h>
+#include <boost/make_shared.hpp>
+
+/* Solver state the public interface does not expose */
+struct Bench_Access {
+    static arma::vec &SYS_ANS(Dynamics_Sys &Sys_In) { return Sys_In.SYS_ANS; }
+    static void Update_Kinematics(Dynamics_Sys &Sys_In, const arma::vec &qIn) { Sys_In.Update_Kinematics(qIn); }
+};
+
+namespace {
+
+struct Chain {
+    DynSysPtr sys;
+    std::vector<BodyPtr> bodies;
+    std::vector<JointPtr> joints;
+};
+
+Chain build_chain(unsigned int n_body, Solver_Type solver) {
+    Chain chain;
+    arma::vec pi = {0., 0., 0.};
+    arma::vec pj = {-1., 0., 0.};
+    arma::vec zero = {0., 0., 0.};
+    arma::vec ANG1 = {0., -3. * 3.1415926 / 180.0, 0.};
+    arma::vec I = {1., 1., 1.};
+    arma::vec F = {0., 0., 9.8};
+    BodyPtr prev, now;
+
+    chain.sys = boost::make_shared<Dynamics_Sys>(0.001);
+    chain.sys->set_solver(solver);
+    prev = chain.sys->Create<Ground>(0);
+    chain.bodies.push_back(prev);
+    for (unsigned int i = 1; i <= n_body; i++) {
+        now = chain.sys->Create<Mobilized_body>(i, zero, zero, zero, (i == 1) ? zero : ANG1, zero, zero, 1.0, I, F, zero);
+        chain.bodies.push_back(now);
+        chain.joints.push_back(chain.sys->Create<Spherical_Joint>(pi, pj, zero, zero, prev, now));
+        prev = now;
+    }
+    chain.sys->Assembly();
+    chain.sys->init();
+    return chain;
+}
+
+/* Steps/sec and heap allocations per iteration */
+void report(benchmark::State &state, unsigned long allocs) {
+    state.counters["steps_per_sec"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+    state.counters["allocs_per_step"] = benchmark::Counter(allocs, benchmark::Counter::kAvgIterations);
+}
+
+void BM_Step(benchmark::State &state) {
+    Chain chain = build_chain(state.range(0), static_cast<Solver_Type>(state.range(1)));
+    unsigned long allocs = 0;
+
+    for (auto _ : state) {
+        chain.sys->solve();
+        allocs += chain.sys->get_step_allocs();
+    }
+    report(state, allocs);
+}
+
+/* Sparse steps with the per-stage loops on the pool, threshold 0 */
+void BM_Step_Threads(benchmark::State &state) {
+    Chain chain = build_chain(state.range(0), SPARSE_SOLVER);
+    unsigned long allocs = 0;
+
+    chain.sys->set_threads(state.range(1), 0);
+    for (auto _ : state) {
+        chain.sys->solve();
+        allocs += chain.sys->get_step_allocs();
+    }
+    report(state, allocs);
+}
+
+void BM_Cal_Constraints(benchmark::State &state) {
+    Chain chain = build_chain(state.range(0), static_cast<Solver_Type>(state.range(1)));
+    unsigned long start = alloc_counter::count();
+
+    for (auto _ : state) chain.sys->Cal_Constraints();
+    report(state, alloc_counter::count() - start);
+}
+
+/* Every iteration starts from the previous step's answer, so the warm-started
+   CG of ITERATIVE_SOLVER sees the same initial guess as in a real step rather
+   than the exact solution left by the last iteration */
+void BM_Solve_System(benchmark::State &state) {
+    Chain chain = build_chain(state.range(0), static_cast<Solver_Type>(state.range(1)));
+    arma::vec &ans = Bench_Access::SYS_ANS(*chain.sys);
+    arma::vec prev_ans;
+    unsigned long start, iters;
+
+    chain.sys->solve();
+    prev_ans = ans;
+    chain.sys->solve();
+    chain.sys->Cal_Constraints();
+    iters = chain.sys->get_iteration_count();
+    start = alloc_counter::count();
+    for (auto _ : state) {
+        ans = prev_ans;
+        chain.sys->Solve_System();
+    }
+    report(state, alloc_counter::count() - start);
+    state.counters["cg_iters"] = benchmark::Counter(chain.sys->get_iteration_count() - iters,
+        benchmark::Counter::kAvgIterations);
+}
+
+void BM_Joint_Update(benchmark::State &state) {
+    Chain chain = build_chain(state.range(0), SPARSE_SOLVER);
+    unsigned long start = alloc_counter::count();
+
+    for (auto _ : state) {
+        for (unsigned int i = 0; i < chain.joints.size(); i++) chain.joints[i]->update();
+    }
+    report(state, alloc_counter::count() - start);
+}
+
+/* Update_Kinematics() as a stage runs it: the batch body update, then every
+   joint. BM_Joint_Update times the joint half alone */
+void BM_Update_Kinematics(benchmark::State &state) {
+    Chain chain = build_chain(state.range(0), SPARSE_SOLVER);
+    const arma::vec q = chain.sys->get_state();
+    unsigned long start = alloc_counter::count();
+
+    for (auto _ : state) Bench_Access::Update_Kinematics(*chain.sys, q);
+    report(state, alloc_counter::count() - start);
+}
+
+/* The dense KKT solve is cubic, so it stops at 100 bodies */
+void solver_args(benchmark::internal::Benchmark *b) {
+    const int sizes[] = {2, 10, 30, 100, 500, 1000};
+
+    for (int n : sizes) {
+        if (n <= 100) b->Args({n, DENSE_SOLVER});
+        b->Args({n, SPARSE_SOLVER});
+        b->Args({n, TREE_SOLVER});
+        b->Args({n, SCHUR_SOLVER});
+        b->Args({n, ITERATIVE_SOLVER});
+    }
+    b->ArgNames({"bodies", "solver"});
+}
+
+}  // namespace
+
+BENCHMARK(BM_Step)->Apply(solver_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Step_Threads)->ArgNames({"bodies", "threads"})->ArgsProduct({{100, 1000, 2000}, {1, 2, 4}})
+    ->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_Cal_Constraints)->Apply(solver_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Solve_System)->Apply(solver_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Joint_Update)->ArgName("bodies")->Arg(2)->Arg(10)->Arg(30)->Arg(100)->Arg(500)->Arg(1000);
+BENCHMARK(BM_Update_Kinematics)->ArgName("bodies")->Arg(2)->Arg(10)->Arg(30)->Arg(100)->Arg(500)->Arg(1000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,78 @@
+/* Checkpoint continuation: a run saved after K steps and continued for
+   N - K steps must end bit for bit where the uninterrupted run ends, for
+   every solver, integrator and joint type. Covered are restore() from a
+   buffer and from a file, restore() with the stored analysis block and
+   load() into a system built with another solver. */
+#include "Dynamics_System.hpp"
+#include "Checkpoint.hpp"
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+DynSysPtr build(Solver_Type solver_In, Joint_Type joint_In) {
+    DynSysPtr sys = boost::make_shared<Dynamics_Sys>(0.001);
+    sys->set_solver(solver_In);
+    arma::vec pi = {0., 0., 0.}, pj = {-1., 0., 0.}, z = {0., 0., 0.}, ax = {0., 1., 0.};
+    arma::vec ANG1 = {0., -30 * 3.1415926 / 180.0, 0.};
+    arma::vec I = {1., 2., 3.}, F = {0., 0., 9.8}, T = {0.1, 0., 0.};
+    arma::vec qi = ax, qj = ax;
+    if (joint_In == UNIVERSAL_JOINT) qj = {0., 0., 1.};
+    if (joint_In == PRISMATIC_JOINT) qi = qj = {1., 0., 1.};
+    BodyPtr prev = sys->Create<Ground>(0), now;
+    for (unsigned int i = 1; i <= 5; i++) {
+        now = sys->Create<Mobilized_body>(i, z, z, z, i == 1 ? z : ANG1, z, z, 1.0, I, F, i == 1 ? T : z);
+        sys->Add(make_joint(joint_In, pi, pj, qi, qj, prev, now));
+        prev = now;
+    }
+    sys->Assembly();
+    return sys;
+}
+
+}
+
+int main() {
+    const char *file = "check_checkpoint.ckpt";
+    const unsigned int N = 250, K = 97;
+    int fail = 0;
+
+    for (unsigned int s = DENSE_SOLVER; s <= ITERATIVE_SOLVER; s++) {
+        for (unsigned int it = RK4_INTEGRATOR; it <= IMPLICIT_EULER_INTEGRATOR; it++) {
+            for (unsigned int jt = SPHERICAL_JOINT; jt <= UNIVERSAL_JOINT; jt++) {
+                DynSysPtr run = build((Solver_Type)s, (Joint_Type)jt);
+                run->set_integrator((Integrator_Type)it);
+                run->set_projection(true, true);
+                run->init();
+                for (unsigned int k = 0; k < K; k++) run->solve();
+
+                std::vector<char> buf, buf_analysis;
+                DynSysPtr loaded = build(s == DENSE_SOLVER ? SPARSE_SOLVER : DENSE_SOLVER, (Joint_Type)jt);
+                bool saved = Checkpoint::save(*run, buf) && Checkpoint::save(*run, buf_analysis, true)
+                    && Checkpoint::save(*run, file);
+                DynSysPtr cont[3] = {Checkpoint::restore(buf), Checkpoint::restore(buf_analysis),
+                    Checkpoint::restore(file)};
+                std::remove(file);
+                if (!saved || !cont[0] || !cont[1] || !cont[2] || !Checkpoint::load(*loaded, buf)) {
+                    std::printf("solver %u integrator %u joint %u: save or restore failed  FAIL\n", s, it, jt);
+                    fail = 1;
+                    continue;
+                }
+
+                for (unsigned int k = K; k < N; k++) {
+                    run->solve();
+                    for (unsigned int c = 0; c < 3; c++) cont[c]->solve();
+                    loaded->solve();
+                }
+                double diff = arma::abs(loaded->get_state() - run->get_state()).max();
+                for (unsigned int c = 0; c < 3; c++) {
+                    diff = std::max(diff, arma::abs(cont[c]->get_state() - run->get_state()).max());
+                }
+                bool ok = diff == 0.0 && loaded->get_time() == run->get_time();
+                std::printf("solver %u integrator %u joint %u: diff %g  %s\n", s, it, jt, diff, ok ? "ok" : "FAIL");
+                if (!ok) fail = 1;
+            }
+        }
+    }
+    return fail;
+}
@@ -0,0 +1,157 @@
+/* Contact narrow phase: depth, normal direction and count of the contacts
+   of posed shape pairs, evaluated by Contact_Force::apply(). The normal must
+   point from body_i to body_j, for a plane from the shape into the plane.
+   A ball dropped on the floor must keep its energy without damping and lose
+   some with it. */
+#include "Contact.hpp"
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+struct Scene {
+    std::vector<BodyPtr> body;
+    ContactPtr contact;
+};
+
+Scene make_scene(const arma::vec &pos_a, const arma::vec &ang_a, const arma::vec &pos_b, const arma::vec &ang_b) {
+    arma::vec z = {0., 0., 0.}, I = {1., 1., 1.};
+    Scene S;
+    S.body.push_back(boost::make_shared<Mobilized_body>(0, z, z, z, ang_a, z, z, 1., I, z, z));
+    S.body.push_back(boost::make_shared<Mobilized_body>(1, z, z, z, ang_b, z, z, 1., I, z, z));
+    /* inertial positions; the constructor takes them in the body frame */
+    S.body[0]->set_POSITION(pos_a);
+    S.body[1]->set_POSITION(pos_b);
+    S.contact = boost::make_shared<Contact_Force>(1e5, 0., 0.);
+    return S;
+}
+
+/* n contacts, each of the given depth, normal along +-axis and pointing
+   from body_i to body_j (into the plane for plane contacts) */
+bool expect(const char *name_In, Scene &S, unsigned int n_In, double depth_In, const arma::vec &axis_In) {
+    std::vector<double> rhs(6 * S.body.size(), 0.0);
+    S.contact->apply(0.0, S.body, rhs.data());
+    const std::vector<Contact> &C = S.contact->get_contacts();
+    bool ok = C.size() == n_In;
+
+    for (unsigned int k = 0; ok && k < C.size(); k++) {
+        arma::vec n = {C[k].normal[0], C[k].normal[1], C[k].normal[2]};
+        arma::vec d = axis_In;
+        if (C[k].body_j != Contact_Force::plane_body) {
+            d = S.body[C[k].body_j]->get_POSITION() - S.body[C[k].body_i]->get_POSITION();
+        }
+        ok = std::fabs(C[k].depth - depth_In) < 1e-12 && std::fabs(std::fabs(arma::dot(n, axis_In)) - 1.0) < 1e-12
+            && arma::dot(n, d) > 0.0 && C[k].force > 0.0;
+    }
+    std::printf("%-24s contacts %u", name_In, (unsigned int)C.size());
+    if (!C.empty()) std::printf("  depth %.6f", C[0].depth);
+    std::printf("  %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/* Mechanical energy per unit mass of a ball dropped from 1 m, after one bounce */
+double drop(double damping_In, double &zmax_Out) {
+    arma::vec z = {0., 0., 0.}, I = {0.1, 0.1, 0.1};
+    DynSysPtr sys = boost::make_shared<Dynamics_Sys>(0.0002);
+    sys->Create<Ground>(0);
+    BodyPtr ball = sys->Create<Mobilized_body>(1, arma::vec{0., 0., 1.}, z, z, z, z, z, 1.0, I, z, z);
+    sys->Create<Gravity_Field>(arma::vec{0., 0., -9.8});
+    ContactPtr c = sys->Create<Contact_Force>(1e5, damping_In, 0.);
+    c->add_sphere(ball, z, 0.2);
+    c->add_plane(arma::vec{0., 0., 1.}, 0.);
+    sys->init();
+
+    /* fall 0.8 m, bounce and rise until the second apex */
+    zmax_Out = 0.0;
+    for (unsigned int k = 0; k < 6000; k++) {
+        sys->solve();
+        if (k > 2500) zmax_Out = std::max(zmax_Out, ball->get_POSITION()(2));
+    }
+    double v = arma::norm(ball->get_VELOCITY());
+    return 0.5 * v * v + 9.8 * ball->get_POSITION()(2);
+}
+
+}
+
+int main() {
+    arma::vec z = {0., 0., 0.}, ex = {1., 0., 0.}, ey = {0., 1., 0.}, ez = {0., 0., 1.};
+    bool ok = true;
+
+    Scene s1 = make_scene(z, z, arma::vec{0.4, 0., 0.}, z);
+    s1.contact->add_sphere(s1.body[0], z, 0.3);
+    s1.contact->add_sphere(s1.body[1], z, 0.2);
+    ok = expect("sphere-sphere", s1, 1, 0.1, ex) && ok;
+
+    Scene s2 = make_scene(z, z, arma::vec{0.6, 0., 0.}, z);
+    s2.contact->add_sphere(s2.body[0], z, 0.3);
+    s2.contact->add_sphere(s2.body[1], z, 0.2);
+    ok = expect("sphere-sphere separated", s2, 0, 0.0, ex) && ok;
+
+    Scene s3 = make_scene(arma::vec{0., 0., 0.15}, z, z, z);
+    s3.contact->add_sphere(s3.body[0], z, 0.2);
+    s3.contact->add_plane(ez, 0.);
+    ok = expect("sphere-plane", s3, 1, 0.05, -ez) && ok;
+
+    /* crossed capsules, axes along x and y, 0.15 apart in z */
+    Scene s4 = make_scene(z, z, arma::vec{0., 0., 0.15}, z);
+    s4.contact->add_capsule(s4.body[0], z, arma::vec{0.5, 0., 0.}, 0.1);
+    s4.contact->add_capsule(s4.body[1], z, arma::vec{0., 0.5, 0.}, 0.1);
+    ok = expect("capsule-capsule", s4, 1, 0.05, ez) && ok;
+
+    /* capsule lying on a sphere: the body order is reversed by shape type */
+    Scene s5 = make_scene(arma::vec{0.2, 0., 0.35}, z, z, z);
+    s5.contact->add_capsule(s5.body[0], z, arma::vec{0.5, 0., 0.}, 0.1);
+    s5.contact->add_sphere(s5.body[1], z, 0.3);
+    ok = expect("capsule-sphere", s5, 1, 0.05, ez) && ok;
+
+    Scene s6 = make_scene(arma::vec{0., 0., 0.35}, z, z, z);
+    s6.contact->add_sphere(s6.body[0], z, 0.2);
+    s6.contact->add_box(s6.body[1], z, arma::vec{0.5, 0.5, 0.2});
+    ok = expect("sphere-box face", s6, 1, 0.05, ez) && ok;
+
+    /* center inside the box: depth is the radius plus the penetration */
+    Scene s7 = make_scene(arma::vec{0.1, 0., 0.15}, z, z, z);
+    s7.contact->add_sphere(s7.body[0], z, 0.1);
+    s7.contact->add_box(s7.body[1], z, arma::vec{0.5, 0.5, 0.2});
+    ok = expect("sphere-box inside", s7, 1, 0.15, ez) && ok;
+
+    Scene s8 = make_scene(arma::vec{0.4, 0., 0.}, z, z, z);
+    s8.contact->add_capsule(s8.body[0], z, arma::vec{0., 0., 0.5}, 0.15);
+    s8.contact->add_box(s8.body[1], z, arma::vec{0.3, 0.3, 0.3});
+    ok = expect("capsule-box side", s8, 1, 0.05, ex) && ok;
+
+    Scene s9 = make_scene(arma::vec{0., 0., 0.05}, z, z, z);
+    s9.contact->add_box(s9.body[0], z, arma::vec{0.2, 0.3, 0.1});
+    s9.contact->add_plane(ez, 0.);
+    ok = expect("box-plane flat", s9, 4, 0.05, -ez) && ok;
+
+    /* tilted 45 deg about y: the two lowest vertices are 0.4 / sqrt(2) down */
+    Scene s10 = make_scene(arma::vec{0., 0., 0.25}, arma::vec{0., PI / 4, 0.}, z, z);
+    s10.contact->add_box(s10.body[0], z, arma::vec{0.3, 0.2, 0.1});
+    s10.contact->add_plane(ez, 0.);
+    ok = expect("box-plane tilted", s10, 2, 0.4 / std::sqrt(2.0) - 0.25, -ez) && ok;
+
+    /* small box resting 0.05 deep on a large one: its four lower vertices */
+    Scene s11 = make_scene(z, z, arma::vec{0., 0., 0.55}, z);
+    s11.contact->add_box(s11.body[0], z, arma::vec{0.5, 0.5, 0.5});
+    s11.contact->add_box(s11.body[1], z, arma::vec{0.1, 0.1, 0.1});
+    ok = expect("box-box", s11, 4, 0.05, ez) && ok;
+
+    Scene s12 = make_scene(z, z, arma::vec{0., 0.75, 0.}, z);
+    s12.contact->add_box(s12.body[0], z, arma::vec{0.5, 0.5, 0.5});
+    s12.contact->add_sphere(s12.body[1], z, 0.2);
+    ok = expect("box-sphere separated", s12, 0, 0.0, ey) && ok;
+
+    double zmax_elastic, zmax_damped;
+    double E0 = 9.8 * 1.0, E_elastic = drop(0.0, zmax_elastic), E_damped = drop(200.0, zmax_damped);
+    bool energy = std::fabs(E_elastic - E0) < 1e-2 * E0 && std::fabs(zmax_elastic - 1.0) < 1e-2
+        && E_damped < 0.9 * E0 && zmax_damped < 0.9;
+    std::printf("ball drop: energy %.4f elastic, %.4f damped of %.4f, apex %.4f / %.4f  %s\n", E_elastic, E_damped, E0,
+        zmax_elastic, zmax_damped, energy ? "ok" : "FAIL");
+    ok = ok && energy;
+    return ok ? 0 : 1;
+}
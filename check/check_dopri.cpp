@@ -0,0 +1,92 @@
+/* DOPRI45 against RK4 at a fine step: a pendulum chain of three bodies,
+   sampled every dt by the continuous extension, must stay within a small
+   multiple of the tolerance band of the reference. A load that turns NaN
+   at t_bad must stop it by step size underflow: solve() returns false,
+   get_failed() is set and the time and state stay at the last sample. */
+#include "Dynamics_System.hpp"
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace {
+
+DynSysPtr build(double dt_In, Integrator_Type integrator_In) {
+    DynSysPtr sys = boost::make_shared<Dynamics_Sys>(dt_In);
+    arma::vec pi = {0., 0., 0.}, pj = {-1., 0., 0.}, z = {0., 0., 0.};
+    arma::vec ANG1 = {0., -30 * 3.1415926 / 180.0, 0.};
+    arma::vec I = {1., 2., 3.}, F = {0., 0., 9.8}, T = {0.1, 0., 0.};
+
+    BodyPtr prev = sys->Create<Ground>(0), now;
+    for (unsigned int i = 1; i <= 3; i++) {
+        now = sys->Create<Mobilized_body>(i, z, z, z, i == 1 ? z : ANG1, z, z, 1.0, I, F, i == 1 ? T : z);
+        sys->Create<Spherical_Joint>(pi, pj, z, z, prev, now);
+        prev = now;
+    }
+    sys->Assembly();
+    sys->init();
+    sys->set_integrator(integrator_In);
+    return sys;
+}
+
+bool check_accuracy() {
+    const double T_end = 2.0, dt = 0.01, rtol = 1e-8, atol = 1e-10;
+    const unsigned int fine = 100;
+    bool ok = true;
+
+    DynSysPtr ref = build(dt / fine, RK4_INTEGRATOR);
+    DynSysPtr sys = build(dt, DOPRI45_INTEGRATOR);
+    sys->set_tolerance(rtol, atol);
+
+    /* the accepted steps ignore the sample times, so every sample is
+       interpolated */
+    double diff = 0.0;
+    for (unsigned int k = 1; k * dt <= T_end + 1e-12; k++) {
+        ok = sys->solve() && ok;
+        for (unsigned int m = 0; m < fine; m++) ok = ref->solve() && ok;
+        diff = std::max(diff, arma::abs(sys->get_state() - ref->get_state()).max());
+    }
+    ok = ok && diff < 1e-7 && std::fabs(sys->get_time() - ref->get_time()) < 1e-12;
+    std::printf("dopri45 vs rk4 at dt / %u: diff %.2e over %.1f s, %lu evaluations  %s\n", fine, diff, T_end,
+        sys->get_feval_count(), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+bool check_underflow() {
+    const double dt = 0.01, t_bad = 0.155;
+    DynSysPtr sys = build(dt, DOPRI45_INTEGRATOR);
+    sys->Create<Callback_Force>([t_bad](double t_In, const std::vector<BodyPtr> &, double *RHS_Out) {
+        if (t_In > t_bad) RHS_Out[6] = std::numeric_limits<double>::quiet_NaN();
+    });
+    sys->init();
+    sys->set_integrator(DOPRI45_INTEGRATOR);
+
+    /* the state and time of the last sample before the failing solve() */
+    arma::vec last = sys->get_state();
+    double t_last = sys->get_time();
+    unsigned int k = 0;
+    while (k < 100 && sys->solve()) {
+        last = sys->get_state();
+        t_last = sys->get_time();
+        k++;
+    }
+    bool stopped = k < 100 && sys->get_failed();
+    bool kept = sys->get_time() == t_last && arma::abs(sys->get_state() - last).max() == 0.0;
+    bool again = !sys->solve() && sys->get_time() == t_last && arma::abs(sys->get_state() - last).max() == 0.0;
+    bool finite = true;
+    for (unsigned int i = 0; i < last.n_elem; i++) finite = finite && std::isfinite(last(i));
+
+    bool ok = stopped && kept && again && finite && std::fabs(t_last - std::floor(t_bad / dt) * dt) < 1e-12;
+    std::printf("dopri45 NaN load at t = %.3f: stops after %u steps at t = %.3f  %s\n", t_bad, k, t_last,
+        ok ? "ok" : "FAIL");
+    return ok;
+}
+
+}
+
+int main() {
+    bool ok = check_accuracy();
+    ok = check_underflow() && ok;
+    return ok ? 0 : 1;
+}
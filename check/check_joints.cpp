@@ -0,0 +1,104 @@
+/* Joint Jacobians and GAMMA against finite differences, for every joint type.
+   Cq is compared with central differences of CONSTRAINT under a translation
+   of either body and a rotation TIB exp([e x]) in its body frame; GAMMA with
+   the second difference of CONSTRAINT along the free motion of both bodies
+   (Cq q_dd = GAMMA, so d2C/dt2 = -GAMMA at zero acceleration). */
+#include "Joint.hpp"
+#include "Math.hpp"
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+struct Pose {
+    arma::vec3 S[2], V[2], W[2];
+    arma::mat33 TIB[2];
+};
+
+arma::mat33 rotation(const arma::vec3 &w) {
+    double th = arma::norm(w);
+    arma::mat33 K = skew_sym(w);
+    arma::mat33 R(arma::fill::eye);
+    if (th < 1e-14) return R + K;
+    return R + std::sin(th) / th * K + (1.0 - std::cos(th)) / (th * th) * K * K;
+}
+
+void set_pose(const Pose &p, BodyPtr *b) {
+    for (unsigned int k = 0; k < 2; k++) {
+        b[k]->set_POSITION(p.S[k]);
+        b[k]->set_VELOCITY(p.V[k]);
+        b[k]->set_ANGLE_VEL(p.W[k]);
+        b[k]->set_TBI(trans(p.TIB[k]));
+    }
+}
+
+arma::vec constraint(const Pose &p, BodyPtr *b, JointPtr J) {
+    set_pose(p, b);
+    J->update();
+    return J->get_CONSTRAINT();
+}
+
+}
+
+int main() {
+    const char *names[] = {"spherical", "revolute", "prismatic", "fixed", "universal"};
+    const double h = 1e-6, hh = 1e-4, tol_cq = 1e-7, tol_gamma = 1e-5;
+    arma::vec3 z(arma::fill::zeros), I = {1., 1., 1.};
+    arma::vec3 pi = {0.2, 0.1, -0.3}, pj = {-0.5, 0.3, 0.2}, qi = {0.3, 0.5, 0.8}, qj = {0.1, -0.4, 0.9};
+    BodyPtr b[2];
+    Pose s;
+    int fail = 0;
+
+    for (unsigned int k = 0; k < 2; k++) {
+        b[k] = boost::make_shared<Mobilized_body>(k + 1, z, z, z, z, z, z, 1.0, I, z, z);
+        s.S[k] = {0.3 * k + 0.1, -0.2, 0.5 * k};
+        s.V[k] = {0.3, -0.1 * k, 0.7};
+        s.W[k] = {0.5, -1.1 + k, 0.8};
+        s.TIB[k] = rotation(arma::vec3{0.4 + k, 0.2, -0.3 * k});
+    }
+
+    for (unsigned int t = SPHERICAL_JOINT; t <= UNIVERSAL_JOINT; t++) {
+        JointPtr J = make_joint((Joint_Type)t, pi, pj, qi, qj, b[0], b[1]);
+        set_pose(s, b);
+        J->update();
+        arma::mat Cq = join_rows(J->get_Cqi(), J->get_Cqj());
+        arma::vec GAMMA = J->get_GAMMA();
+        arma::mat Cq_fd(Cq.n_rows, 12);
+
+        for (unsigned int c = 0; c < 12; c++) {
+            Pose p = s, m = s;
+            unsigned int k = c / 6;
+            arma::vec3 e(arma::fill::zeros);
+            e((c % 6) % 3) = h;
+            if (c % 6 < 3) {
+                p.S[k] += e;
+                m.S[k] -= e;
+            } else {
+                p.TIB[k] = s.TIB[k] * rotation(e);
+                m.TIB[k] = s.TIB[k] * rotation(-e);
+            }
+            Cq_fd.col(c) = (constraint(p, b, J) - constraint(m, b, J)) / (2.0 * h);
+        }
+
+        arma::vec C[3];
+        for (int q = -1; q <= 1; q++) {
+            Pose p = s;
+            for (unsigned int k = 0; k < 2; k++) {
+                p.S[k] = s.S[k] + q * hh * s.V[k];
+                p.TIB[k] = s.TIB[k] * rotation(q * hh * s.W[k]);
+            }
+            C[q + 1] = constraint(p, b, J);
+        }
+        arma::vec C_dd = (C[2] - 2.0 * C[1] + C[0]) / (hh * hh);
+
+        double err_cq = arma::abs(Cq - Cq_fd).max();
+        double err_gamma = arma::abs(C_dd + GAMMA).max();
+        bool ok = err_cq < tol_cq && err_gamma < tol_gamma;
+        std::printf("%-10s rows %u  Cq err %.2e  GAMMA err %.2e  %s\n", names[t], (unsigned int)Cq.n_rows, err_cq,
+            err_gamma, ok ? "ok" : "FAIL");
+        if (!ok) fail = 1;
+    }
+    return fail;
+}
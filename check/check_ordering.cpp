@@ -0,0 +1,213 @@
+/* Body ordering and the sparse KKT pivot order.
+   - On a 30x30 net of spherical joints with shuffled body numbers the pivot
+     order of Topology::kkt_order() must be a permutation that puts every
+     constraint block after both of its bodies, and must give less fill in L
+     than bodies in number order with each block after its later body.
+   - A small net with a closed loop, shuffled body numbers and joints listed
+     child first must give the dense solver's states with every solver. */
+#include "Dynamics_System.hpp"
+#include "Sparse_LDL.hpp"
+#include "Topology.hpp"
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+/* The KKT pattern Dynamics_Sys::Setup_Solver() builds */
+void kkt_pattern(const std::vector<JointPtr> &joint_In, const std::vector<unsigned int> &ground_In,
+        const std::vector<unsigned int> &ground_row_In, const std::vector<unsigned int> &joint_row_In,
+        unsigned int nbody_In, std::vector<unsigned int> &rows_Out, std::vector<unsigned int> &cols_Out) {
+    const unsigned int cons_off = 6 * nbody_In;
+    unsigned int i_col, j_col, row;
+
+    for (unsigned int i = 0; i < nbody_In; i++) {
+        for (unsigned int c = 0; c < 6; c++) {
+            for (unsigned int r = 0; r < 6; r++) {
+                rows_Out.push_back(i * 6 + r);
+                cols_Out.push_back(i * 6 + c);
+            }
+        }
+    }
+    for (unsigned int g = 0; g < ground_In.size(); g++) {
+        for (unsigned int k = 0; k < 6; k++) {
+            rows_Out.push_back(cons_off + ground_row_In[g] + k);
+            cols_Out.push_back(ground_In[g] * 6 + k);
+            rows_Out.push_back(ground_In[g] * 6 + k);
+            cols_Out.push_back(cons_off + ground_row_In[g] + k);
+        }
+    }
+    for (unsigned int i = 0; i < joint_In.size(); i++) {
+        i_col = joint_In[i]->get_body_i_ptr()->get_num() * 6;
+        j_col = joint_In[i]->get_body_j_ptr()->get_num() * 6;
+        row = cons_off + joint_row_In[i];
+        for (unsigned int c = 0; c < 6; c++) {
+            for (unsigned int r = 0; r < joint_In[i]->get_Cqi().n_rows; r++) {
+                rows_Out.push_back(row + r);
+                cols_Out.push_back(i_col + c);
+                rows_Out.push_back(row + r);
+                cols_Out.push_back(j_col + c);
+                rows_Out.push_back(i_col + c);
+                cols_Out.push_back(row + r);
+                rows_Out.push_back(j_col + c);
+                cols_Out.push_back(row + r);
+            }
+        }
+    }
+}
+
+unsigned int L_nnz(unsigned int n_In, const std::vector<unsigned int> &rows_In, const std::vector<unsigned int> &cols_In,
+        const std::vector<unsigned int> &P_In) {
+    Sparse_LDL LDL;
+    LDL.set_pattern(n_In, rows_In, cols_In);
+    LDL.set_order(P_In);
+    LDL.analyze();
+    return LDL.get_L_nnz();
+}
+
+/* Every constraint pivot after the pivots of the bodies it acts on */
+bool valid_order(const std::vector<JointPtr> &joint_In, const std::vector<unsigned int> &ground_In,
+        const std::vector<unsigned int> &ground_row_In, const std::vector<unsigned int> &joint_row_In,
+        unsigned int nbody_In, unsigned int n_In, const std::vector<unsigned int> &P_In) {
+    const unsigned int cons_off = 6 * nbody_In;
+    std::vector<unsigned int> Pinv(n_In, n_In);
+    unsigned int last;
+
+    if (P_In.size() != n_In) return false;
+    for (unsigned int k = 0; k < n_In; k++) {
+        if (P_In[k] >= n_In || Pinv[P_In[k]] != n_In) return false;
+        Pinv[P_In[k]] = k;
+    }
+    for (unsigned int g = 0; g < ground_In.size(); g++) {
+        if (Pinv[cons_off + ground_row_In[g]] < Pinv[6 * ground_In[g] + 5]) return false;
+    }
+    for (unsigned int i = 0; i < joint_In.size(); i++) {
+        last = std::max(Pinv[6 * joint_In[i]->get_body_i_ptr()->get_num() + 5],
+            Pinv[6 * joint_In[i]->get_body_j_ptr()->get_num() + 5]);
+        for (unsigned int r = 0; r < joint_In[i]->get_Cqi().n_rows; r++) {
+            if (Pinv[cons_off + joint_row_In[i] + r] < last) return false;
+        }
+    }
+    return true;
+}
+
+bool check_fill() {
+    const unsigned int W = 30, H = 30;
+    arma::vec z = {0., 0., 0.}, I = {1., 1., 1.};
+    std::vector<BodyPtr> body;
+    std::vector<JointPtr> joint;
+    std::vector<unsigned int> perm(W * H), ground_row, joint_row, rows, cols, P, P_number;
+
+    for (unsigned int i = 0; i < W * H; i++) perm[i] = i;
+    std::srand(3);
+    for (unsigned int i = W * H - 1; i > 0; i--) std::swap(perm[i], perm[std::rand() % (i + 1)]);
+    body.push_back(boost::make_shared<Ground>(0));
+    for (unsigned int i = 0; i < W * H; i++) {
+        body.push_back(boost::make_shared<Mobilized_body>(i + 1, z, z, z, z, z, z, 1., I, z, z));
+    }
+    BodyPtr *net = &body[1];
+    joint.push_back(boost::make_shared<Spherical_Joint>(z, z, z, z, body[0], net[perm[0]]));
+    for (unsigned int y = 0; y < H; y++) {
+        for (unsigned int x = 0; x < W; x++) {
+            if (x + 1 < W) {
+                joint.push_back(boost::make_shared<Spherical_Joint>(z, z, z, z, net[perm[y * W + x]],
+                    net[perm[y * W + x + 1]]));
+            }
+            if (y + 1 < H) {
+                joint.push_back(boost::make_shared<Spherical_Joint>(z, z, z, z, net[perm[y * W + x]],
+                    net[perm[(y + 1) * W + x]]));
+            }
+        }
+    }
+
+    Topology TOPO;
+    TOPO.build(body, joint);
+    const unsigned int nbody = body.size(), cons_off = 6 * nbody;
+    const unsigned int n = cons_off + TOPO.constraint_rows(ground_row, joint_row);
+    const std::vector<unsigned int> &ground = TOPO.get_ground();
+    kkt_pattern(joint, ground, ground_row, joint_row, nbody, rows, cols);
+    TOPO.kkt_order(ground_row, joint_row, P);
+
+    /* Reference: bodies in number order, each block after its later body */
+    for (unsigned int b = 0; b < nbody; b++) {
+        for (unsigned int c = 0; c < 6; c++) P_number.push_back(6 * b + c);
+        for (unsigned int g = 0; g < ground.size(); g++) {
+            if (ground[g] != b) continue;
+            for (unsigned int r = 0; r < 6; r++) P_number.push_back(cons_off + ground_row[g] + r);
+        }
+        for (unsigned int i = 0; i < joint.size(); i++) {
+            if (std::max(joint[i]->get_body_i_ptr()->get_num(), joint[i]->get_body_j_ptr()->get_num()) != b) continue;
+            for (unsigned int r = 0; r < 3; r++) P_number.push_back(cons_off + joint_row[i] + r);
+        }
+    }
+
+    bool valid = valid_order(joint, ground, ground_row, joint_row, nbody, n, P)
+        && valid_order(joint, ground, ground_row, joint_row, nbody, n, P_number);
+    unsigned int nnz = L_nnz(n, rows, cols, P), nnz_number = L_nnz(n, rows, cols, P_number);
+    bool ok = valid && nnz < nnz_number;
+    std::printf("%ux%u net: n %u  nnz(L) %u with kkt_order, %u in body number order  %s\n", W, H, n, nnz, nnz_number,
+        ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/* Three chains of four bodies along x from ground 0, the ends of the first
+   two joined: body numbers shuffled, joints shuffled and half of them
+   listed child first */
+DynSysPtr build_net(Solver_Type solver_In) {
+    const unsigned int nchain = 3, len = 4;
+    arma::vec z = {0., 0., 0.}, I = {1., 2., 3.}, F = {0., 0., 9.8}, back = {-1., 0., 0.}, side = {0., 1., 0.};
+    std::vector<unsigned int> perm(nchain * len);
+    std::vector<BodyPtr> body(nchain * len);
+    struct Link { arma::vec pi, pj; BodyPtr i, j; };
+    std::vector<Link> link;
+
+    DynSysPtr sys = boost::make_shared<Dynamics_Sys>(0.001);
+    sys->set_solver(solver_In);
+    for (unsigned int i = 0; i < perm.size(); i++) perm[i] = i;
+    std::srand(7);
+    for (unsigned int i = perm.size() - 1; i > 0; i--) std::swap(perm[i], perm[std::rand() % (i + 1)]);
+    BodyPtr g = sys->Create<Ground>(0);
+    for (unsigned int i = 0; i < body.size(); i++) {
+        body[perm[i]] = sys->Create<Mobilized_body>(i + 1, z, z, z, z, z, z, 1., I, F, z);
+    }
+    for (unsigned int c = 0; c < nchain; c++) {
+        link.push_back(Link{arma::vec{0., double(c), 0.}, back, g, body[c * len]});
+        for (unsigned int k = 0; k + 1 < len; k++) link.push_back(Link{z, back, body[c * len + k], body[c * len + k + 1]});
+    }
+    link.push_back(Link{side, z, body[len - 1], body[2 * len - 1]});
+    for (unsigned int i = link.size() - 1; i > 0; i--) std::swap(link[i], link[std::rand() % (i + 1)]);
+    for (unsigned int i = 0; i < link.size(); i++) {
+        if (i % 2) sys->Create<Spherical_Joint>(link[i].pj, link[i].pi, z, z, link[i].j, link[i].i);
+        else sys->Create<Spherical_Joint>(link[i].pi, link[i].pj, z, z, link[i].i, link[i].j);
+    }
+    sys->Assembly();
+    sys->init();
+    return sys;
+}
+
+bool check_solvers() {
+    const char *names[] = {"dense", "sparse", "tree", "schur", "iterative"};
+    const unsigned int steps = 300;
+    bool ok = true;
+    DynSysPtr ref = build_net(DENSE_SOLVER);
+
+    for (unsigned int k = 0; k < steps; k++) ref->solve();
+    for (unsigned int s = SPARSE_SOLVER; s <= ITERATIVE_SOLVER; s++) {
+        DynSysPtr sys = build_net((Solver_Type)s);
+        for (unsigned int k = 0; k < steps; k++) sys->solve();
+        double diff = arma::abs(sys->get_state() - ref->get_state()).max();
+        bool pass = diff < 1e-8;
+        std::printf("loop net, %-9s vs dense: diff %.2e  %s\n", names[s], diff, pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+    return ok;
+}
+
+}
+
+int main() {
+    bool ok = check_fill();
+    ok = check_solvers() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/* Scene files: every malformed value of a valid scene must make parse()
+   return a null pointer (wrong-length arrays, negative unsigned settings,
+   unknown and duplicate body names), and a scene loaded through its cache,
+   when the cache is written and when it is read, must run bit for bit like
+   the scene loaded without one. */
+#include "Scene_Loader.hpp"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace {
+
+const char *const SCENE = R"({
+    "dt": 0.001,
+    "solver": "sparse",
+    "integrator": "dopri45",
+    "tolerance": [1e-8, 1e-10],
+    "iterative": {"tol": 1e-10, "max_iter": 50},
+    "threads": 1,
+    "bodies": [
+        {"name": "ground", "type": "ground"},
+        {"name": "link1", "mass": 1.0, "inertia": [1.0, 2.0, 3.0]},
+        {"name": "link2", "mass": 2.0, "inertia": [1.0, 1.0, 1.0], "angle": [0.0, -0.5, 0.0]},
+        {"name": "link3", "mass": 1.0, "inertia": [1.0, 1.0, 1.0], "angular_velocity": [0.0, 0.0, 1.0]}
+    ],
+    "joints": [
+        {"type": "spherical", "body_i": "ground", "body_j": "link1", "pi": [0.0, 0.0, 0.0], "pj": [-1.0, 0.0, 0.0]},
+        {"type": "revolute", "body_i": "link1", "body_j": "link2", "pj": [-1.0, 0.0, 0.0], "qi": [0.0, 1.0, 0.0], "qj": [0.0, 1.0, 0.0]},
+        {"type": "spherical", "body_i": "link2", "body_j": "3", "pj": [-1.0, 0.0, 0.0]}
+    ],
+    "forces": [
+        {"type": "gravity", "g": [0.0, 0.0, -9.8]},
+        {"type": "spring", "body_i": "ground", "body_j": "link3", "pi": [2.0, 0.0, 0.0], "k": 20.0, "c": 0.5, "length": 1.0}
+    ]
+})";
+
+/* SCENE with the first from_In replaced by to_In */
+std::string edit(const char *from_In, const char *to_In) {
+    std::string text = SCENE;
+    std::string::size_type at = text.find(from_In);
+    if (at != std::string::npos) text.replace(at, std::string(from_In).size(), to_In);
+    return text;
+}
+
+bool same_run(DynSysPtr a_In, DynSysPtr b_In, unsigned int steps_In) {
+    for (unsigned int k = 0; k < steps_In; k++) {
+        if (!a_In->solve() || !b_In->solve()) return false;
+    }
+    return a_In->get_time() == b_In->get_time() && arma::abs(a_In->get_state() - b_In->get_state()).max() == 0.0;
+}
+
+}
+
+int main() {
+    struct Case { const char *name, *from, *to; };
+    const Case bad[] = {
+        {"inertia of 2 numbers", "\"inertia\": [1.0, 2.0, 3.0]", "\"inertia\": [1.0, 2.0]"},
+        {"pj of 4 numbers", "\"pj\": [-1.0, 0.0, 0.0]}", "\"pj\": [-1.0, 0.0, 0.0, 0.0]}"},
+        {"tolerance of 1 number", "\"tolerance\": [1e-8, 1e-10]", "\"tolerance\": [1e-8]"},
+        {"angle not an array", "\"angle\": [0.0, -0.5, 0.0]", "\"angle\": 0.5"},
+        {"negative threads", "\"threads\": 1", "\"threads\": -1"},
+        {"negative max_iter", "\"max_iter\": 50", "\"max_iter\": -50"},
+        {"unknown joint body", "\"body_j\": \"link2\"", "\"body_j\": \"link9\""},
+        {"body index out of range", "\"body_j\": \"3\"", "\"body_j\": \"4\""},
+        {"unknown spring body", "\"body_j\": \"link3\", \"pi\"", "\"body_j\": \"link33\", \"pi\""},
+        {"duplicate body name", "\"name\": \"link3\"", "\"name\": \"link1\""},
+    };
+    const char *file = "check_scene.json", *cache = "check_scene.cache";
+    int fail = 0;
+
+    bool good = Scene_Loader::parse(SCENE) != nullptr;
+    std::printf("%-24s %s\n", "valid scene", good ? "ok" : "FAIL");
+    if (!good) fail = 1;
+
+    for (const Case &c : bad) {
+        std::string text = edit(c.from, c.to);
+        bool ok = text != SCENE && Scene_Loader::parse(text) == nullptr;
+        std::printf("%-24s %s\n", c.name, ok ? "ok" : "FAIL");
+        if (!ok) fail = 1;
+    }
+
+    /* uncached against the load that writes the cache and the one that reads it */
+    std::ofstream(file) << SCENE;
+    std::remove(cache);
+    DynSysPtr plain = Scene_Loader::load(file), written = Scene_Loader::load(file, cache);
+    bool have_cache = std::ifstream(cache).good();
+    DynSysPtr mapped = Scene_Loader::load(file, cache), again = Scene_Loader::load(file);
+    bool ok = plain && written && mapped && again && have_cache && same_run(plain, written, 500)
+        && same_run(again, mapped, 500) && arma::abs(plain->get_state() - mapped->get_state()).max() == 0.0;
+    std::printf("%-24s %s\n", "cached load bit for bit", ok ? "ok" : "FAIL");
+    if (!ok) fail = 1;
+    std::remove(file);
+    std::remove(cache);
+    return fail;
+}
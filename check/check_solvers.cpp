@@ -0,0 +1,59 @@
+/* The chain of src/main.cpp, ground and 11 bodies on spherical joints,
+   stepped with every solver must stay on the dense solver's states, under
+   RK4 and under implicit Euler, whose Newton corrections reuse each
+   solver's factors. */
+#include "Dynamics_System.hpp"
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+DynSysPtr build_chain(Solver_Type solver_In, Integrator_Type integrator_In) {
+    DynSysPtr sys = boost::make_shared<Dynamics_Sys>(0.001);
+    arma::vec pi = {0., 0., 0.}, pj = {-1., 0., 0.}, z = {0., 0., 0.};
+    arma::vec ANG1 = {0., -3. * 3.1415926 / 180.0, 0.};
+    arma::vec I = {1., 1., 1.}, F = {0., 0., 9.8};
+
+    sys->set_solver(solver_In);
+    BodyPtr prev = sys->Create<Ground>(0), now;
+    for (unsigned int i = 1; i <= 11; i++) {
+        now = sys->Create<Mobilized_body>(i, z, z, z, i == 1 ? z : ANG1, z, z, 1.0, I, F, z);
+        sys->Create<Spherical_Joint>(pi, pj, z, z, prev, now);
+        prev = now;
+    }
+    sys->Assembly();
+    sys->init();
+    sys->set_integrator(integrator_In);
+    /* CG converged far below the check tolerance */
+    sys->set_iterative(1e-13, 0);
+    return sys;
+}
+
+}
+
+int main() {
+    const char *solvers[] = {"dense", "sparse", "tree", "schur", "iterative"};
+    const char *integrators[] = {"rk4", "implicit"};
+    const Integrator_Type type[] = {RK4_INTEGRATOR, IMPLICIT_EULER_INTEGRATOR};
+    const unsigned int steps = 2000;
+    const double tol = 1e-8;
+    int fail = 0;
+
+    for (unsigned int it = 0; it < 2; it++) {
+        DynSysPtr ref = build_chain(DENSE_SOLVER, type[it]);
+        for (unsigned int k = 0; k < steps; k++) ref->solve();
+
+        for (unsigned int s = SPARSE_SOLVER; s <= ITERATIVE_SOLVER; s++) {
+            DynSysPtr sys = build_chain((Solver_Type)s, type[it]);
+            bool ok = true;
+            for (unsigned int k = 0; k < steps && ok; k++) ok = sys->solve();
+            double diff = arma::abs(sys->get_state() - ref->get_state()).max();
+            ok = ok && !ref->get_failed() && diff < tol && sys->get_time() == ref->get_time();
+            std::printf("main chain, %-8s %-9s vs dense: diff %.2e  %s\n", integrators[it], solvers[s], diff,
+                ok ? "ok" : "FAIL");
+            if (!ok) fail = 1;
+        }
+    }
+    return fail;
+}
@@ -0,0 +1,16 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+/* Heap allocation counter for checking allocation-free stepping.
+   Build with -DMBD_ALLOC_COUNTER to interpose the malloc family (glibc);
+   otherwise the counter is compiled out and always reads 0. Armadillo takes
+   its memory through malloc/posix_memalign, so its allocations are counted.
+   Counts are per thread. */
+namespace alloc_counter {
+
+bool enabled();
+unsigned long count();
+
+}  // namespace alloc_counter
+
+#endif  //ALLOC_COUNTER_HPP
\ No newline at end of file
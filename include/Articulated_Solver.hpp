@@ -0,0 +1,50 @@
+#ifndef ARTICULATED_SOLVER_HPP
+#define ARTICULATED_SOLVER_HPP
+
+#include <armadillo>
+#include "Body.hpp"
+#include "Joint.hpp"
+#include <vector>
+
+/* Linear-time solve of the KKT system [M Cq^T; Cq 0] [a; lambda] = [F; GAMMA]
+   for tree topologies. Bodies and constraints (the rows of each ground and
+   every joint) are the nodes of a forest, one tree per ground rooted at its
+   constraint; eliminating the nodes leaves-first accumulates the
+   articulated inertia of each subtree into its parent, so no fill-in
+   appears and the cost is O(nbody). */
+class Articulated_Solver
+{
+public:
+    Articulated_Solver();
+    ~Articulated_Solver() {};
+
+    bool build(std::vector<BodyPtr> &Body_In, std::vector<JointPtr> &Joint_In,
+        const std::vector<unsigned int> &joint_row_In, const std::vector<unsigned int> &ground_In,
+        const std::vector<unsigned int> &ground_row_In);
+    void factor();
+    void solve(const arma::vec &RHS_In, arma::vec &ANS_Out);
+
+private:
+    struct Node {
+        unsigned int type;  // 0: body, 1: constraint
+        unsigned int index;  // body number or joint index (rows of ground g: njoint + g)
+        unsigned int offset;  // first row in the KKT system
+        unsigned int dim;
+        int parent;  // parent node, -1 for the roots
+        arma::mat D;  // articulated diagonal block, inverted by factor()
+        arma::mat J;  // coupling block H(node, parent)
+        arma::mat L;  // D^-1 * J
+        arma::vec y;
+    };
+
+    void load_blocks();
+
+    unsigned int nbody;
+    unsigned int njoint;
+    std::vector<Node> nodes;
+    std::vector<unsigned int> order;  // children before parents
+    std::vector<BodyPtr> *Body_array;
+    std::vector<JointPtr> *Joint_array;
+};
+
+#endif  //ARTICULATED_SOLVER_HPP
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef ASYNC_LOGGER_HPP
+#define ASYNC_LOGGER_HPP
+
+#include "Trajectory_Writer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* What push() does when the queue is full */
+enum Log_Policy {
+    LOG_BLOCK = 0,  // wait for the writer; no snapshot is lost
+    LOG_DROP,  // discard the snapshot
+    LOG_DECIMATE  // discard, and keep only every 2^k-th push until the queue drains
+};
+
+/* Moves trajectory output off the stepping thread. push() packs a snapshot
+   straight into a slot of a single-producer/single-consumer ring; a writer
+   thread drains the ring into a Trajectory_Writer. Only the thread that
+   steps the system may call push(). */
+class Async_Logger
+{
+public:
+    Async_Logger();
+    ~Async_Logger();
+
+    bool start(const std::string &file_In, const Dynamics_Sys &sys_In,
+        unsigned int field_mask_In = TRAJ_POS | TRAJ_QUAT | TRAJ_VEL, unsigned int capacity_In = 4096,
+        Log_Policy policy_In = LOG_BLOCK, Traj_Mode mode_In = TRAJ_BUFFERED);
+    bool push(const Dynamics_Sys &sys_In);
+    void stop();
+
+    unsigned long get_dropped() const;
+    unsigned long get_written() const;
+
+private:
+    void Writer_Loop();
+
+    Trajectory_Writer writer;
+    Log_Policy policy;
+    std::vector<double> ring;  // capacity slots of stride doubles
+    size_t capacity;  // power of two
+    size_t stride;
+    std::thread consumer;
+    std::atomic<bool> running;
+
+    /* Producer and consumer indices on separate cache lines */
+    alignas(64) std::atomic<size_t> head;  // next slot to fill, written by push()
+    alignas(64) std::atomic<size_t> tail;  // next slot to drain, written by the writer thread
+    alignas(64) unsigned int skip_shift;  // LOG_DECIMATE: keep every 2^skip_shift-th push
+    unsigned long npush;
+    std::atomic<unsigned long> dropped;
+    std::atomic<unsigned long> written;
+};
+
+#endif  //ASYNC_LOGGER_HPP
@@ -12,19 +12,22 @@ public:
     Body();
     virtual ~Body() = default;
 
-    arma::mat get_TBI();
-    arma::vec get_POSITION();
-    arma::vec get_VELOCITY();
-    arma::vec get_ACCELERATION();
-    arma::vec get_ANGLE_VEL();
-    arma::vec get_ANGLE();
-    arma::vec get_ANGLE_ACC();
-    arma::vec get_FORCE();
-    arma::vec get_TORQUE();
-    arma::mat get_M();
-    arma::vec get_TBI_Q();
-    arma::vec get_TBID_Q();
-    unsigned int get_num();
+    const arma::mat33 &get_TBI() const;
+    const arma::vec3 &get_POSITION() const;
+    const arma::vec3 &get_VELOCITY() const;
+    const arma::vec3 &get_ACCELERATION() const;
+    const arma::vec3 &get_ANGLE_VEL() const;
+    const arma::vec3 &get_ANGLE() const;  // Euler angles of TBI, computed on first access after a step
+    const arma::vec3 &get_ANGLE_ACC() const;
+    const arma::vec3 &get_FORCE() const;
+    const arma::vec3 &get_TORQUE() const;
+    const arma::vec3 &get_APPLIED_TORQUE() const;
+    const arma::mat66 &get_M() const;
+    const arma::vec4 &get_TBI_Q() const;
+    const arma::vec4 &get_TBID_Q() const;
+    unsigned int get_num() const;
+    unsigned int get_type() const;
+    double get_quat_gain() const;
 
     void set_POSITION(const arma::vec &PosIn);
     void set_VELOCITY(const arma::vec &VelIn);
@@ -33,49 +36,60 @@ public:
     void set_ANGLE_VEL(const arma::vec &AngvelIn);
     void set_ANGLE_ACC(const arma::vec &AngaccIn);
     void set_TBI(const arma::mat &TBIIn);
+    void set_quat_gain(double Gain_In);
+    void set_FORCE(const arma::vec &F_In);
+    void set_APPLIED_TORQUE(const arma::vec &T_In);
 
-    virtual void update(arma::vec PosIn, arma::vec VelIn, arma::vec AttIn
-        , arma::vec ANG_VEL_In) = 0;
+    virtual void update(const arma::vec &PosIn, const arma::vec &VelIn, const arma::vec &AttIn
+        , const arma::vec &ANG_VEL_In) = 0;
 
 protected:
 
     unsigned int type;  // type define   0: Ground body, 1: Mobilized body
     unsigned int num;  // No. body
 
-    arma::vec POSITION;
-    arma::vec VELOCITY;
-    arma::vec ACCELERATION;
-    arma::vec ANGLE;
-    arma::vec ANGLE_VEL;
-    arma::vec ANGLE_ACC;
-    arma::mat M;
-    arma::vec FORCE;
-    arma::vec TORQUE;
-    arma::vec APPILED_TORQUE;
-    arma::mat TBI;
-    arma::vec TBI_Q;
-    arma::vec TBID_Q;
+    arma::vec3 POSITION;
+    arma::vec3 VELOCITY;
+    arma::vec3 ACCELERATION;
+    mutable arma::vec3 ANGLE;  // derived from TBI by get_ANGLE() while angle_valid is false
+    arma::vec3 ANGLE_VEL;
+    arma::vec3 ANGLE_ACC;
+    arma::mat66 M;
+    arma::vec3 FORCE;
+    arma::vec3 TORQUE;
+    arma::vec3 APPILED_TORQUE;
+    arma::mat33 TBI;
+    arma::vec4 TBI_Q;
+    arma::vec4 TBID_Q;
+    double quat_gain;  // pull of the quaternion derivative back to unit norm
+    mutable bool angle_valid;
 };
 
 class Ground : public Body
 {
 public:
     Ground(unsigned int NumIn);
+    Ground(unsigned int NumIn, const arma::vec &PosIn, const arma::vec &AttIn);  // fixed at an inertial pose
     ~Ground() {};
-    virtual void update(arma::vec PosIn, arma::vec VelIn, arma::vec AttIn
-        , arma::vec ANG_VEL_In) {};
+    virtual void update(const arma::vec &PosIn, const arma::vec &VelIn, const arma::vec &AttIn
+        , const arma::vec &ANG_VEL_In) {};
 };
 
 class Mobilized_body : public Body
 {
 public:
-    Mobilized_body(unsigned int NumIn, arma::vec PosIn, arma::vec VelIn, arma::vec AccIn, arma::vec AttIn
-        , arma::vec ANG_VEL_In, arma::vec ANG_ACC_In, double MIn, arma::vec IIn
-        , arma::vec F_In, arma::vec T_In);
+    Mobilized_body(unsigned int NumIn, const arma::vec &PosIn, const arma::vec &VelIn, const arma::vec &AccIn
+        , const arma::vec &AttIn, const arma::vec &ANG_VEL_In, const arma::vec &ANG_ACC_In, double MIn
+        , const arma::vec &IIn, const arma::vec &F_In, const arma::vec &T_In);
     ~Mobilized_body() {};
 
-    virtual void update(arma::vec PosIn, arma::vec VelIn, arma::vec TBI_QIn
-        , arma::vec ANG_VEL_In) override;
+    virtual void update(const arma::vec &PosIn, const arma::vec &VelIn, const arma::vec &TBI_QIn
+        , const arma::vec &ANG_VEL_In) override;
+    /* update() with TBI and the quaternion rate already computed by the
+       Math.hpp batch kernels: TBI_In and TBID_Q_In point at this body's item
+       of structure-of-arrays buffers of leading dimension ld_In */
+    void load_state(const double *Pos_In, const double *Vel_In, const double *Ang_Vel_In, const double *TBI_In,
+        const double *TBID_Q_In, unsigned int ld_In);
 };
 
 typedef boost::shared_ptr<Body> BodyPtr;
@@ -0,0 +1,106 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "Dynamics_System.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum Ckpt_Flag {
+    CKPT_FSAL = 1,  // k1 holds f(q)
+    CKPT_PROJ_POS = 2,  // set_projection() flags
+    CKPT_PROJ_VEL = 4,
+    CKPT_ANALYSIS = 8  // the analysis block follows the state block
+};
+
+/* Binary checkpoint of an initialized Dynamics_Sys: a fixed header, one
+   Ckpt_Body per body, one Ckpt_Joint per joint, then the raw doubles of
+   q, q_d, the DOPRI45 FSAL stage k1, q_out, dense_coef and SYS_ANS.
+   Optionally the analysis init() derives from the topology comes last: its
+   FNV-1a hash, then counted arrays of the Topology, the constraint rows and,
+   for SPARSE_SOLVER, the KKT pattern, pivot order, elimination tree, column
+   pointers of L and the value slots. Native byte order, as in
+   Trajectory_Writer. */
+struct Ckpt_Header {
+    char magic[8];  // "MBDCKPT"
+    uint32_t version;
+    uint32_t nbody;
+    uint32_t njoint;
+    uint32_t ncons;
+    uint32_t solver;  // Solver_Type
+    uint32_t integrator;  // Integrator_Type
+    uint32_t flags;  // CKPT_FSAL | CKPT_PROJ_POS | CKPT_PROJ_VEL | CKPT_ANALYSIS
+    uint32_t proj_max_iter;
+    uint32_t iter_max_iter;  // set_iterative()
+    uint32_t reserved;
+    double dt;
+    double t_int;
+    double t_sample;
+    double t_old;
+    double h;
+    double h_max;
+    double rtol;
+    double atol;
+    double baum_alpha;
+    double baum_beta;
+    double proj_tol;
+    double iter_tol;
+    uint64_t n_feval;
+    uint64_t n_reject;
+    uint64_t n_newton;
+    uint64_t n_iter;
+    uint64_t bytes;  // whole checkpoint, header included
+};
+
+struct Ckpt_Body {
+    uint32_t type;  // 0: Ground, 1: Mobilized_body
+    uint32_t num;
+    double mass;
+    double inertia[3];  // principal moments, body frame
+    double force[3];
+    double torque[3];  // applied torque
+    double quat_gain;
+};
+
+struct Ckpt_Joint {
+    uint32_t type;  // Joint_Type
+    uint32_t body_i;  // body numbers
+    uint32_t body_j;
+    uint32_t reserved;
+    double pi[3];
+    double pj[3];
+    double qi[3];
+    double qj[3];
+    double ref[6];  // Joint::get_reference()
+};
+
+/* save() takes a snapshot of an initialized system, load() puts one back
+   into a system of the same topology (its own bodies keep their masses and
+   loads, so a template can be forked with changed parameters), and
+   restore() rebuilds the whole system from the checkpoint alone; neither
+   runs Assembly(). The buffer overloads reuse the caller's storage, so
+   periodic snapshots only cost the copies. A checkpoint saved with the
+   analysis is restored without Topology::build() or the sparse symbolic
+   factorization, as an ensemble member is initialized from its template. */
+class Checkpoint
+{
+public:
+    static bool save(const Dynamics_Sys &sys_In, std::vector<char> &buf_Out, bool analysis_In = false);
+    static bool save(const Dynamics_Sys &sys_In, const std::string &file_In);
+    static bool load(Dynamics_Sys &sys_In, const char *buf_In, size_t size_In);
+    static bool load(Dynamics_Sys &sys_In, const std::vector<char> &buf_In);
+    static bool load(Dynamics_Sys &sys_In, const std::string &file_In);
+    static DynSysPtr restore(const char *buf_In, size_t size_In);  // e.g. straight from a mapping
+    static DynSysPtr restore(const std::vector<char> &buf_In);
+    static DynSysPtr restore(const std::string &file_In);
+    static uint64_t hash(const char *buf_In, size_t size_In);  // FNV-1a
+
+private:
+    static bool Check(const char *buf_In, size_t size_In, Ckpt_Header &header_Out);
+    static void Apply(Dynamics_Sys &sys_In, const Ckpt_Header &header_In, const char *buf_In);
+    static void Save_Analysis(const Dynamics_Sys &sys_In, std::vector<char> &buf_Out);
+    static bool Load_Analysis(Dynamics_Sys &sys_In, const char *buf_In, const char *end_In);
+    static bool Read_File(const std::string &file_In, std::vector<char> &buf_Out);
+};
+
+#endif  //CHECKPOINT_HPP
@@ -0,0 +1,101 @@
+#ifndef CONTACT_HPP
+#define CONTACT_HPP
+
+#include "Dynamics_System.hpp"
+#include "Force_Element.hpp"
+#include <cstdint>
+#include <vector>
+
+enum Shape_Type {
+    SHAPE_SPHERE = 0,  // radius about a point
+    SHAPE_CAPSULE,  // radius about a segment
+    SHAPE_BOX  // half extents along the body axes
+};
+
+/* One contact of the last evaluated stage. The normal points from body_i
+   to body_j; a plane contact has body_j == plane_body (no body). */
+struct Contact {
+    unsigned int body_i;
+    unsigned int body_j;
+    unsigned int plane;  // plane index when body_j == plane_body
+    double point[3];  // inertial frame, halfway through the overlap
+    double normal[3];
+    double depth;
+    double force;  // normal force, >= 0
+};
+
+/* Penalty contact between shapes fixed to bodies and static half-spaces.
+   Every stage the shapes' world AABBs are swept and pruned along the axis
+   of largest spread: the sorted order of the previous stage is repaired by
+   insertion sort, so a slowly moving scene costs O(n) plus the overlapping
+   pairs instead of n^2 / 2 pair tests. The narrow phase treats spheres and
+   capsules as a radius about a segment and tests boxes by their vertices
+   or the capsule caps; every contact adds the normal force
+   k depth + c d(depth)/dt, clamped at 0, and a Coulomb friction
+   regularised below friction_vel to SYS_RHS. */
+class Contact_Force : public Force_Element
+{
+public:
+    static const unsigned int plane_body = 0xffffffffu;
+
+    Contact_Force(double k_In, double c_In, double mu_In);
+
+    /* Shapes in the body frame; return the shape index */
+    unsigned int add_sphere(BodyPtr body_In, const arma::vec &center_In, double r_In);
+    unsigned int add_capsule(BodyPtr body_In, const arma::vec &center_In, const arma::vec &half_axis_In,
+        double r_In);  // segment center -+ half_axis
+    unsigned int add_box(BodyPtr body_In, const arma::vec &center_In, const arma::vec &half_In);
+    unsigned int add_plane(const arma::vec &normal_In, double offset_In);  // free side normal . x >= offset
+    void exclude(BodyPtr i_In, BodyPtr j_In);  // no contact between the two bodies
+    void exclude_joined(const Dynamics_Sys &sys_In);  // exclude() every jointed pair
+
+    virtual void apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) override;
+    void set_stiffness(double k_In);
+    void set_damping(double c_In);
+    void set_friction(double mu_In, double vel_In = 1e-3);
+
+    unsigned int get_nshape() const;
+    unsigned long get_npair() const;  // broad phase candidates of the last stage
+    const std::vector<Contact> &get_contacts() const;
+
+private:
+    struct Shape {
+        BodyPtr body_ptr;
+        Body *body;  // body_ptr.get() for the per-stage loops
+        unsigned int type;
+        double center[3];  // body frame
+        double dim[3];  // half axis (capsule) or half extents (box), body frame
+        double r;
+        double c[3];  // world center, axis and rotation of the current stage
+        double a[3];
+        double R[9];  // TIB, column major
+    };
+
+    void update_shapes();
+    void sweep();
+    void collide(unsigned int s_In, unsigned int t_In);
+    void collide_plane(unsigned int s_In, unsigned int p_In);
+    unsigned int point_box(const Shape &A_In, const double *p_In, const Shape &B_In);
+    void add_contact(const Shape &A_In, const Shape *B_In, unsigned int plane_In, const double *p_In,
+        const double *n_In, double depth_In);
+    void apply_load(Body *body_In, const double *p_In, const double *F_In, double sign_In, double *RHS_Out) const;
+
+    double k;
+    double c;
+    double mu;
+    double friction_vel;
+    std::vector<Shape> shape;
+    std::vector<double> plane_n;  // 3 per plane
+    std::vector<double> plane_d;
+    std::vector<uint64_t> excluded;  // sorted (lower body << 32 | higher body)
+    std::vector<double> lo;  // world AABB of shape s at [3 s, 3 s + 3)
+    std::vector<double> hi;
+    std::vector<unsigned int> order;  // shapes by lo along axis
+    std::vector<double> box;  // AABBs in that order: axis, then the other two, (lo, hi) each
+    unsigned int axis;
+    unsigned long npair;
+    std::vector<Contact> contact;
+};
+
+typedef boost::shared_ptr<Contact_Force> ContactPtr;
+#endif  //CONTACT_HPP
@@ -3,44 +3,275 @@
 
 #include "Body.hpp"
 #include "Joint.hpp"
+#include "Force_Element.hpp"
+#include "Sparse_LDL.hpp"
+#include "Articulated_Solver.hpp"
+#include "Schur_Solver.hpp"
+#include "Profiler.hpp"
+#include "Thread_Pool.hpp"
+#include "Object_Pool.hpp"
+#include "Topology.hpp"
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <utility>
 #include <vector>
 
+enum Solver_Type {
+    DENSE_SOLVER = 0,  // arma::solve on the full KKT matrix
+    SPARSE_SOLVER,  // sparse LDL^T, symbolic factorization done once in init()
+    TREE_SOLVER,  // O(nbody) articulated recursion, dense fallback for closed loops
+    SCHUR_SOLVER,  // banded Cholesky of Cq M^-1 Cq^T, multipliers first
+    ITERATIVE_SOLVER  // block-Jacobi preconditioned CG on Cq M^-1 Cq^T, warm-started
+};
+
+enum Integrator_Type {
+    RK4_INTEGRATOR = 0,  // classic RK4, one step of dt per solve()
+    DOPRI45_INTEGRATOR,  // adaptive Dormand-Prince 5(4), dt is the output interval
+    IMPLICIT_EULER_INTEGRATOR  // backward Euler, Newton on the KKT factors of each stage
+};
+
+/* Per-body slots of the flat state buffer q: STATE_SIZE doubles per body.
+   q_d uses the same slots for the time derivatives. */
+enum State_Slot {
+    STATE_POS = 0,
+    STATE_VEL = 3,
+    STATE_QUAT = 6,
+    STATE_ANG_VEL = 10,
+    STATE_SIZE = 13
+};
+
 class Dynamics_Sys
 {
 public:
     Dynamics_Sys(double dt_In);
     ~Dynamics_Sys() {};
 
-    void Add(BodyPtr bodyPtr_In);
-    void Add(JointPtr jointPtr_In);
+    unsigned int Add(BodyPtr bodyPtr_In);  // returns the body index
+    unsigned int Add(JointPtr jointPtr_In);  // returns the joint index
+    void Add(ForcePtr forcePtr_In);
+
+    /* Constructs a body, joint or force element in this system's arena and
+       adds it, e.g. sys->Create<Mobilized_body>(1, POS, ...) */
+    template <typename T, typename... Args>
+    boost::shared_ptr<T> Create(Args &&...args_In) {
+        boost::shared_ptr<T> obj = boost::allocate_shared<T>(Arena_Allocator<T>(arena), std::forward<Args>(args_In)...);
+        Add(obj);
+        return obj;
+    }
+    JointPtr Create_Joint(Joint_Type Type_In, const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+        const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);  // make_joint() in the arena
     void Cal_Constraints();
+    void Solve_System();  // KKT solve for the current SYS_RHS, one per dynamic_function()
     void Assembly();
     void init();
-    void solve();
+    void init(const Dynamics_Sys &Template_In);
+    bool solve();  // false once a step has failed, see get_failed()
     void output_data(std::ofstream &fout_In);
+    void set_solver(Solver_Type Type_In);
+    void set_integrator(Integrator_Type Type_In);
+    void set_tolerance(double rtol_In, double atol_In);
+    void set_max_step(double h_max_In);
+    void set_alloc_check(bool Check_In);
+    void set_threads(unsigned int nthreads_In, unsigned int min_bodies_In = 512);
+    void set_baumgarte(double alpha_In, double beta_In);
+    void set_quat_gain(double Gain_In);
+    void set_projection(bool position_In, bool velocity_In, double tol_In = 1e-10, unsigned int max_iter_In = 3);
+    void set_degraded(bool reuse_factor_In, bool skip_projection_In);
+    void set_iterative(double tol_In, unsigned int max_iter_In = 0);  // ITERATIVE_SOLVER stopping rule
+    unsigned long get_step_allocs();
 
-    unsigned int get_nbody();
-    unsigned int get_njoint();
+    unsigned int get_nbody() const;
+    unsigned int get_njoint() const;
+    double get_time() const;
+    double get_dt() const;
+    const arma::vec &get_state() const;
+    const arma::vec &get_SYS_ANS() const;
+    unsigned int get_ncons() const;
+    unsigned int get_threads() const;
+    const BodyPtr &get_body(unsigned int i_In) const;
+    const JointPtr &get_joint(unsigned int i_In) const;
+    unsigned int get_joint_row(unsigned int i_In) const;  // first multiplier of joint i_In, set by init()
+    const Topology &get_topology() const;  // loops, grounds and body order, set by init()
+    Profiler &get_profiler();  // empty unless built with -DMBD_PROFILE
+    /* An integrator step that cannot be completed (DOPRI45 step size
+       underflow, implicit Euler Newton failing at the smallest substep) is
+       not committed: q stays at the last accepted state and
+       solve() returns false without stepping until init() or
+       set_integrator() */
+    bool get_failed() const;
+    unsigned long get_feval_count();
+    unsigned long get_reject_count();
+    unsigned long get_newton_count();  // implicit Euler Newton iterations so far
+    unsigned long get_iteration_count();  // CG iterations of ITERATIVE_SOLVER so far
+    unsigned long get_cg_fail_count();  // CG solves that stopped above the tolerance
 
     
 private:
-    void dynamic_function(std::vector<arma::vec> qIn, std::vector<arma::vec> &qdOut);
+    friend class Checkpoint;
+    friend struct Bench_Access;  // bench/bench_chain.cpp
+
+    void dynamic_function(double tIn, const arma::vec &qIn, arma::vec &qdOut);  // tIn: stage time seen by force elements
+    void Update_Kinematics(const arma::vec &qIn);
+    void Project_State();
+    void Init_State();
+    void Init_Handles();
+    void Init_Joints();
+    void Init_Buffers();
+    void Init_Analyzed();
+    bool Same_Topology(const Dynamics_Sys &Other_In) const;
+    void Step_RK4();
+    void Step_DOPRI45();
+    void Step_Implicit();
+    bool Newton_Step(double t_In, double h_In);
+    void Interpolate(double t_In);
+    void Setup_Solver();
+    void Estimate_Cond();
+    void Solve_Frozen();
+    void Solve_Factored(const arma::vec &RHS_In, arma::vec &ANS_Out);
+    void Count_Iterations();
+    void Assemble_Dense();
+    void Assemble_Sparse();
+    void Assemble_Constant();
+
+    /* fn_In(begin, end) over [0, n_In), on the pool for scenes of at least par_min_bodies */
+    template <typename Fn>
+    void Parallel_For(unsigned int n_In, Fn fn_In) {
+        if (pool && nbody >= par_min_bodies) {
+            pool->run(n_In, fn_In);
+        } else {
+            fn_In(0u, n_In);
+        }
+    }
 
-    double dt;
+    double dt;  // RK4 step, or output interval of the adaptive integrator
+    double t_int;  // time of q
+    double t_sample;  // time of the last output sample
     unsigned int nbody;
     unsigned int njoint;
-    arma::mat SYS_Cq;
-    arma::mat SYS_MAT;
+    unsigned int ncons;  // constraint rows: 6 per ground + joint rows
+    arma::mat SYS_MAT;  // [M Cq^T; Cq 0], sized once in init()
     arma::vec SYS_C;
     arma::vec SYS_RHS;
     arma::vec SYS_GAMMA;
+    arma::vec SYS_ANS;  // accelerations followed by Lagrange multipliers
     arma::vec q_dd;
-    std::vector<arma::vec> q_d;
-    std::vector<arma::vec> q;
-    arma::mat SYS_M;
+    arma::vec q_d;
+    arma::vec q;
+
+    /* RK4 workspace, sized in init() and reused by every step */
+    arma::vec q_temp;
+    arma::vec k1;
+    arma::vec k2;
+    arma::vec k3;
+    arma::vec k4;
+    arma::mat SYS_LU;  // dense LU factors
+    std::vector<arma::blas_int> SYS_PIV;
+
+    /* DOPRI45 workspace: k1 is reused as the first-same-as-last stage */
+    Integrator_Type integrator;
+    arma::vec k5;
+    arma::vec k6;
+    arma::vec k7;
+    arma::vec q_new;
+    arma::vec q_out;  // state interpolated at t_sample
+    arma::mat dense_coef;  // interpolation coefficients of the last accepted step
+    double t_old;  // start time of the last accepted step
+    double h;  // next trial step
+    double h_max;  // 0: unlimited
+    double rtol;
+    double atol;
+    bool fsal_valid;  // k1 holds f(q)
+    unsigned long n_feval;
+    unsigned long n_reject;
+    bool step_failed;
+
+    /* Implicit Euler: q_new holds the iterate, k1 f(q_new), q_temp the
+       residual, NEWTON_RES its velocity and pose parts (12 per body) and
+       NEWTON_RHS / NEWTON_ANS the KKT solve of the update; k2 and k3 keep
+       q and q_d of the step start for a rejected step */
+    arma::vec NEWTON_RHS;
+    arma::vec NEWTON_ANS;
+    std::vector<double> NEWTON_RES;
+    unsigned int newton_max_iter;
+    unsigned int newton_max_split;  // halvings of a rejected step before solve() fails
+    unsigned long n_newton;
+
+    bool alloc_check;  // abort when a step allocates (needs -DMBD_ALLOC_COUNTER)
+    unsigned long step_allocs;
+
+    /* Stabilization: GAMMA - 2 alpha Cq v - beta^2 C, and optional projection
+       of q onto C = 0 and Cq v = 0 after every solve() */
+    double baum_alpha;
+    double baum_beta;
+    bool proj_position;
+    bool proj_velocity;
+    double proj_tol;
+    unsigned int proj_max_iter;
+    Schur_Solver PROJ;  // Cq M^-1 Cq^T of the projection
+    arma::vec PROJ_RHS;
+    arma::vec PROJ_ANS;
+
+    /* Degraded steps for deadline-bound callers: solve with the last dense
+       or sparse KKT factors plus one refinement sweep, and/or leave out the
+       projection */
+    bool reuse_factor;
+    bool skip_projection;
+    bool factor_valid;  // SYS_LU or SP_KKT holds factors of an earlier stage
+    bool kkt_valid;  // the last Solve_System() had usable factors, for Solve_Factored()
+    arma::vec SYS_RES;  // refinement residual
+
+    boost::shared_ptr<Thread_Pool> pool;  // null: serial stages
+    unsigned int par_min_bodies;
+
+    Profiler prof;
+    bool cond_pending;  // estimate the condition number at the next Solve_System()
+    std::vector<double> cond_work;
+    std::vector<arma::blas_int> cond_iwork;
+    Topology TOPO;
+    std::vector<unsigned int> ground_row;  // first constraint row of each TOPO.get_ground() body
+    std::vector<unsigned int> joint_row;  // first constraint row of each joint
+    std::vector<unsigned int> joint_col0;  // first state-dependent Cq column of each joint
+
+    Solver_Type solver;
+    Sparse_LDL SP_KKT;
+    Articulated_Solver TREE;
+    Schur_Solver SCHUR;  // also ITERATIVE_SOLVER, in iterative mode
+    double iter_tol;
+    unsigned int iter_max_iter;
+    unsigned long n_iter;
+    unsigned long n_cg_fail;
+    std::vector<unsigned int> sp_mass_idx;  // 36 value slots per body mass block
+    std::vector<unsigned int> sp_joint_idx;  // Cqi, Cqj, Cqi^T, Cqj^T slots, 24 per joint row
+    std::vector<unsigned int> sp_joint_off;  // first sp_joint_idx entry of each joint
 
     std::vector<BodyPtr> Body_ptr_array;
     std::vector<JointPtr> Joint_ptr_array; 
+    std::vector<ForcePtr> Force_ptr_array;  // applied in order at every stage
+    boost::shared_ptr<Object_Arena> arena;  // storage of the Create()d objects
+
+    /* Plain pointers and body indices for the per-stage loops, set in init():
+       no reference counting there. Bodies are partitioned by dynamic type,
+       exact Mobilized_body objects are updated in batches without virtual
+       dispatch, grounds are skipped and any other type goes through
+       Body::update(). */
+    std::vector<Body *> Body_array;
+    std::vector<Joint *> Joint_array;
+    std::vector<unsigned int> joint_body_i;
+    std::vector<unsigned int> joint_body_j;
+    std::vector<Mobilized_body *> Mobilized_array;
+    std::vector<unsigned int> virtual_body;
+
+    /* Structure-of-arrays buffers of the Mobilized_array update, one item per
+       body: quaternion, angular velocity, quat_gain, TBI and quaternion rate
+       (Math.hpp batch kernels). The Euler angles are left to
+       Body::get_ANGLE(). */
+    std::vector<double> BATCH_Q;
+    std::vector<double> BATCH_W;
+    std::vector<double> BATCH_GAIN;
+    std::vector<double> BATCH_TBI;
+    std::vector<double> BATCH_QD;
 };
 
+typedef boost::shared_ptr<Dynamics_Sys> DynSysPtr;
+
 #endif  //DYNAMICS_HPP
\ No newline at end of file
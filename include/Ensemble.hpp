@@ -0,0 +1,48 @@
+#ifndef ENSEMBLE_HPP
+#define ENSEMBLE_HPP
+
+#include "Dynamics_System.hpp"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Runs N independent systems of identical topology on a work-stealing thread
+   pool. Member 0 is initialized normally; the others copy its symbolic
+   structure (constraint offsets, sparse pattern and elimination tree).
+   Each worker owns a deque of members: it pops from the back of its own
+   and steals from the front of the others once it runs dry. */
+class Ensemble
+{
+public:
+    Ensemble(unsigned int nthreads_In = 0);  // 0: one thread per hardware core
+    ~Ensemble() {};
+
+    void Add(DynSysPtr sysPtr_In);
+    void init();
+    void run(unsigned int nsteps_In, const std::string &prefix_In, unsigned int output_every_In = 1);
+
+    unsigned int get_nmember();
+    unsigned int get_nthreads();
+    DynSysPtr get_member(unsigned int i);
+
+private:
+    struct Task_Queue {
+        std::mutex lock;
+        std::deque<unsigned int> tasks;
+    };
+
+    bool Pop_Task(unsigned int worker, unsigned int &task);
+    void Worker_Loop(unsigned int worker);
+    void Run_Member(unsigned int i);
+
+    unsigned int nthreads;
+    unsigned int nsteps;
+    unsigned int output_every;
+    std::string prefix;  // member i writes <prefix><i>.csv, empty: no output
+    std::vector<DynSysPtr> members;
+    std::vector<std::unique_ptr<Task_Queue> > queues;
+};
+
+#endif  //ENSEMBLE_HPP
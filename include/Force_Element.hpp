@@ -0,0 +1,87 @@
+#ifndef FORCE_ELEMENT_HPP
+#define FORCE_ELEMENT_HPP
+
+#include <armadillo>
+#include "Body.hpp"
+#include <boost/shared_ptr.hpp>
+#include <functional>
+#include <vector>
+
+/* Loads evaluated at every integrator stage. Dynamics_Sys::dynamic_function()
+   calls apply() after Cal_Constraints() has written the body loads, with the
+   bodies at the stage state; apply() adds into the body block of SYS_RHS in
+   place, 6 doubles per body numbered as in the system: force in the inertial
+   frame, then torque in the body frame. Elements can be retuned or switched
+   off between steps without rebuilding the scene. */
+class Force_Element
+{
+public:
+    Force_Element() : active(true) {};
+    virtual ~Force_Element() = default;
+
+    virtual void apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) = 0;
+    void set_active(bool active_In) { active = active_In; }
+    bool is_active() const { return active; }
+
+protected:
+    bool active;
+};
+
+/* Uniform field: m g on every Mobilized_body */
+class Gravity_Field : public Force_Element
+{
+public:
+    Gravity_Field(const arma::vec &g_In);
+
+    virtual void apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) override;
+    void set_g(const arma::vec &g_In);
+    const arma::vec3 &get_g() const;
+
+private:
+    arma::vec3 g;
+};
+
+/* Linear spring-damper between the points pi on body i and pj on body j
+   (body frames): f = k (L - L0) + c dL/dt along the line between them,
+   pulling the points together when positive */
+class Spring_Damper : public Force_Element
+{
+public:
+    Spring_Damper(BodyPtr i_In, BodyPtr j_In, const arma::vec &piIn, const arma::vec &pjIn,
+        double k_In, double c_In, double L0_In);
+
+    virtual void apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) override;
+    void set_stiffness(double k_In);
+    void set_damping(double c_In);
+    void set_rest_length(double L0_In);
+    double get_length() const;  // at the last evaluated stage
+    double get_tension() const;
+
+private:
+    BodyPtr body_i_ptr;
+    BodyPtr body_j_ptr;
+    arma::vec3 pi;
+    arma::vec3 pj;
+    double k;
+    double c;
+    double L0;
+    double L;
+    double f;
+};
+
+/* User loads, called with the same arguments as Force_Element::apply() */
+typedef std::function<void(double, const std::vector<BodyPtr> &, double *)> Force_Callback;
+
+class Callback_Force : public Force_Element
+{
+public:
+    Callback_Force(const Force_Callback &fn_In);
+
+    virtual void apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) override;
+
+private:
+    Force_Callback fn;
+};
+
+typedef boost::shared_ptr<Force_Element> ForcePtr;
+#endif  //FORCE_ELEMENT_HPP
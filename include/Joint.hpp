@@ -3,55 +3,260 @@
 #include <armadillo>
 #include "Math.hpp"
 #include "Body.hpp"
+#include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <memory>
 
+enum Joint_Type {
+    SPHERICAL_JOINT = 0,  // 3 rows: coincident points
+    REVOLUTE_JOINT,  // 5 rows: spherical + axis qi on body i parallel to qj on body j
+    PRISMATIC_JOINT,  // 5 rows: no relative rotation, slides along qi of body i
+    FIXED_JOINT,  // 6 rows: spherical + no relative rotation
+    UNIVERSAL_JOINT  // 4 rows: spherical + qi on body i perpendicular to qj on body j
+};
 
+/* Constraint between body i and body j at the points pi, pj (body frames);
+   qi, qj are the joint axes in the body frames where the type uses them.
+   The base class computes the shared kinematics in update() and the derived
+   Joint_Rows<NROWS> types fill fixed-size constraint blocks; Dynamics_Sys
+   only sees the row count through get_Cqi().n_rows. */
 class Joint : public boost::enable_shared_from_this<Joint>
 {
 public:
-    Joint(unsigned int TypeIn, arma::vec piIn, arma::vec pjIn, arma::vec qiIn,
-            arma::vec qjIn, BodyPtr i_In, BodyPtr j_In);
-    ~Joint() {};
-    void Build_C();
-    void Build_Cq();
-    void Build_GAMMA();
+    Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);
+    virtual ~Joint() = default;
     void update();
+    virtual void set_reference() {};  // capture the relative orientation, called by Dynamics_Sys::init()
+    virtual arma::vec6 get_reference() const;  // captured reference vectors, zeros if the type has none
+    virtual void load_reference(const arma::vec6 &Ref_In) {};  // reference saved by get_reference()
+
+    virtual Joint_Type get_type() const = 0;
+    virtual const arma::mat &get_Cqi() const = 0;
+    virtual const arma::mat &get_Cqj() const = 0;
+    virtual const arma::vec &get_GAMMA() const = 0;
+    virtual const arma::vec &get_CONSTRAINT() const = 0;
+    virtual unsigned int get_varying_col() const;  // Cq columns before this one are constant
+    const arma::vec3 &get_Pi() const;
+    const arma::vec3 &get_Pj() const;
+    const arma::vec3 &get_pi() const;
+    const arma::vec3 &get_pj() const;
+    const arma::vec3 &get_qi() const;
+    const arma::vec3 &get_qj() const;
+    const BodyPtr &get_body_i_ptr() const;  // by reference, no reference count traffic
+    const BodyPtr &get_body_j_ptr() const;
+
+protected:
+    virtual void Build_Rows() = 0;  // C, Cq and GAMMA of the current state
 
-    arma::mat get_Cqi();
-    arma::mat get_Cqj();
-    arma::vec get_GAMMA();
-    arma::vec get_Pi();
-    arma::vec get_Pj();
-    arma::vec get_pi();
-    arma::vec get_pj();
-    arma::vec get_CONSTRAINT();
-    BodyPtr get_body_i_ptr();
-    BodyPtr get_body_j_ptr();
-
-private:
-    unsigned int Type;  
-    arma::vec pi;
-    arma::vec pj;
-    arma::vec qi;
-    arma::vec qj;
-    arma::mat Cqi;
-    arma::mat Cqj;
-    arma::vec GAMMA;
-    arma::vec CONSTRAINT;
-    arma::mat TBI_i;
-    arma::mat TBI_j;
-    arma::vec Pi;
-    arma::vec Pj;
-    arma::vec Qi;
-    arma::vec Qj;
-    arma::vec wi;
-    arma::vec wj;
-    arma::vec Si;
-    arma::vec Sj;
+    arma::vec3 pi;
+    arma::vec3 pj;
+    arma::vec3 qi;
+    arma::vec3 qj;
+    arma::mat33 TIB_i;  // transposed once per update()
+    arma::mat33 TIB_j;
+    arma::vec3 Pi;
+    arma::vec3 Pj;
+    arma::vec3 Qi;
+    arma::vec3 Qj;
+    arma::vec3 wi;
+    arma::vec3 wj;
+    arma::vec3 Wi;  // angular velocities in the inertial frame
+    arma::vec3 Wj;
+    arma::vec3 Si;
+    arma::vec3 Sj;
+    arma::vec3 Vi;
+    arma::vec3 Vj;
     BodyPtr body_i_ptr;
     BodyPtr body_j_ptr;
 };
 
+/* Fixed-size storage for an NROWS-row joint plus the row builders the joint
+   types are made of. Rotational Cq columns act on the body-frame angular
+   velocity, translational ones on the inertial velocity. */
+template <unsigned int NROWS>
+class Joint_Rows : public Joint
+{
+public:
+    Joint_Rows(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) :
+        Joint(piIn, pjIn, qiIn, qjIn, i_In, j_In),
+        Cqi(arma::fill::zeros),
+        Cqj(arma::fill::zeros),
+        GAMMA(arma::fill::zeros),
+        CONSTRAINT(arma::fill::zeros) {};
+
+    virtual const arma::mat &get_Cqi() const override { return Cqi; }
+    virtual const arma::mat &get_Cqj() const override { return Cqj; }
+    virtual const arma::vec &get_GAMMA() const override { return GAMMA; }
+    virtual const arma::vec &get_CONSTRAINT() const override { return CONSTRAINT; }
+
+protected:
+    /* Rows r0..r0+2: Si + Pi - Sj - Pj = 0. Cqi = [I, -[Pi x] TIB_i],
+       Cqj = [-I, [Pj x] TIB_j]; the identity blocks are constant and set
+       by Set_Spherical_Identity() in the constructor. */
+    void Set_Spherical_Identity(unsigned int r0) {
+        Cqi.submat(r0, 0, r0 + 2, 2).eye();
+        Cqj.submat(r0, 0, r0 + 2, 2) = -arma::eye<arma::mat>(3, 3);
+    }
+    void Spherical_Rows(unsigned int r0) {
+        arma::mat33 Skew_Omega_i, Skew_Omega_j, Skew_P;
+
+        skew_sym(wi, Skew_Omega_i);
+        skew_sym(wj, Skew_Omega_j);
+        CONSTRAINT.subvec(r0, r0 + 2) = Si + Pi - Sj - Pj;
+        skew_sym(Pi, Skew_P);
+        Cqi.submat(r0, 3, r0 + 2, 5) = -Skew_P * TIB_i;
+        skew_sym(Pj, Skew_P);
+        Cqj.submat(r0, 3, r0 + 2, 5) = Skew_P * TIB_j;
+        GAMMA.subvec(r0, r0 + 2) = -TIB_i * Skew_Omega_i * Skew_Omega_i * pi + TIB_j * Skew_Omega_j * Skew_Omega_j * pj;
+    }
+
+    /* Row r: (TIB_i a_i) . (TIB_j b_j) = 0 for body-frame directions a_i, b_j */
+    void Dot_Row(unsigned int r, const arma::vec3 &a_i, const arma::vec3 &b_j) {
+        arma::vec3 u = TIB_i * a_i;
+        arma::vec3 w = TIB_j * b_j;
+        arma::vec3 n = arma::cross(u, w);
+        arma::vec3 Wu = arma::cross(Wi, u);
+        arma::vec3 Ww = arma::cross(Wj, w);
+
+        CONSTRAINT(r) = arma::dot(u, w);
+        for (unsigned int c = 0; c < 3; c++) {
+            Cqi(r, 3 + c) = arma::dot(n, TIB_i.col(c));
+            Cqj(r, 3 + c) = -arma::dot(n, TIB_j.col(c));
+        }
+        GAMMA(r) = -(arma::dot(arma::cross(Wi, Wu), w) + 2.0 * arma::dot(Wu, Ww) + arma::dot(u, arma::cross(Wj, Ww)));
+    }
+
+    /* Row r: d . (TIB_i b_i) = 0 with d = Sj + Pj - Si - Pi, no sliding across b_i.
+       Its translational columns depend on the state. */
+    void Slide_Row(unsigned int r, const arma::vec3 &b_i) {
+        arma::vec3 u = TIB_i * b_i;
+        arma::vec3 d = Sj + Pj - Si - Pi;
+        arma::vec3 d_dot = Vj - Vi + arma::cross(Wj, Pj) - arma::cross(Wi, Pi);
+        arma::vec3 ni = arma::cross(u, Pi + d);
+        arma::vec3 nj = arma::cross(Pj, u);
+        arma::vec3 Wu = arma::cross(Wi, u);
+
+        CONSTRAINT(r) = arma::dot(u, d);
+        for (unsigned int c = 0; c < 3; c++) {
+            Cqi(r, c) = -u(c);
+            Cqj(r, c) = u(c);
+            Cqi(r, 3 + c) = arma::dot(ni, TIB_i.col(c));
+            Cqj(r, 3 + c) = arma::dot(nj, TIB_j.col(c));
+        }
+        GAMMA(r) = -(arma::dot(arma::cross(Wi, Wu), d) + 2.0 * arma::dot(Wu, d_dot)
+            + arma::dot(u, arma::cross(Wj, arma::cross(Wj, Pj)) - arma::cross(Wi, arma::cross(Wi, Pi))));
+    }
+
+    arma::mat::fixed<NROWS, 6> Cqi;
+    arma::mat::fixed<NROWS, 6> Cqj;
+    arma::vec::fixed<NROWS> GAMMA;
+    arma::vec::fixed<NROWS> CONSTRAINT;
+};
+
+class Spherical_Joint : public Joint_Rows<3>
+{
+public:
+    Spherical_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);
+    virtual Joint_Type get_type() const override { return SPHERICAL_JOINT; }
+
+protected:
+    virtual void Build_Rows() override;
+};
+
+class Revolute_Joint : public Joint_Rows<5>
+{
+public:
+    Revolute_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);
+    virtual Joint_Type get_type() const override { return REVOLUTE_JOINT; }
+
+protected:
+    virtual void Build_Rows() override;
+
+    arma::vec3 ai;  // unit axis on body i
+    arma::vec3 bj1;  // unit vectors on body j perpendicular to qj
+    arma::vec3 bj2;
+};
+
+class Prismatic_Joint : public Joint_Rows<5>
+{
+public:
+    Prismatic_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);
+    virtual Joint_Type get_type() const override { return PRISMATIC_JOINT; }
+    virtual void set_reference() override;
+    virtual arma::vec6 get_reference() const override;
+    virtual void load_reference(const arma::vec6 &Ref_In) override;
+    virtual unsigned int get_varying_col() const override { return 0; }
+
+protected:
+    virtual void Build_Rows() override;
+
+    arma::vec3 ai;  // slide axis and its normals on body i
+    arma::vec3 bi1;
+    arma::vec3 bi2;
+    arma::vec3 bj1;  // bi1, bi2 in the body j frame at the reference
+    arma::vec3 bj2;
+};
+
+class Fixed_Joint : public Joint_Rows<6>
+{
+public:
+    Fixed_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);
+    virtual Joint_Type get_type() const override { return FIXED_JOINT; }
+    virtual void set_reference() override;
+    virtual arma::vec6 get_reference() const override;
+    virtual void load_reference(const arma::vec6 &Ref_In) override;
+
+protected:
+    virtual void Build_Rows() override;
+
+    arma::vec3 ai;  // body i triad (qi or x, and two normals)
+    arma::vec3 bi1;
+    arma::vec3 bi2;
+    arma::vec3 bj1;  // bi1, bi2 in the body j frame at the reference
+    arma::vec3 bj2;
+};
+
+class Universal_Joint : public Joint_Rows<4>
+{
+public:
+    Universal_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);
+    virtual Joint_Type get_type() const override { return UNIVERSAL_JOINT; }
+
+protected:
+    virtual void Build_Rows() override;
+
+    arma::vec3 ai;  // unit cross axes, ai on body i and aj on body j
+    arma::vec3 aj;
+};
+
 typedef boost::shared_ptr<Joint> JointPtr;
-#endif  //JOINT_HPP
\ No newline at end of file
+
+/* Joint of the given type allocated through Alloc_In (boost::allocate_shared) */
+template <typename Alloc>
+JointPtr allocate_joint(const Alloc &Alloc_In, Joint_Type Type_In, const arma::vec &piIn, const arma::vec &pjIn,
+        const arma::vec &qiIn, const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) {
+    switch (Type_In) {
+        case REVOLUTE_JOINT:
+            return boost::allocate_shared<Revolute_Joint>(Alloc_In, piIn, pjIn, qiIn, qjIn, i_In, j_In);
+        case PRISMATIC_JOINT:
+            return boost::allocate_shared<Prismatic_Joint>(Alloc_In, piIn, pjIn, qiIn, qjIn, i_In, j_In);
+        case FIXED_JOINT:
+            return boost::allocate_shared<Fixed_Joint>(Alloc_In, piIn, pjIn, qiIn, qjIn, i_In, j_In);
+        case UNIVERSAL_JOINT:
+            return boost::allocate_shared<Universal_Joint>(Alloc_In, piIn, pjIn, qiIn, qjIn, i_In, j_In);
+        default:
+            return boost::allocate_shared<Spherical_Joint>(Alloc_In, piIn, pjIn, qiIn, qjIn, i_In, j_In);
+    }
+}
+
+JointPtr make_joint(Joint_Type Type_In, const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+        const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In);
+#endif  //JOINT_HPP
@@ -5,9 +5,22 @@
 
 void build_psi_tht_phi_TM(const double &psi, const double &tht, const double &phi, arma::mat &AMAT);
 arma::mat skew_sym(arma::vec3 const &vec);
-void Matrix2Quaternion(arma::mat33 Matrix_in, arma::vec &Quaternion);
+void skew_sym(arma::vec3 const &vec, arma::mat33 &Matrix_out);
+void Matrix2Quaternion(const arma::mat33 &Matrix_in, arma::vec &Quaternion);
 void Quaternion2Matrix(arma::vec4 const &Quaternion_in, arma::mat &Matrix_out);
 arma::vec3 euler_angle(const arma::mat33 &TBD_in);
 int sign(const double &variable);
 
+/* Batch forms of Quaternion2Matrix() and of the Mobilized_body quaternion
+   rate, used by Dynamics_Sys::Update_Kinematics(), over n items in
+   structure-of-arrays layout: component k of item i is X[k * ld + i].
+   Quaternions have 4 components, rotation matrices 9 (element (r, c) is
+   component 3 r + c, as TBI), angular velocities 3. The kernels use AVX-512
+   or AVX when the build targets them (NATIVE=1 / MBD_NATIVE) with a scalar
+   tail. They round like the per-item functions, except where the compiler
+   contracts the scalar code into FMA instructions. */
+void Quaternion2Matrix_batch(unsigned int n, const double *Q_In, double *R_Out, unsigned int ld);
+void quaternion_rate_batch(unsigned int n, const double *Q_In, const double *W_In, const double *Gain_In,
+    double *QD_Out, unsigned int ld);
+
 #endif
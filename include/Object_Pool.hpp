@@ -0,0 +1,59 @@
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/* Bump allocator for the bodies and joints of one system. Objects are laid
+   out back to back in 64 KiB blocks, so the per-stage loops walk memory in
+   order instead of chasing one heap allocation per object. Nothing is
+   released before the arena itself; it is not thread-safe and is meant for
+   scene setup. */
+class Object_Arena
+{
+public:
+    Object_Arena() : used(0) {};
+
+    void *allocate(std::size_t bytes_In, std::size_t align_In);
+    std::size_t get_bytes() const;  // reserved so far
+
+private:
+    static const std::size_t BLOCK_BYTES = 64 * 1024;
+
+    Object_Arena(const Object_Arena &);
+    Object_Arena &operator=(const Object_Arena &);
+
+    std::vector<std::unique_ptr<char[]> > blocks;
+    std::vector<std::size_t> block_bytes;
+    std::size_t used;  // bytes taken from the last block
+};
+
+/* Allocator for boost::allocate_shared: the object and its control block go
+   into the arena, and every copy keeps the arena alive, so a handle may
+   outlive the Dynamics_Sys that created it */
+template <typename T>
+class Arena_Allocator
+{
+public:
+    typedef T value_type;
+
+    explicit Arena_Allocator(const boost::shared_ptr<Object_Arena> &arena_In) : arena(arena_In) {};
+    template <typename U>
+    Arena_Allocator(const Arena_Allocator<U> &Other_In) : arena(Other_In.arena) {};
+
+    T *allocate(std::size_t n_In) {
+        return static_cast<T *>(arena->allocate(n_In * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, std::size_t) {}
+
+    template <typename U>
+    bool operator==(const Arena_Allocator<U> &Other_In) const { return arena == Other_In.arena; }
+    template <typename U>
+    bool operator!=(const Arena_Allocator<U> &Other_In) const { return arena != Other_In.arena; }
+
+    boost::shared_ptr<Object_Arena> arena;
+};
+
+#endif  //OBJECT_POOL_HPP
@@ -0,0 +1,96 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Phases timed inside solve() */
+enum Prof_Phase {
+    PROF_STEP = 0,  // a whole solve() call
+    PROF_BODY_UPDATE,  // Body::update over all bodies
+    PROF_JOINT_UPDATE,  // Joint::update (Jacobians) over all joints
+    PROF_CONSTRAINTS,  // Cal_Constraints: KKT assembly
+    PROF_LINEAR_SOLVE,  // Solve_System: factorization and solve
+    PROF_PROJECTION,  // post-step constraint projection, includes its own updates
+    PROF_N_PHASE
+};
+
+/* Per-phase cumulative time and call counts plus per-step solver statistics.
+   Dynamics_Sys feeds it only when built with -DMBD_PROFILE (make PROFILE=1);
+   otherwise the MBD_PROF_* macros expand to nothing and it stays empty. */
+class Profiler
+{
+public:
+    Profiler();
+    ~Profiler() {};
+
+    static bool enabled();
+
+    void begin(Prof_Phase phase_In);
+    void end(Prof_Phase phase_In);
+    void end_step(unsigned int kkt_dim_In, double drift_In);
+    void set_cond(double cond_In);
+    void add_iterations(unsigned int iter_In, double residual_In, bool converged_In);  // one iterative linear solve
+
+    void set_summary_every(unsigned long steps_In);
+    void set_cond_every(unsigned long steps_In);
+    void set_trace_capacity(unsigned long events_In);
+    bool cond_due() const;
+
+    double get_time(Prof_Phase phase_In) const;  // seconds
+    unsigned long get_calls(Prof_Phase phase_In) const;
+    unsigned long get_steps() const;
+    unsigned int get_kkt_dim() const;
+    double get_cond() const;  // last estimate, 0 if never measured
+    double get_drift() const;  // |SYS_C| after the last step
+    double get_max_drift() const;
+    unsigned long get_iter_solves() const;
+    unsigned long get_iter_fails() const;  // iterative solves stopped by max_iter above the tolerance
+    unsigned long get_iterations() const;  // summed over the iterative solves
+    double get_residual() const;  // relative residual of the last iterative solve
+    double get_max_residual() const;
+
+    void reset();
+    void print_summary(std::ostream &out_In) const;
+    bool write_chrome_trace(const std::string &file_In) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Trace_Event {
+        unsigned int phase;
+        long long begin_ns;
+        long long dur_ns;
+    };
+
+    Clock::time_point origin;
+    Clock::time_point start[PROF_N_PHASE];
+    long long total_ns[PROF_N_PHASE];
+    unsigned long calls[PROF_N_PHASE];
+    unsigned long steps;
+    unsigned long summary_every;
+    unsigned long cond_every;
+    unsigned int kkt_dim;
+    double cond;
+    double drift;
+    double max_drift;
+    unsigned long iter_solves;
+    unsigned long iter_fails;
+    unsigned long iterations;
+    double residual;
+    double max_residual;
+    std::vector<Trace_Event> trace;  // preallocated, recording stops when full
+    unsigned long trace_capacity;
+};
+
+#ifdef MBD_PROFILE
+#define MBD_PROF_BEGIN(prof, phase) (prof).begin(phase)
+#define MBD_PROF_END(prof, phase) (prof).end(phase)
+#else
+#define MBD_PROF_BEGIN(prof, phase) ((void)0)
+#define MBD_PROF_END(prof, phase) ((void)0)
+#endif
+
+#endif  //PROFILER_HPP
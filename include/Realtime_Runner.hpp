@@ -0,0 +1,106 @@
+#ifndef REALTIME_RUNNER_HPP
+#define REALTIME_RUNNER_HPP
+
+#include "Dynamics_System.hpp"
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+/* External load of one body, added to the force and applied torque it was built with */
+struct Load_Input {
+    double force[3];
+    double torque[3];
+};
+
+/* Latest-value mailbox from one control thread to the stepping thread. It is
+   a triple buffer: the writer stages loads with post() and swaps them in with
+   publish(), the reader picks up the newest published set in take(). Neither
+   side waits on the other or locks. */
+class Input_Mailbox
+{
+public:
+    Input_Mailbox();
+
+    void init(unsigned int nbody_In);  // before either thread starts
+    void post(unsigned int body_In, const arma::vec &force_In, const arma::vec &torque_In);  // writer
+    void publish();  // writer
+    const Load_Input *take(bool &fresh_Out);  // reader; fresh_Out: published since the last take()
+
+private:
+    Input_Mailbox(const Input_Mailbox &);
+    Input_Mailbox &operator=(const Input_Mailbox &);
+
+    std::vector<Load_Input> staged;  // writer only, keeps the loads not re-posted
+    std::vector<Load_Input> slot[3];
+    alignas(64) std::atomic<unsigned int> middle;  // slot index, FRESH_BIT when unread
+    alignas(64) unsigned int back;  // writer's slot
+    alignas(64) unsigned int front;  // reader's slot
+};
+
+/* What run() does after a step overran into the following periods */
+enum RT_Overrun {
+    RT_CATCH_UP = 0,  // start the missed steps back to back, simulated time stays on the wall clock
+    RT_SKIP  // drop the missed periods and wait for the next release
+};
+
+struct RT_Stats {
+    unsigned long steps;
+    unsigned long overruns;  // steps that finished after their deadline
+    unsigned long skipped;  // periods dropped under RT_SKIP
+    unsigned long degraded;  // steps without the constraint projection
+    unsigned long frozen;  // of those, steps that also reused the KKT factors
+    double max_jitter;  // release lateness, seconds
+    double sum_jitter;
+    double max_exec;  // solve() wall time, seconds
+    double sum_exec;
+    double bin;  // histogram bin width, seconds
+    std::vector<unsigned long> jitter_hist;  // the last bin collects everything above
+    std::vector<unsigned long> exec_hist;
+};
+
+/* Paces Dynamics_Sys::solve() against the monotonic clock, one step per
+   period (normally the system dt). Before each step it checks the time left
+   to the deadline against the slowest recent step of each quality level and
+   degrades when the full step would not fit: first without the projection,
+   then also on the previous KKT factors, for at most max_frozen steps in a
+   row. Nothing on the stepping path allocates or locks. */
+class Realtime_Runner
+{
+public:
+    Realtime_Runner(Dynamics_Sys &sys_In, double period_In);
+
+    void set_overrun(RT_Overrun policy_In);
+    void set_histogram(double bin_In, unsigned int nbins_In);
+    void set_degrade(bool allowed_In, unsigned int max_frozen_In = 8);
+    void set_spin(double spin_In);  // busy-wait the last spin_In seconds before a release
+
+    Input_Mailbox &get_mailbox();
+    unsigned long run(unsigned long nsteps_In);  // 0: until stop() or a failed step; returns the steps run
+    void stop();  // any thread
+    const RT_Stats &get_stats() const;
+    void reset_stats();
+    void print_report(std::ostream &out_In) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void Apply_Inputs();
+    unsigned int Choose_Level(double remaining_In) const;
+    void Record(double jitter_In, double exec_In);
+
+    Dynamics_Sys &sys;
+    Clock::duration period;
+    RT_Overrun policy;
+    bool degrade;
+    unsigned int max_frozen;
+    unsigned int frozen_run;  // consecutive steps on old factors
+    Clock::duration spin;
+    double level_cost[3];  // slowest recent step of each level, seconds: full, no projection, frozen
+    std::vector<Load_Input> base;  // loads the bodies were built with
+    Input_Mailbox mailbox;
+    std::atomic<bool> stop_flag;
+    RT_Stats stats;
+};
+
+#endif  //REALTIME_RUNNER_HPP
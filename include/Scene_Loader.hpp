@@ -0,0 +1,59 @@
+#ifndef SCENE_LOADER_HPP
+#define SCENE_LOADER_HPP
+
+#include "Dynamics_System.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Binary scene cache: this header, one Scene_Force per force element, then a
+   Checkpoint of the system right after Assembly() and init(), saved with its
+   analysis (topology, constraint rows, sparse symbolic factorization and
+   value slots). It is valid for the scene file whose FNV-1a hash and size it
+   records. */
+struct Scene_Cache_Header {
+    char magic[8];  // "MBDSCNC"
+    uint32_t version;
+    uint32_t nforce;
+    uint64_t source_hash;
+    uint64_t source_bytes;
+    uint32_t threads;  // set_threads() arguments, 0: serial
+    uint32_t par_min_bodies;
+    uint64_t ckpt_bytes;
+    char reserved[8];
+};
+
+struct Scene_Force {
+    uint32_t type;  // 0: gravity, 1: spring-damper
+    uint32_t body_i;
+    uint32_t body_j;
+    uint32_t reserved;
+    double a[3];  // g, or pi of the spring
+    double b[3];  // pj of the spring
+    double k;
+    double c;
+    double L0;
+};
+
+/* Builds a system from a JSON scene (format in README.md, example in
+   scenes/chain.json): bodies, joints, force elements and solver settings.
+   The returned system is assembled and initialized. With a cache path the
+   first load writes the cache and later loads of the unchanged scene map it
+   and restore the system without parsing or Assembly(). */
+class Scene_Loader
+{
+public:
+    static DynSysPtr load(const std::string &file_In, const std::string &cache_In = "");
+    static DynSysPtr parse(const std::string &text_In);
+
+private:
+    static DynSysPtr Build(const std::string &text_In, std::vector<Scene_Force> &forces_Out,
+        unsigned int &threads_Out, unsigned int &min_bodies_Out);
+    static void Add_Forces(Dynamics_Sys &sys_In, const std::vector<Scene_Force> &forces_In);
+    static DynSysPtr Read_Cache(const std::string &cache_In, uint64_t hash_In, uint64_t bytes_In);
+    static bool Write_Cache(const std::string &cache_In, const Dynamics_Sys &sys_In, uint64_t hash_In,
+        uint64_t bytes_In, const std::vector<Scene_Force> &forces_In, unsigned int threads_In,
+        unsigned int min_bodies_In);
+};
+
+#endif  //SCENE_LOADER_HPP
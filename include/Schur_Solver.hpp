@@ -0,0 +1,87 @@
+#ifndef SCHUR_SOLVER_HPP
+#define SCHUR_SOLVER_HPP
+
+#include <armadillo>
+#include "Body.hpp"
+#include "Joint.hpp"
+#include <vector>
+
+/* Constraint-space solve of the KKT system [M Cq^T; Cq 0] [a; lambda] = [F; GAMMA].
+   M is block diagonal, so its 6 x 6 inverses are formed once in build() and
+   the multipliers follow from the SPD system
+       (Cq M^-1 Cq^T) lambda = Cq M^-1 F - GAMMA,
+   then a = M^-1 (F - Cq^T lambda). Constraint blocks only couple through a
+   shared body, which keeps Cq M^-1 Cq^T banded when the rows follow the
+   body order of Topology::constraint_rows(); it is factored with a banded
+   Cholesky of the bandwidth found in build().
+
+   In iterative mode (set_iterative()) factor() only inverts the diagonal
+   block of every constraint block and solve() runs conjugate gradients on
+   the same system with that block-Jacobi preconditioner: matrix-free over
+   the incidences, warm-started from the multipliers in ANS_Out, stopped at
+   |r| <= tol |Cq M^-1 F - GAMMA|. */
+class Schur_Solver
+{
+public:
+    Schur_Solver();
+    ~Schur_Solver() {};
+
+    void build(std::vector<BodyPtr> &Body_In, std::vector<JointPtr> &Joint_In,
+        const std::vector<unsigned int> &joint_row_In, const std::vector<unsigned int> &ground_In,
+        const std::vector<unsigned int> &ground_row_In, unsigned int ncons_In);
+    bool factor();
+    void solve(const arma::vec &RHS_In, arma::vec &ANS_Out);
+
+    unsigned int get_bandwidth() const;
+    double pivot_ratio() const;
+    /* max_iter_In 0: ncons iterations, where CG terminates in exact arithmetic */
+    void set_iterative(bool iterative_In, double tol_In = 1e-10, unsigned int max_iter_In = 0);
+    bool is_iterative() const;
+    unsigned int get_iterations() const;  // of the last solve()
+    double get_residual() const;  // relative residual of the last solve()
+
+private:
+    /* One constraint block acting on one body: the rows of a ground, or
+       one side (Cqi or Cqj) of a joint */
+    struct Incidence {
+        unsigned int body;
+        unsigned int row;  // first multiplier row
+        unsigned int dim;
+        unsigned int blk;  // constraint block: ground g, or joint i after the grounds
+        const double *Cq;  // dim x 6, column major, owned by the joint
+        double W[36];  // Cq M^-1 of the current stage
+    };
+
+    double &band(unsigned int i, unsigned int j);
+    bool factor_blocks();
+    void multiply(const std::vector<double> &x_In, std::vector<double> &y_Out) const;
+    void precondition(const std::vector<double> &r_In, std::vector<double> &z_Out) const;
+    void pcg(const arma::vec &ANS_In);
+
+    unsigned int nbody;
+    unsigned int ncons;
+    unsigned int kd;  // half bandwidth of Cq M^-1 Cq^T
+    std::vector<arma::mat66> Minv;
+    std::vector<Incidence> inc;  // grouped by body
+    std::vector<unsigned int> inc_ptr;  // incidences of body b: [inc_ptr[b], inc_ptr[b + 1])
+    std::vector<double> S;  // lower band, column j at S[j * (kd + 1)], overwritten by L
+    std::vector<double> y;
+    arma::mat66 ground_Cq;
+
+    bool iterative;
+    double cg_tol;
+    unsigned int cg_max_iter;
+    unsigned int cg_iter;
+    double cg_res;
+    std::vector<unsigned int> blk_row;  // first row of each constraint block
+    std::vector<unsigned int> blk_dim;
+    std::vector<unsigned int> blk_off;  // Cholesky factor of the diagonal block at P[blk_off[k]], column major
+    std::vector<double> P;
+    std::vector<double> lam;  // CG iterate, residual, preconditioned residual, direction and S p
+    std::vector<double> res;
+    std::vector<double> z;
+    std::vector<double> dir;
+    std::vector<double> Sd;
+};
+
+#endif  //SCHUR_SOLVER_HPP
@@ -0,0 +1,54 @@
+#ifndef SPARSE_LDL_HPP
+#define SPARSE_LDL_HPP
+
+#include <armadillo>
+#include <vector>
+
+/* Sparse LDL^T factorization of a symmetric matrix stored as full CSC.
+   The pattern is analysed once (elimination tree and column counts of L),
+   afterwards only the numeric factorization is repeated when the values
+   change. No pivoting is done: the pivot order given to set_order() must
+   put every constraint row after the body blocks (positive definite M) it
+   acts on, as Topology::kkt_order() does; the default is the natural order. */
+class Sparse_LDL
+{
+public:
+    Sparse_LDL();
+    ~Sparse_LDL() {};
+
+    void set_pattern(unsigned int n_In, const std::vector<unsigned int> &rows_In,
+        const std::vector<unsigned int> &cols_In);
+    void set_order(const std::vector<unsigned int> &P_In);  // P_In[k]: row pivoted k-th, before analyze()
+    void analyze();
+    bool factor();
+    void solve(arma::vec &x);
+    void multiply(const arma::vec &x, arma::vec &y) const;  // y = A x with the current values
+
+    unsigned int index(unsigned int row, unsigned int col);
+    std::vector<double> &values();
+    unsigned int get_n();
+    unsigned int get_nnz();
+    unsigned int get_L_nnz();
+    double pivot_ratio() const;
+
+private:
+    friend class Checkpoint;  // stores the analysis, see Checkpoint::save()
+
+    unsigned int n;
+    std::vector<unsigned int> Ap;  // CSC column pointers of A
+    std::vector<unsigned int> Ai;  // CSC row indices of A
+    std::vector<double> Ax;  // CSC values of A
+    std::vector<unsigned int> P;  // P[k] = original index of pivot k
+    std::vector<unsigned int> Pinv;
+    std::vector<unsigned int> Lp;
+    std::vector<unsigned int> Li;
+    std::vector<double> Lx;
+    std::vector<double> D;
+    std::vector<int> Parent;  // elimination tree
+    std::vector<unsigned int> Lnz;
+    std::vector<unsigned int> Flag;
+    std::vector<unsigned int> Pattern;
+    std::vector<double> Y;
+};
+
+#endif  //SPARSE_LDL_HPP
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fork-join pool for the per-stage loops of Dynamics_Sys. The calling thread
+   takes part, so a pool of n threads starts n - 1 workers. run() splits
+   [0, n) into chunks handed out through an atomic counter and returns once
+   every chunk is done; nothing is allocated per call. */
+class Thread_Pool
+{
+public:
+    Thread_Pool(unsigned int nthreads_In);  // 0: one thread per hardware core
+    ~Thread_Pool();
+
+    unsigned int get_nthreads() const;
+
+    /* fn_In(begin, end) is called on disjoint ranges covering [0, n_In) */
+    template <typename Fn>
+    void run(unsigned int n_In, Fn &fn_In) {
+        if (workers.empty() || n_In < 2) {
+            fn_In(0u, n_In);
+            return;
+        }
+        Dispatch(n_In, &Thread_Pool::Invoke<Fn>, &fn_In);
+    }
+
+private:
+    typedef void (*Range_Fn)(void *, unsigned int, unsigned int);
+
+    template <typename Fn>
+    static void Invoke(void *ctx_In, unsigned int begin_In, unsigned int end_In) {
+        (*static_cast<Fn *>(ctx_In))(begin_In, end_In);
+    }
+
+    Thread_Pool(const Thread_Pool &);
+    Thread_Pool &operator=(const Thread_Pool &);
+
+    void Dispatch(unsigned int n_In, Range_Fn fn_In, void *ctx_In);
+    void Worker_Loop();
+    void Run_Chunks();
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    unsigned long generation;  // bumped per run(), guarded by lock
+    bool quit;
+    Range_Fn job_fn;
+    void *job_ctx;
+    unsigned int job_n;
+    unsigned int job_chunk;
+    std::atomic<unsigned int> next;
+    std::atomic<unsigned int> busy;  // workers still inside the current run()
+};
+
+#endif  //THREAD_POOL_HPP
@@ -0,0 +1,64 @@
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include "Body.hpp"
+#include "Joint.hpp"
+#include <vector>
+
+/* Body-joint graph of a system. Every Ground body is a root fixed to the
+   inertial frame, so a chain running from one ground to another closes a
+   loop just like a ring of bodies does. build() finds the spanning forest
+   Assembly() walks, the number of independent loops and a Cuthill-McKee
+   ordering of the bodies; the constraint row layout and the pivot order of
+   the sparse KKT factorization follow from that ordering, which keeps the
+   factors banded for nets as well as chains. */
+class Topology
+{
+public:
+    Topology();
+    ~Topology() {};
+
+    void build(const std::vector<BodyPtr> &Body_In, const std::vector<JointPtr> &Joint_In);
+
+    /* Constraint blocks (6 rows per ground, the joint rows) numbered in body
+       order, each after its later body; returns the number of rows */
+    unsigned int constraint_rows(std::vector<unsigned int> &ground_row_Out,
+        std::vector<unsigned int> &joint_row_Out) const;
+    /* Pivot order of the KKT system [M Cq^T; Cq 0] for Sparse_LDL: bodies in
+       reverse Cuthill-McKee order, every constraint block right after the
+       last of its bodies, so no constraint pivot precedes its mass blocks */
+    void kkt_order(const std::vector<unsigned int> &ground_row_In, const std::vector<unsigned int> &joint_row_In,
+        std::vector<unsigned int> &P_Out) const;
+
+    bool is_tree() const;  // no closed loops
+    bool is_grounded() const;  // every body is connected to a ground
+    unsigned int get_nloop() const;  // joints beyond the spanning forest
+    const std::vector<unsigned int> &get_ground() const;  // ground body numbers, ascending
+    const std::vector<unsigned int> &get_body_order() const;  // Cuthill-McKee, one component after the other
+    /* Spanning forest joints breadth-first from the roots and the body each
+       one reaches; the other end is placed already */
+    const std::vector<unsigned int> &get_tree_joint() const;
+    const std::vector<unsigned int> &get_tree_body() const;
+
+private:
+    friend class Checkpoint;  // stores the analysis, see Checkpoint::save()
+
+    unsigned int bfs(unsigned int start_In, std::vector<int> &level_Out, std::vector<unsigned int> &reached_InOut) const;
+
+    unsigned int nbody;
+    unsigned int njoint;
+    unsigned int nloop;
+    bool grounded;
+    std::vector<unsigned int> joint_i;
+    std::vector<unsigned int> joint_j;
+    std::vector<unsigned int> joint_dim;
+    std::vector<unsigned int> adj_ptr;  // joints at body b: adj_joint[adj_ptr[b] .. adj_ptr[b + 1])
+    std::vector<unsigned int> adj_joint;
+    std::vector<unsigned int> ground;
+    std::vector<unsigned int> order;
+    std::vector<unsigned int> position;  // position[b]: index of body b in order
+    std::vector<unsigned int> tree_joint;
+    std::vector<unsigned int> tree_body;
+};
+
+#endif  //TOPOLOGY_HPP
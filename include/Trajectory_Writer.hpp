@@ -0,0 +1,87 @@
+#ifndef TRAJECTORY_WRITER_HPP
+#define TRAJECTORY_WRITER_HPP
+
+#include "Dynamics_System.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* Field bits of a trajectory record, written per body in this order */
+enum Traj_Field {
+    TRAJ_POS = 1,  // 3 doubles
+    TRAJ_VEL = 2,  // 3 doubles
+    TRAJ_QUAT = 4,  // 4 doubles
+    TRAJ_ANG_VEL = 8,  // 3 doubles
+    TRAJ_LAMBDA = 16  // Lagrange multipliers, nlambda doubles after the bodies
+};
+
+enum Traj_Mode {
+    TRAJ_BUFFERED = 0,  // records collected in a chunk and written with one call
+    TRAJ_MMAP  // file grown in chunks and written through a shared mapping (POSIX)
+};
+
+/* Binary trajectory file: a 64-byte header, the uint32 tables
+   [body number of each recorded body, first multiplier row of each joint]
+   zero-padded to data_offset, then fixed-stride records of native doubles,
+   [time, fields of each recorded body, lambda]. Grounds (Body::get_type() 0)
+   are skipped, as in output_data(). nrecords is patched by close().
+   Readers: read_traj.py and matlab/importtraj.m. */
+struct Traj_Header {
+    char magic[8];  // "MBDTRAJ"
+    uint32_t version;  // TRAJ_VERSION
+    uint32_t nbody;  // bodies per record
+    uint32_t field_mask;  // Traj_Field bits
+    uint32_t stride;  // doubles per record, time included
+    double dt;  // time between records
+    uint64_t nrecords;
+    uint32_t nlambda;  // multipliers per record, 0 without TRAJ_LAMBDA
+    uint32_t njoint;  // entries of the joint row table
+    uint32_t data_offset;  // byte offset of the first record, a multiple of 8
+    char reserved[12];
+};
+
+const uint32_t TRAJ_VERSION = 2;
+
+class Trajectory_Writer
+{
+public:
+    Trajectory_Writer();
+    ~Trajectory_Writer();
+
+    bool open(const std::string &file_In, const Dynamics_Sys &sys_In, unsigned int field_mask_In = TRAJ_POS,
+        unsigned int decimation_In = 1, Traj_Mode mode_In = TRAJ_BUFFERED);
+    void write(const Dynamics_Sys &sys_In);
+    void write_record(const double *record_In);
+    void pack(const Dynamics_Sys &sys_In, double *record_Out) const;
+    void close();
+
+    uint64_t get_nrecords() const;
+    unsigned int get_stride() const;
+
+private:
+    double *Next_Record();
+    bool Map_Capacity(uint64_t nrec_In);
+    void Flush_Chunk();
+
+    Traj_Header header;
+    std::vector<uint32_t> table;  // body numbers, joint rows and padding, data_offset - 64 bytes
+    unsigned int lambda_off;  // first multiplier in SYS_ANS
+    Traj_Mode mode;
+    unsigned int decimation;
+    unsigned long ncall;
+    unsigned int chunk_records;
+    bool is_open;
+
+    /* TRAJ_BUFFERED */
+    std::ofstream fout;
+    std::vector<double> chunk;
+    unsigned int chunk_fill;
+
+    /* TRAJ_MMAP */
+    int fd;
+    char *map;
+    uint64_t map_bytes;
+};
+
+#endif  //TRAJECTORY_WRITER_HPP
@@ -0,0 +1,45 @@
+function [data, header] = importtraj(filename)
+%IMPORTTRAJ Import a binary trajectory file written by Trajectory_Writer.
+%   DATA = IMPORTTRAJ(FILENAME) returns one row per record,
+%   [time, body 1 fields, body 2 fields, ...]. With the default position-only
+%   field list this is the same layout as importdata('data.csv').
+%
+%   [DATA, HEADER] = IMPORTTRAJ(FILENAME) also returns the header fields
+%   nbody, field_mask, stride, dt, nrecords and nlambda, plus bodies (the
+%   body number of each recorded body, grounds are skipped) and joint_row
+%   (the first multiplier of each joint, 0-based). Multipliers, when
+%   present, are the last nlambda columns.
+%
+% Example:
+%   data = importtraj('../data.traj');
+
+fileID = fopen(filename, 'r', 'ieee-le');
+magic = fread(fileID, 8, '*char')';
+if ~strncmp(magic, 'MBDTRAJ', 7)
+    fclose(fileID);
+    error('importtraj: %s is not a trajectory file', filename);
+end
+header.version = fread(fileID, 1, 'uint32');
+header.nbody = fread(fileID, 1, 'uint32');
+header.field_mask = fread(fileID, 1, 'uint32');
+header.stride = fread(fileID, 1, 'uint32');
+header.dt = fread(fileID, 1, 'double');
+header.nrecords = fread(fileID, 1, 'uint64');
+header.nlambda = fread(fileID, 1, 'uint32');
+njoint = fread(fileID, 1, 'uint32');
+offset = fread(fileID, 1, 'uint32');
+
+if header.version == 1
+    % no tables; version 1 skipped body 0 only
+    header.bodies = (1:header.nbody)';
+    header.joint_row = zeros(0, 1);
+    offset = 64;
+else
+    fseek(fileID, 64, 'bof');
+    header.bodies = fread(fileID, header.nbody, 'uint32');
+    header.joint_row = fread(fileID, njoint, 'uint32');
+end
+
+fseek(fileID, offset, 'bof');
+data = fread(fileID, [header.stride, header.nrecords], 'double')';
+fclose(fileID);
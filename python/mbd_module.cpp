@@ -0,0 +1,1059 @@
+/* Python bindings on the CPython C API: import mbd. Built by cmake -DMBD_PYTHON=ON.
+   Vectors and matrices are passed in as any sequence of numbers and handed
+   out as memoryviews of float64 ('d'), which numpy.asarray() wraps without
+   a copy. */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "Checkpoint.hpp"
+#include "Contact.hpp"
+#include "Dynamics_System.hpp"
+#include "Scene_Loader.hpp"
+#include <boost/make_shared.hpp>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+/* Every wrapper holds a shared pointer to the C++ object */
+template <typename Ptr>
+struct Holder {
+    PyObject_HEAD
+    Ptr ptr;
+};
+
+typedef Holder<BodyPtr> Py_Body;
+typedef Holder<JointPtr> Py_Joint;
+typedef Holder<ForcePtr> Py_Force;
+
+struct Py_Sys {
+    PyObject_HEAD
+    DynSysPtr ptr;
+    Py_ssize_t nviews;  // live views of the state and SYS_ANS, see check_init()
+};
+
+/* float64 buffer exporter behind every memoryview the module returns: over
+   memory of the C++ object behind owner, which it keeps alive, or over own */
+struct Py_View {
+    PyObject_HEAD
+    PyObject *owner;
+    Py_Sys *sys;  // counted in sys->nviews while this view lives
+    const double *data;
+    std::vector<double> *own;
+    int ndim;
+    int readonly;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+PyTypeObject BodyType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject GroundType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject MobilizedType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject JointType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject ForceType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject GravityType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject SpringType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject ContactType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject SysType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject ViewType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+const double EMPTY = 0.0;  // data of a zero-length view
+
+/* ---- wrappers ---- */
+
+template <typename H>
+PyObject *holder_new(PyTypeObject *type_In, PyObject *, PyObject *) {
+    H *self = reinterpret_cast<H *>(type_In->tp_alloc(type_In, 0));
+
+    if (self == nullptr) return nullptr;
+    new (&self->ptr) decltype(self->ptr)();
+    return reinterpret_cast<PyObject *>(self);
+}
+
+template <typename H>
+void holder_dealloc(PyObject *self_In) {
+    typedef decltype(H::ptr) Ptr;
+    reinterpret_cast<H *>(self_In)->ptr.~Ptr();
+    Py_TYPE(self_In)->tp_free(self_In);
+}
+
+PyObject *sys_new(PyTypeObject *type_In, PyObject *args_In, PyObject *kw_In) {
+    PyObject *self = holder_new<Py_Sys>(type_In, args_In, kw_In);
+
+    if (self != nullptr) reinterpret_cast<Py_Sys *>(self)->nviews = 0;
+    return self;
+}
+
+PyObject *wrap_body(const BodyPtr &b_In) {
+    PyTypeObject *type = &BodyType;
+
+    if (!b_In) Py_RETURN_NONE;
+    if (dynamic_cast<Ground *>(b_In.get())) {
+        type = &GroundType;
+    } else if (dynamic_cast<Mobilized_body *>(b_In.get())) {
+        type = &MobilizedType;
+    }
+    PyObject *self = holder_new<Py_Body>(type, nullptr, nullptr);
+    if (self != nullptr) reinterpret_cast<Py_Body *>(self)->ptr = b_In;
+    return self;
+}
+
+PyObject *wrap_joint(const JointPtr &j_In) {
+    if (!j_In) Py_RETURN_NONE;
+    PyObject *self = holder_new<Py_Joint>(&JointType, nullptr, nullptr);
+    if (self != nullptr) reinterpret_cast<Py_Joint *>(self)->ptr = j_In;
+    return self;
+}
+
+PyObject *wrap_force(const ForcePtr &f_In) {
+    PyTypeObject *type = &ForceType;
+
+    if (!f_In) Py_RETURN_NONE;
+    if (dynamic_cast<Gravity_Field *>(f_In.get())) {
+        type = &GravityType;
+    } else if (dynamic_cast<Spring_Damper *>(f_In.get())) {
+        type = &SpringType;
+    } else if (dynamic_cast<Contact_Force *>(f_In.get())) {
+        type = &ContactType;
+    }
+    PyObject *self = holder_new<Py_Force>(type, nullptr, nullptr);
+    if (self != nullptr) reinterpret_cast<Py_Force *>(self)->ptr = f_In;
+    return self;
+}
+
+PyObject *wrap_sys(const DynSysPtr &s_In) {
+    PyObject *self = sys_new(&SysType, nullptr, nullptr);
+
+    if (self != nullptr) reinterpret_cast<Py_Sys *>(self)->ptr = s_In;
+    return self;
+}
+
+Body &body_of(PyObject *self_In) { return *reinterpret_cast<Py_Body *>(self_In)->ptr; }
+Joint &joint_of(PyObject *self_In) { return *reinterpret_cast<Py_Joint *>(self_In)->ptr; }
+template <typename T>
+T &force_of(PyObject *self_In) { return static_cast<T &>(*reinterpret_cast<Py_Force *>(self_In)->ptr); }
+Py_Sys *sys_obj(PyObject *self_In) { return reinterpret_cast<Py_Sys *>(self_In); }
+Dynamics_Sys &sys_of(PyObject *self_In) { return *sys_obj(self_In)->ptr; }
+
+/* ---- arguments ---- */
+
+/* n_In doubles from any sequence of numbers; a missing argument gives zeros */
+bool vec_arg(PyObject *o_In, const char *name_In, arma::vec &Out, unsigned int n_In = 3) {
+    Out.zeros(n_In);
+    if (o_In == nullptr) return true;
+
+    PyObject *seq = PySequence_Fast(o_In, name_In);
+    if (seq == nullptr) return false;
+    bool ok = PySequence_Fast_GET_SIZE(seq) == static_cast<Py_ssize_t>(n_In);
+    for (unsigned int k = 0; ok && k < n_In; k++) {
+        Out(k) = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, k));
+        ok = !PyErr_Occurred();
+    }
+    Py_DECREF(seq);
+    if (!ok && !PyErr_Occurred()) PyErr_Format(PyExc_ValueError, "%s needs %u values", name_In, n_In);
+    return ok;
+}
+
+bool body_arg(PyObject *o_In, const char *name_In, BodyPtr &Out) {
+    if (!PyObject_TypeCheck(o_In, &BodyType)) {
+        PyErr_Format(PyExc_TypeError, "%s must be a Body", name_In);
+        return false;
+    }
+    Out = reinterpret_cast<Py_Body *>(o_In)->ptr;
+    return true;
+}
+
+/* Enum value in [0, n_In) and unsigned counts, parsed as Py_ssize_t */
+bool range_arg(Py_ssize_t v_In, const char *name_In, Py_ssize_t n_In) {
+    if (v_In >= 0 && (n_In < 0 || v_In < n_In)) return true;
+    PyErr_Format(PyExc_ValueError, "%s out of range", name_In);
+    return false;
+}
+
+char **kwlist(const char **names_In) { return const_cast<char **>(names_In); }
+
+/* ---- views ---- */
+
+bool c_contiguous(const Py_View *v_In) {
+    return v_In->ndim < 2 ? v_In->strides[0] == sizeof(double)
+        : v_In->strides[1] == sizeof(double) && v_In->strides[0] == v_In->shape[1] * (Py_ssize_t)sizeof(double);
+}
+
+int view_getbuffer(PyObject *self_In, Py_buffer *buf_Out, int flags_In) {
+    Py_View *v = reinterpret_cast<Py_View *>(self_In);
+    Py_ssize_t n = 1;
+
+    buf_Out->obj = nullptr;
+    if ((flags_In & PyBUF_WRITABLE) && v->readonly) {
+        PyErr_SetString(PyExc_BufferError, "view is read-only");
+        return -1;
+    }
+    if (((flags_In & PyBUF_STRIDES) != PyBUF_STRIDES || (flags_In & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS)
+        && !c_contiguous(v)) {
+        PyErr_SetString(PyExc_BufferError, "view is not C-contiguous");
+        return -1;
+    }
+    for (int d = 0; d < v->ndim; d++) n *= v->shape[d];
+    buf_Out->buf = const_cast<double *>(v->data);
+    buf_Out->obj = self_In;
+    Py_INCREF(self_In);
+    buf_Out->len = n * sizeof(double);
+    buf_Out->itemsize = sizeof(double);
+    buf_Out->readonly = v->readonly;
+    buf_Out->ndim = v->ndim;
+    buf_Out->format = (flags_In & PyBUF_FORMAT) ? const_cast<char *>("d") : nullptr;
+    buf_Out->shape = (flags_In & PyBUF_ND) == PyBUF_ND ? v->shape : nullptr;
+    buf_Out->strides = (flags_In & PyBUF_STRIDES) == PyBUF_STRIDES ? v->strides : nullptr;
+    buf_Out->suboffsets = nullptr;
+    buf_Out->internal = nullptr;
+    return 0;
+}
+
+void view_dealloc(PyObject *self_In) {
+    Py_View *v = reinterpret_cast<Py_View *>(self_In);
+
+    if (v->sys != nullptr) v->sys->nviews--;
+    Py_XDECREF(v->owner);
+    delete v->own;
+    Py_TYPE(self_In)->tp_free(self_In);
+}
+
+PyBufferProcs view_buffer = {view_getbuffer, nullptr};
+
+/* memoryview of ndim_In (1 or 2) dimensions over p_In; strides in doubles */
+PyObject *make_view(const double *p_In, int ndim_In, const Py_ssize_t *shape_In, const Py_ssize_t *strides_In,
+        PyObject *owner_In, Py_Sys *sys_In = nullptr, std::vector<double> *own_In = nullptr) {
+    Py_View *v = PyObject_New(Py_View, &ViewType);
+
+    if (v == nullptr) {
+        delete own_In;
+        return nullptr;
+    }
+    v->owner = owner_In;
+    Py_XINCREF(owner_In);
+    v->sys = sys_In;
+    if (sys_In != nullptr) sys_In->nviews++;
+    v->own = own_In;
+    v->data = own_In ? (own_In->empty() ? &EMPTY : own_In->data()) : (p_In ? p_In : &EMPTY);
+    v->readonly = own_In ? 0 : 1;
+    v->ndim = ndim_In;
+    for (int d = 0; d < 2; d++) {
+        v->shape[d] = d < ndim_In ? shape_In[d] : 1;
+        v->strides[d] = d < ndim_In ? strides_In[d] * (Py_ssize_t)sizeof(double) : (Py_ssize_t)sizeof(double);
+    }
+
+    PyObject *m = PyMemoryView_FromObject(reinterpret_cast<PyObject *>(v));
+    Py_DECREF(v);
+    return m;
+}
+
+PyObject *vec_view(const double *p_In, Py_ssize_t n_In, PyObject *owner_In, Py_Sys *sys_In = nullptr) {
+    const Py_ssize_t one = 1;
+    return make_view(p_In, 1, &n_In, &one, owner_In, sys_In);
+}
+
+/* Armadillo stores column major: element (r, c) of an n x m matrix at r + c n */
+PyObject *mat_view(const arma::mat &M_In, PyObject *owner_In) {
+    const Py_ssize_t shape[2] = {(Py_ssize_t)M_In.n_rows, (Py_ssize_t)M_In.n_cols};
+    const Py_ssize_t strides[2] = {1, (Py_ssize_t)M_In.n_rows};
+    return make_view(M_In.memptr(), 2, shape, strides, owner_In);
+}
+
+/* Writable memoryview over a new zeroed buffer of shape_In */
+PyObject *new_array(int ndim_In, const Py_ssize_t *shape_In, double *&data_Out) {
+    const Py_ssize_t n = ndim_In == 1 ? shape_In[0] : shape_In[0] * shape_In[1];
+    const Py_ssize_t strides[2] = {ndim_In == 1 ? 1 : shape_In[1], 1};
+    std::vector<double> *own = new (std::nothrow) std::vector<double>(n, 0.0);
+
+    if (own == nullptr) return PyErr_NoMemory();
+    data_Out = own->empty() ? nullptr : own->data();
+    return make_view(nullptr, ndim_In, shape_In, strides, nullptr, nullptr, own);
+}
+
+/* ---- Body ---- */
+
+PyObject *body_num(PyObject *self, void *) { return PyLong_FromUnsignedLong(body_of(self).get_num()); }
+PyObject *body_type(PyObject *self, void *) { return PyLong_FromUnsignedLong(body_of(self).get_type()); }
+PyObject *body_mass(PyObject *self, void *) { return PyFloat_FromDouble(body_of(self).get_M()(0, 0)); }
+PyObject *body_position(PyObject *self, void *) { return vec_view(body_of(self).get_POSITION().memptr(), 3, self); }
+PyObject *body_velocity(PyObject *self, void *) { return vec_view(body_of(self).get_VELOCITY().memptr(), 3, self); }
+PyObject *body_acceleration(PyObject *self, void *) {
+    return vec_view(body_of(self).get_ACCELERATION().memptr(), 3, self);
+}
+PyObject *body_angle_vel(PyObject *self, void *) { return vec_view(body_of(self).get_ANGLE_VEL().memptr(), 3, self); }
+PyObject *body_angle_acc(PyObject *self, void *) { return vec_view(body_of(self).get_ANGLE_ACC().memptr(), 3, self); }
+PyObject *body_quaternion(PyObject *self, void *) { return vec_view(body_of(self).get_TBI_Q().memptr(), 4, self); }
+PyObject *body_TBI(PyObject *self, void *) { return mat_view(body_of(self).get_TBI(), self); }
+
+/* A copy: computed on access */
+PyObject *body_angle(PyObject *self, void *) {
+    const Py_ssize_t n = 3;
+    double *p;
+    PyObject *a = new_array(1, &n, p);
+
+    if (a != nullptr) std::memcpy(p, body_of(self).get_ANGLE().memptr(), 3 * sizeof(double));
+    return a;
+}
+
+PyObject *body_set_force(PyObject *self, PyObject *F) {
+    arma::vec v;
+
+    if (!vec_arg(F, "force", v)) return nullptr;
+    body_of(self).set_FORCE(v);
+    Py_RETURN_NONE;
+}
+
+PyObject *body_set_torque(PyObject *self, PyObject *T) {
+    arma::vec v;
+
+    if (!vec_arg(T, "torque", v)) return nullptr;
+    body_of(self).set_APPLIED_TORQUE(v);
+    Py_RETURN_NONE;
+}
+
+PyGetSetDef body_getset[] = {
+    {"num", body_num, nullptr, nullptr, nullptr},
+    {"type", body_type, nullptr, "0 for grounds", nullptr},
+    {"mass", body_mass, nullptr, nullptr, nullptr},
+    {"position", body_position, nullptr, nullptr, nullptr},
+    {"velocity", body_velocity, nullptr, nullptr, nullptr},
+    {"acceleration", body_acceleration, nullptr, nullptr, nullptr},
+    {"angle_vel", body_angle_vel, nullptr, nullptr, nullptr},
+    {"angle_acc", body_angle_acc, nullptr, nullptr, nullptr},
+    {"quaternion", body_quaternion, nullptr, nullptr, nullptr},
+    {"TBI", body_TBI, nullptr, "3 x 3 view, column major strides", nullptr},
+    {"angle", body_angle, nullptr, "copy of the Euler angles", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyMethodDef body_methods[] = {
+    {"set_force", body_set_force, METH_O, nullptr},
+    {"set_torque", body_set_torque, METH_O, nullptr},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+/* Ground(num) or Ground(num, position, angle) */
+int ground_init(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"num", "position", "angle", nullptr};
+    Py_ssize_t num;
+    PyObject *pos = nullptr, *ang = nullptr;
+    arma::vec p, a;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "n|OO", kwlist(names), &num, &pos, &ang)
+        || !range_arg(num, "num", -1)) return -1;
+    if ((pos == nullptr) != (ang == nullptr)) {
+        PyErr_SetString(PyExc_TypeError, "Ground takes both position and angle or neither");
+        return -1;
+    }
+    if (pos == nullptr) {
+        reinterpret_cast<Py_Body *>(self)->ptr = boost::make_shared<Ground>(num);
+        return 0;
+    }
+    if (!vec_arg(pos, "position", p) || !vec_arg(ang, "angle", a)) return -1;
+    reinterpret_cast<Py_Body *>(self)->ptr = boost::make_shared<Ground>(num, p, a);
+    return 0;
+}
+
+int mobilized_init(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"num", "position", "mass", "inertia", "velocity", "acceleration", "angle",
+        "angle_vel", "angle_acc", "force", "torque", nullptr};
+    Py_ssize_t num;
+    double mass;
+    PyObject *o[9] = {nullptr};
+    const char *vec_name[9] = {"position", "inertia", "velocity", "acceleration", "angle", "angle_vel",
+        "angle_acc", "force", "torque"};
+    arma::vec v[9];
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "nOdO|OOOOOOO", kwlist(names), &num, &o[0], &mass, &o[1], &o[2],
+            &o[3], &o[4], &o[5], &o[6], &o[7], &o[8]) || !range_arg(num, "num", -1)) return -1;
+    for (unsigned int k = 0; k < 9; k++) {
+        if (!vec_arg(o[k], vec_name[k], v[k])) return -1;
+    }
+    reinterpret_cast<Py_Body *>(self)->ptr = boost::make_shared<Mobilized_body>(num, v[0], v[2], v[3], v[4], v[5],
+        v[6], mass, v[1], v[7], v[8]);
+    return 0;
+}
+
+/* ---- Joint ---- */
+
+bool joint_args(PyObject *args, PyObject *kw, Joint_Type &type_Out, arma::vec *v_Out, BodyPtr &i_Out,
+        BodyPtr &j_Out) {
+    static const char *names[] = {"type", "pi", "pj", "qi", "qj", "body_i", "body_j", nullptr};
+    Py_ssize_t type;
+    PyObject *o[4], *bi, *bj;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "nOOOOOO", kwlist(names), &type, &o[0], &o[1], &o[2], &o[3], &bi,
+            &bj) || !range_arg(type, "type", UNIVERSAL_JOINT + 1) || !vec_arg(o[0], "pi", v_Out[0])
+        || !vec_arg(o[1], "pj", v_Out[1]) || !vec_arg(o[2], "qi", v_Out[2]) || !vec_arg(o[3], "qj", v_Out[3])
+        || !body_arg(bi, "body_i", i_Out) || !body_arg(bj, "body_j", j_Out)) return false;
+    type_Out = static_cast<Joint_Type>(type);
+    return true;
+}
+
+int joint_init(PyObject *self, PyObject *args, PyObject *kw) {
+    Joint_Type type;
+    arma::vec v[4];
+    BodyPtr bi, bj;
+
+    if (!joint_args(args, kw, type, v, bi, bj)) return -1;
+    reinterpret_cast<Py_Joint *>(self)->ptr = make_joint(type, v[0], v[1], v[2], v[3], bi, bj);
+    return 0;
+}
+
+PyObject *joint_type(PyObject *self, void *) { return PyLong_FromLong(joint_of(self).get_type()); }
+PyObject *joint_body_i(PyObject *self, void *) { return wrap_body(joint_of(self).get_body_i_ptr()); }
+PyObject *joint_body_j(PyObject *self, void *) { return wrap_body(joint_of(self).get_body_j_ptr()); }
+PyObject *joint_constraint(PyObject *self, void *) {
+    const arma::vec &C = joint_of(self).get_CONSTRAINT();
+    return vec_view(C.memptr(), C.n_elem, self);
+}
+PyObject *joint_Cqi(PyObject *self, void *) { return mat_view(joint_of(self).get_Cqi(), self); }
+PyObject *joint_Cqj(PyObject *self, void *) { return mat_view(joint_of(self).get_Cqj(), self); }
+
+PyGetSetDef joint_getset[] = {
+    {"type", joint_type, nullptr, nullptr, nullptr},
+    {"body_i", joint_body_i, nullptr, nullptr, nullptr},
+    {"body_j", joint_body_j, nullptr, nullptr, nullptr},
+    {"constraint", joint_constraint, nullptr, nullptr, nullptr},
+    {"Cqi", joint_Cqi, nullptr, nullptr, nullptr},
+    {"Cqj", joint_Cqj, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+/* ---- force elements ---- */
+
+PyObject *force_active(PyObject *self, void *) { return PyBool_FromLong(force_of<Force_Element>(self).is_active()); }
+
+int force_set_active(PyObject *self, PyObject *value, void *) {
+    int b = value ? PyObject_IsTrue(value) : -1;
+
+    if (b < 0) {
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "cannot delete active");
+        return -1;
+    }
+    force_of<Force_Element>(self).set_active(b != 0);
+    return 0;
+}
+
+PyGetSetDef force_getset[] = {
+    {"active", force_active, force_set_active, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyObject *gravity_set_g(PyObject *self, PyObject *g) {
+    arma::vec v;
+
+    if (!vec_arg(g, "g", v)) return nullptr;
+    force_of<Gravity_Field>(self).set_g(v);
+    Py_RETURN_NONE;
+}
+
+PyMethodDef gravity_methods[] = {
+    {"set_g", gravity_set_g, METH_O, nullptr},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+/* f(x) for the double setters: one float argument */
+template <typename T, void (T::*Set)(double)>
+PyObject *set_double(PyObject *self, PyObject *x) {
+    double v = PyFloat_AsDouble(x);
+
+    if (PyErr_Occurred()) return nullptr;
+    (force_of<T>(self).*Set)(v);
+    Py_RETURN_NONE;
+}
+
+PyObject *spring_length(PyObject *self, void *) { return PyFloat_FromDouble(force_of<Spring_Damper>(self).get_length()); }
+PyObject *spring_tension(PyObject *self, void *) {
+    return PyFloat_FromDouble(force_of<Spring_Damper>(self).get_tension());
+}
+
+PyMethodDef spring_methods[] = {
+    {"set_stiffness", set_double<Spring_Damper, &Spring_Damper::set_stiffness>, METH_O, nullptr},
+    {"set_damping", set_double<Spring_Damper, &Spring_Damper::set_damping>, METH_O, nullptr},
+    {"set_rest_length", set_double<Spring_Damper, &Spring_Damper::set_rest_length>, METH_O, nullptr},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef spring_getset[] = {
+    {"length", spring_length, nullptr, "at the last evaluated stage", nullptr},
+    {"tension", spring_tension, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyObject *contact_add_sphere(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"body", "center", "radius", nullptr};
+    PyObject *b, *c;
+    double r;
+    BodyPtr body;
+    arma::vec center;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "OOd", kwlist(names), &b, &c, &r) || !body_arg(b, "body", body)
+        || !vec_arg(c, "center", center)) return nullptr;
+    return PyLong_FromUnsignedLong(force_of<Contact_Force>(self).add_sphere(body, center, r));
+}
+
+PyObject *contact_add_capsule(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"body", "center", "half_axis", "radius", nullptr};
+    PyObject *b, *c, *h;
+    double r;
+    BodyPtr body;
+    arma::vec center, half_axis;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "OOOd", kwlist(names), &b, &c, &h, &r) || !body_arg(b, "body", body)
+        || !vec_arg(c, "center", center) || !vec_arg(h, "half_axis", half_axis)) return nullptr;
+    return PyLong_FromUnsignedLong(force_of<Contact_Force>(self).add_capsule(body, center, half_axis, r));
+}
+
+PyObject *contact_add_box(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"body", "center", "half", nullptr};
+    PyObject *b, *c, *h;
+    BodyPtr body;
+    arma::vec center, half;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "OOO", kwlist(names), &b, &c, &h) || !body_arg(b, "body", body)
+        || !vec_arg(c, "center", center) || !vec_arg(h, "half", half)) return nullptr;
+    return PyLong_FromUnsignedLong(force_of<Contact_Force>(self).add_box(body, center, half));
+}
+
+PyObject *contact_add_plane(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"normal", "offset", nullptr};
+    PyObject *n;
+    double offset;
+    arma::vec normal;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "Od", kwlist(names), &n, &offset) || !vec_arg(n, "normal", normal)) {
+        return nullptr;
+    }
+    return PyLong_FromUnsignedLong(force_of<Contact_Force>(self).add_plane(normal, offset));
+}
+
+PyObject *contact_exclude(PyObject *self, PyObject *args) {
+    PyObject *a, *b;
+    BodyPtr i, j;
+
+    if (!PyArg_ParseTuple(args, "OO", &a, &b) || !body_arg(a, "i", i) || !body_arg(b, "j", j)) return nullptr;
+    force_of<Contact_Force>(self).exclude(i, j);
+    Py_RETURN_NONE;
+}
+
+PyObject *contact_exclude_joined(PyObject *self, PyObject *s) {
+    if (!PyObject_TypeCheck(s, &SysType)) {
+        PyErr_SetString(PyExc_TypeError, "exclude_joined() takes a Dynamics_Sys");
+        return nullptr;
+    }
+    force_of<Contact_Force>(self).exclude_joined(sys_of(s));
+    Py_RETURN_NONE;
+}
+
+PyObject *contact_set_friction(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"mu", "vel", nullptr};
+    double mu, vel = 1e-3;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "d|d", kwlist(names), &mu, &vel)) return nullptr;
+    force_of<Contact_Force>(self).set_friction(mu, vel);
+    Py_RETURN_NONE;
+}
+
+PyObject *contact_npair(PyObject *self, void *) { return PyLong_FromUnsignedLong(force_of<Contact_Force>(self).get_npair()); }
+PyObject *contact_ncontact(PyObject *self, void *) {
+    return PyLong_FromSize_t(force_of<Contact_Force>(self).get_contacts().size());
+}
+
+PyMethodDef contact_methods[] = {
+    {"add_sphere", (PyCFunction)(void (*)(void))contact_add_sphere, METH_VARARGS | METH_KEYWORDS, nullptr},
+    {"add_capsule", (PyCFunction)(void (*)(void))contact_add_capsule, METH_VARARGS | METH_KEYWORDS, nullptr},
+    {"add_box", (PyCFunction)(void (*)(void))contact_add_box, METH_VARARGS | METH_KEYWORDS, nullptr},
+    {"add_plane", (PyCFunction)(void (*)(void))contact_add_plane, METH_VARARGS | METH_KEYWORDS, nullptr},
+    {"exclude", contact_exclude, METH_VARARGS, nullptr},
+    {"exclude_joined", contact_exclude_joined, METH_O, nullptr},
+    {"set_stiffness", set_double<Contact_Force, &Contact_Force::set_stiffness>, METH_O, nullptr},
+    {"set_damping", set_double<Contact_Force, &Contact_Force::set_damping>, METH_O, nullptr},
+    {"set_friction", (PyCFunction)(void (*)(void))contact_set_friction, METH_VARARGS | METH_KEYWORDS, nullptr},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef contact_getset[] = {
+    {"npair", contact_npair, nullptr, "broad phase candidates of the last stage", nullptr},
+    {"ncontact", contact_ncontact, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+/* ---- Dynamics_Sys ---- */
+
+int sys_init(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"dt", nullptr};
+    double dt;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "d", kwlist(names), &dt)) return -1;
+    sys_obj(self)->ptr = boost::make_shared<Dynamics_Sys>(dt);
+    return 0;
+}
+
+/* Sizes init() gives the state and SYS_ANS: STATE_SIZE doubles per body;
+   6 per body plus the constraint rows, 6 per ground and the joint rows. A
+   size change frees the memory under the views, so init() is refused while
+   a view of that system is alive */
+bool check_init(PyObject *self) {
+    const Dynamics_Sys &s = sys_of(self);
+    arma::uword nq = STATE_SIZE * s.get_nbody(), nans = 6 * s.get_nbody();
+
+    if (sys_obj(self)->nviews == 0) return true;
+    for (unsigned int i = 0; i < s.get_nbody(); i++) {
+        if (s.get_body(i)->get_type() == 0) nans += 6;
+    }
+    for (unsigned int i = 0; i < s.get_njoint(); i++) nans += s.get_joint(i)->get_Cqi().n_rows;
+    if (nq != s.get_state().n_elem || nans != s.get_SYS_ANS().n_elem) {
+        PyErr_SetString(PyExc_RuntimeError, "init() would reallocate the state and SYS_ANS under live views: "
+            "delete the views first");
+        return false;
+    }
+    return true;
+}
+
+PyObject *sys_init_method(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"template", nullptr};
+    PyObject *t = nullptr;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|O!", kwlist(names), &SysType, &t) || !check_init(self)) {
+        return nullptr;
+    }
+    if (t == nullptr) {
+        sys_of(self).init();
+    } else {
+        sys_of(self).init(sys_of(t));
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_add(PyObject *self, PyObject *o) {
+    Dynamics_Sys &s = sys_of(self);
+
+    if (PyObject_TypeCheck(o, &BodyType)) return PyLong_FromUnsignedLong(s.Add(reinterpret_cast<Py_Body *>(o)->ptr));
+    if (PyObject_TypeCheck(o, &JointType)) {
+        return PyLong_FromUnsignedLong(s.Add(reinterpret_cast<Py_Joint *>(o)->ptr));
+    }
+    if (PyObject_TypeCheck(o, &ForceType)) {
+        s.Add(reinterpret_cast<Py_Force *>(o)->ptr);
+        Py_RETURN_NONE;
+    }
+    PyErr_SetString(PyExc_TypeError, "add() takes a Body, a Joint or a Force_Element");
+    return nullptr;
+}
+
+PyObject *sys_create_joint(PyObject *self, PyObject *args, PyObject *kw) {
+    Joint_Type type;
+    arma::vec v[4];
+    BodyPtr bi, bj;
+
+    if (!joint_args(args, kw, type, v, bi, bj)) return nullptr;
+    return wrap_joint(sys_of(self).Create_Joint(type, v[0], v[1], v[2], v[3], bi, bj));
+}
+
+PyObject *sys_create_gravity(PyObject *self, PyObject *g) {
+    arma::vec v;
+
+    if (!vec_arg(g, "g", v)) return nullptr;
+    return wrap_force(sys_of(self).Create<Gravity_Field>(v));
+}
+
+PyObject *sys_create_spring(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"body_i", "body_j", "pi", "pj", "k", "c", "length", nullptr};
+    PyObject *bi, *bj, *pi, *pj;
+    double k, c = 0.0, L0 = 0.0;
+    BodyPtr i, j;
+    arma::vec vi, vj;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "OOOOd|dd", kwlist(names), &bi, &bj, &pi, &pj, &k, &c, &L0)
+        || !body_arg(bi, "body_i", i) || !body_arg(bj, "body_j", j) || !vec_arg(pi, "pi", vi)
+        || !vec_arg(pj, "pj", vj)) return nullptr;
+    return wrap_force(sys_of(self).Create<Spring_Damper>(i, j, vi, vj, k, c, L0));
+}
+
+PyObject *sys_create_contact(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"k", "c", "mu", nullptr};
+    double k, c = 0.0, mu = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "d|dd", kwlist(names), &k, &c, &mu)) return nullptr;
+    return wrap_force(sys_of(self).Create<Contact_Force>(k, c, mu));
+}
+
+PyObject *sys_assembly(PyObject *self, PyObject *) {
+    sys_of(self).Assembly();
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_solver(PyObject *self, PyObject *args) {
+    Py_ssize_t type;
+
+    if (!PyArg_ParseTuple(args, "n", &type) || !range_arg(type, "solver", ITERATIVE_SOLVER + 1)) return nullptr;
+    sys_of(self).set_solver(static_cast<Solver_Type>(type));
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_integrator(PyObject *self, PyObject *args) {
+    Py_ssize_t type;
+
+    if (!PyArg_ParseTuple(args, "n", &type) || !range_arg(type, "integrator", IMPLICIT_EULER_INTEGRATOR + 1)) {
+        return nullptr;
+    }
+    sys_of(self).set_integrator(static_cast<Integrator_Type>(type));
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_tolerance(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"rtol", "atol", nullptr};
+    double rtol, atol;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "dd", kwlist(names), &rtol, &atol)) return nullptr;
+    sys_of(self).set_tolerance(rtol, atol);
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_max_step(PyObject *self, PyObject *args) {
+    double h;
+
+    if (!PyArg_ParseTuple(args, "d", &h)) return nullptr;
+    sys_of(self).set_max_step(h);
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_threads(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"nthreads", "min_bodies", nullptr};
+    Py_ssize_t n, min_bodies = 512;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "n|n", kwlist(names), &n, &min_bodies)
+        || !range_arg(n, "nthreads", -1) || !range_arg(min_bodies, "min_bodies", -1)) return nullptr;
+    sys_of(self).set_threads(n, min_bodies);
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_baumgarte(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"alpha", "beta", nullptr};
+    double alpha, beta;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "dd", kwlist(names), &alpha, &beta)) return nullptr;
+    sys_of(self).set_baumgarte(alpha, beta);
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_projection(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"position", "velocity", "tol", "max_iter", nullptr};
+    int position, velocity;
+    double tol = 1e-10;
+    Py_ssize_t max_iter = 3;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "pp|dn", kwlist(names), &position, &velocity, &tol, &max_iter)
+        || !range_arg(max_iter, "max_iter", -1)) return nullptr;
+    sys_of(self).set_projection(position != 0, velocity != 0, tol, max_iter);
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_set_iterative(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"tol", "max_iter", nullptr};
+    double tol;
+    Py_ssize_t max_iter = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "d|n", kwlist(names), &tol, &max_iter)
+        || !range_arg(max_iter, "max_iter", -1)) return nullptr;
+    sys_of(self).set_iterative(tol, max_iter);
+    Py_RETURN_NONE;
+}
+
+/* nsteps_In solve() calls without the GIL, the state after every every_In-th
+   step written to row k of q_Out (if given) and its time to t_Out[k];
+   raises RuntimeError when a step fails */
+bool run_steps(Dynamics_Sys &sys_In, Py_ssize_t nsteps_In, Py_ssize_t every_In, double *t_Out, double *q_Out) {
+    const Py_ssize_t n = sys_In.get_state().n_elem;
+    Py_ssize_t rec = 0, failed = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t k = 1; k <= nsteps_In; k++) {
+        if (!sys_In.solve()) {
+            failed = k;
+            break;
+        }
+        if (!q_Out || k % every_In != 0) continue;
+        if (t_Out) t_Out[rec] = sys_In.get_time();
+        std::memcpy(q_Out + rec * n, sys_In.get_state().memptr(), n * sizeof(double));
+        rec++;
+    }
+    Py_END_ALLOW_THREADS
+    if (failed) PyErr_Format(PyExc_RuntimeError, "solve() failed at step %zd", failed);
+    return failed == 0;
+}
+
+PyObject *sys_step(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"n", nullptr};
+    Py_ssize_t n = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|n", kwlist(names), &n) || !range_arg(n, "n", -1)
+        || !run_steps(sys_of(self), n, 1, nullptr, nullptr)) return nullptr;
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_run(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"nsteps", "every", nullptr};
+    Py_ssize_t nsteps, every = 1;
+    double *t, *q;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "n|n", kwlist(names), &nsteps, &every)
+        || !range_arg(nsteps, "nsteps", -1)) return nullptr;
+    if (every <= 0) {
+        PyErr_SetString(PyExc_ValueError, "every must be positive");
+        return nullptr;
+    }
+    const Py_ssize_t shape[2] = {nsteps / every, (Py_ssize_t)sys_of(self).get_state().n_elem};
+    PyObject *tv = new_array(1, shape, t);
+    PyObject *qv = tv ? new_array(2, shape, q) : nullptr;
+    if (qv == nullptr || !run_steps(sys_of(self), nsteps, every, t, q)) {
+        Py_XDECREF(tv);
+        Py_XDECREF(qv);
+        return nullptr;
+    }
+    return Py_BuildValue("(NN)", tv, qv);
+}
+
+PyObject *sys_run_into(PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"out", "every", nullptr};
+    PyObject *out;
+    Py_ssize_t every = 1;
+    Py_buffer buf;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "O|n", kwlist(names), &out, &every)) return nullptr;
+    if (every <= 0) {
+        PyErr_SetString(PyExc_ValueError, "every must be positive");
+        return nullptr;
+    }
+    if (PyObject_GetBuffer(out, &buf, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE) != 0) return nullptr;
+    const char *f = buf.format ? buf.format : "B";
+    if (f[0] == '<' || f[0] == '=' || f[0] == '@') f++;
+    if (std::strcmp(f, "d") != 0 || buf.ndim != 2
+        || buf.shape[1] != static_cast<Py_ssize_t>(sys_of(self).get_state().n_elem)) {
+        PyBuffer_Release(&buf);
+        PyErr_SetString(PyExc_ValueError, "out must be a writable C-contiguous float64 (records, state size) array");
+        return nullptr;
+    }
+    bool ok = run_steps(sys_of(self), buf.shape[0] * every, every, nullptr, static_cast<double *>(buf.buf));
+    PyBuffer_Release(&buf);
+    if (!ok) return nullptr;
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_save(PyObject *self, PyObject *) {
+    std::vector<char> buf;
+
+    if (!Checkpoint::save(sys_of(self), buf)) {
+        PyErr_SetString(PyExc_ValueError, "system is not initialized");
+        return nullptr;
+    }
+    return PyBytes_FromStringAndSize(buf.data(), buf.size());
+}
+
+PyObject *sys_load(PyObject *self, PyObject *args) {
+    Py_buffer buf;
+
+    if (!PyArg_ParseTuple(args, "y*", &buf)) return nullptr;
+    bool ok = Checkpoint::load(sys_of(self), static_cast<const char *>(buf.buf), buf.len);
+    PyBuffer_Release(&buf);
+    if (!ok) {
+        PyErr_SetString(PyExc_ValueError, "checkpoint does not fit");
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *sys_body(PyObject *self, PyObject *args) {
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "n", &i)) return nullptr;
+    if (i < 0 || i >= static_cast<Py_ssize_t>(sys_of(self).get_nbody())) {
+        PyErr_SetString(PyExc_IndexError, "body index out of range");
+        return nullptr;
+    }
+    return wrap_body(sys_of(self).get_body(i));
+}
+
+PyObject *sys_joint(PyObject *self, PyObject *args) {
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "n", &i)) return nullptr;
+    if (i < 0 || i >= static_cast<Py_ssize_t>(sys_of(self).get_njoint())) {
+        PyErr_SetString(PyExc_IndexError, "joint index out of range");
+        return nullptr;
+    }
+    return wrap_joint(sys_of(self).get_joint(i));
+}
+
+PyObject *sys_state(PyObject *self, void *) {
+    const arma::vec &q = sys_of(self).get_state();
+    return vec_view(q.memptr(), q.n_elem, self, q.n_elem ? sys_obj(self) : nullptr);
+}
+
+PyObject *sys_SYS_ANS(PyObject *self, void *) {
+    const arma::vec &a = sys_of(self).get_SYS_ANS();
+    return vec_view(a.memptr(), a.n_elem, self, a.n_elem ? sys_obj(self) : nullptr);
+}
+
+PyObject *sys_time(PyObject *self, void *) { return PyFloat_FromDouble(sys_of(self).get_time()); }
+PyObject *sys_dt(PyObject *self, void *) { return PyFloat_FromDouble(sys_of(self).get_dt()); }
+PyObject *sys_nbody(PyObject *self, void *) { return PyLong_FromUnsignedLong(sys_of(self).get_nbody()); }
+PyObject *sys_njoint(PyObject *self, void *) { return PyLong_FromUnsignedLong(sys_of(self).get_njoint()); }
+PyObject *sys_ncons(PyObject *self, void *) { return PyLong_FromUnsignedLong(sys_of(self).get_ncons()); }
+PyObject *sys_feval_count(PyObject *self, void *) { return PyLong_FromUnsignedLong(sys_of(self).get_feval_count()); }
+PyObject *sys_iteration_count(PyObject *self, void *) {
+    return PyLong_FromUnsignedLong(sys_of(self).get_iteration_count());
+}
+
+#define KW_METHOD(name, fn, doc) {name, (PyCFunction)(void (*)(void))fn, METH_VARARGS | METH_KEYWORDS, doc}
+
+PyMethodDef sys_methods[] = {
+    {"add", sys_add, METH_O, "Adds a Body, Joint or Force_Element; returns the body or joint index"},
+    KW_METHOD("create_joint", sys_create_joint, nullptr),
+    {"create_gravity", sys_create_gravity, METH_O, nullptr},
+    KW_METHOD("create_spring", sys_create_spring, nullptr),
+    KW_METHOD("create_contact", sys_create_contact, nullptr),
+    {"assembly", sys_assembly, METH_NOARGS, nullptr},
+    KW_METHOD("init", sys_init_method, "init(template=None); refuses a size change under live views"),
+    {"set_solver", sys_set_solver, METH_VARARGS, nullptr},
+    {"set_integrator", sys_set_integrator, METH_VARARGS, nullptr},
+    KW_METHOD("set_tolerance", sys_set_tolerance, nullptr),
+    {"set_max_step", sys_set_max_step, METH_VARARGS, nullptr},
+    KW_METHOD("set_threads", sys_set_threads, nullptr),
+    KW_METHOD("set_baumgarte", sys_set_baumgarte, nullptr),
+    KW_METHOD("set_projection", sys_set_projection, nullptr),
+    KW_METHOD("set_iterative", sys_set_iterative, nullptr),
+    KW_METHOD("step", sys_step, "step(n=1) without the GIL"),
+    KW_METHOD("run", sys_run, "(t, q): the time and the flat state after every every-th step, one row each"),
+    KW_METHOD("run_into", sys_run_into, "Fills a preallocated C-contiguous float64 (records, state size) buffer"),
+    {"save", sys_save, METH_NOARGS, "Checkpoint as bytes"},
+    {"load", sys_load, METH_VARARGS, nullptr},
+    {"body", sys_body, METH_VARARGS, nullptr},
+    {"joint", sys_joint, METH_VARARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef sys_getset[] = {
+    {"state", sys_state, nullptr, "read-only view of the flat state, STATE_SIZE doubles per body", nullptr},
+    {"SYS_ANS", sys_SYS_ANS, nullptr, "read-only view of [accelerations; multipliers]", nullptr},
+    {"time", sys_time, nullptr, nullptr, nullptr},
+    {"dt", sys_dt, nullptr, nullptr, nullptr},
+    {"nbody", sys_nbody, nullptr, nullptr, nullptr},
+    {"njoint", sys_njoint, nullptr, nullptr, nullptr},
+    {"ncons", sys_ncons, nullptr, nullptr, nullptr},
+    {"feval_count", sys_feval_count, nullptr, nullptr, nullptr},
+    {"iteration_count", sys_iteration_count, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+/* ---- module ---- */
+
+PyObject *mbd_restore(PyObject *, PyObject *args) {
+    Py_buffer buf;
+
+    if (!PyArg_ParseTuple(args, "y*", &buf)) return nullptr;
+    DynSysPtr s = Checkpoint::restore(static_cast<const char *>(buf.buf), buf.len);
+    PyBuffer_Release(&buf);
+    if (!s) {
+        PyErr_SetString(PyExc_ValueError, "not a valid checkpoint");
+        return nullptr;
+    }
+    return wrap_sys(s);
+}
+
+PyObject *mbd_load_scene(PyObject *, PyObject *args, PyObject *kw) {
+    static const char *names[] = {"file", "cache", nullptr};
+    const char *file, *cache = "";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "s|s", kwlist(names), &file, &cache)) return nullptr;
+    DynSysPtr s = Scene_Loader::load(file, cache);
+    if (!s) {
+        PyErr_Format(PyExc_ValueError, "cannot load scene %s", file);
+        return nullptr;
+    }
+    return wrap_sys(s);
+}
+
+PyMethodDef module_methods[] = {
+    {"restore", mbd_restore, METH_VARARGS, "New system from Dynamics_Sys.save() bytes"},
+    KW_METHOD("load_scene", mbd_load_scene, "load_scene(file, cache='')"),
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef module_def = {PyModuleDef_HEAD_INIT, "mbd", "Multibody dynamics solver", -1, module_methods};
+
+void set_type(PyTypeObject &t_Out, const char *name_In, Py_ssize_t size_In, destructor dealloc_In,
+        PyTypeObject *base_In = nullptr, PyMethodDef *methods_In = nullptr, PyGetSetDef *getset_In = nullptr,
+        initproc init_In = nullptr, newfunc new_In = nullptr) {
+    t_Out.tp_name = name_In;
+    t_Out.tp_basicsize = size_In;
+    t_Out.tp_dealloc = dealloc_In;
+    t_Out.tp_flags = Py_TPFLAGS_DEFAULT;
+    t_Out.tp_base = base_In;
+    t_Out.tp_methods = methods_In;
+    t_Out.tp_getset = getset_In;
+    t_Out.tp_init = init_In;
+    t_Out.tp_new = new_In;
+}
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_mbd() {
+    set_type(BodyType, "mbd.Body", sizeof(Py_Body), holder_dealloc<Py_Body>, nullptr, body_methods, body_getset);
+    set_type(GroundType, "mbd.Ground", sizeof(Py_Body), holder_dealloc<Py_Body>, &BodyType, nullptr, nullptr,
+        ground_init, holder_new<Py_Body>);
+    set_type(MobilizedType, "mbd.Mobilized_body", sizeof(Py_Body), holder_dealloc<Py_Body>, &BodyType, nullptr,
+        nullptr, mobilized_init, holder_new<Py_Body>);
+    set_type(JointType, "mbd.Joint", sizeof(Py_Joint), holder_dealloc<Py_Joint>, nullptr, nullptr, joint_getset,
+        joint_init, holder_new<Py_Joint>);
+    set_type(ForceType, "mbd.Force_Element", sizeof(Py_Force), holder_dealloc<Py_Force>, nullptr, nullptr,
+        force_getset);
+    set_type(GravityType, "mbd.Gravity_Field", sizeof(Py_Force), holder_dealloc<Py_Force>, &ForceType,
+        gravity_methods);
+    set_type(SpringType, "mbd.Spring_Damper", sizeof(Py_Force), holder_dealloc<Py_Force>, &ForceType,
+        spring_methods, spring_getset);
+    set_type(ContactType, "mbd.Contact_Force", sizeof(Py_Force), holder_dealloc<Py_Force>, &ForceType,
+        contact_methods, contact_getset);
+    set_type(SysType, "mbd.Dynamics_Sys", sizeof(Py_Sys), holder_dealloc<Py_Sys>, nullptr, sys_methods, sys_getset,
+        sys_init, sys_new);
+    set_type(ViewType, "mbd._View", sizeof(Py_View), view_dealloc);
+    ViewType.tp_as_buffer = &view_buffer;
+
+    PyTypeObject *types[] = {&BodyType, &GroundType, &MobilizedType, &JointType, &ForceType, &GravityType,
+        &SpringType, &ContactType, &SysType, &ViewType};
+    for (PyTypeObject *t : types) {
+        if (PyType_Ready(t) < 0) return nullptr;
+    }
+
+    PyObject *m = PyModule_Create(&module_def);
+    if (m == nullptr) return nullptr;
+    for (unsigned int k = 0; k + 1 < sizeof(types) / sizeof(types[0]); k++) {
+        Py_INCREF(types[k]);
+        if (PyModule_AddObject(m, std::strchr(types[k]->tp_name, '.') + 1, reinterpret_cast<PyObject *>(types[k]))
+            < 0) {
+            Py_DECREF(types[k]);
+            Py_DECREF(m);
+            return nullptr;
+        }
+    }
+
+    /* Enums as plain ints, named as in C++ */
+    const struct { const char *name; long value; } constants[] = {
+        {"DENSE_SOLVER", DENSE_SOLVER}, {"SPARSE_SOLVER", SPARSE_SOLVER}, {"TREE_SOLVER", TREE_SOLVER},
+        {"SCHUR_SOLVER", SCHUR_SOLVER}, {"ITERATIVE_SOLVER", ITERATIVE_SOLVER},
+        {"RK4_INTEGRATOR", RK4_INTEGRATOR}, {"DOPRI45_INTEGRATOR", DOPRI45_INTEGRATOR},
+        {"IMPLICIT_EULER_INTEGRATOR", IMPLICIT_EULER_INTEGRATOR},
+        {"SPHERICAL_JOINT", SPHERICAL_JOINT}, {"REVOLUTE_JOINT", REVOLUTE_JOINT},
+        {"PRISMATIC_JOINT", PRISMATIC_JOINT}, {"FIXED_JOINT", FIXED_JOINT}, {"UNIVERSAL_JOINT", UNIVERSAL_JOINT},
+        {"STATE_SIZE", STATE_SIZE}, {"STATE_POS", STATE_POS}, {"STATE_VEL", STATE_VEL},
+        {"STATE_QUAT", STATE_QUAT}, {"STATE_ANG_VEL", STATE_ANG_VEL},
+    };
+    for (const auto &c : constants) {
+        if (PyModule_AddIntConstant(m, c.name, c.value) < 0) {
+            Py_DECREF(m);
+            return nullptr;
+        }
+    }
+    return m;
+}
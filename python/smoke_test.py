@@ -0,0 +1,133 @@
+"""Smoke test of the mbd module.
+
+    python3 python/smoke_test.py <dir of mbd module> <main executable>
+
+Builds the chain of src/main.cpp, checks run() against step(), run_into()
+and the data.csv that main writes, that the state views follow the system,
+that init() refuses to reallocate the state under a live view, checkpoints
+and stepping from two threads. Needs no numpy: the module hands out
+memoryviews. Exits nonzero on a failure."""
+import gc
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+
+sys.path.insert(0, os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else 'build'))
+import mbd
+
+MAIN = os.path.abspath(sys.argv[2] if len(sys.argv) > 2 else 'build/main')
+NSTEPS = 2000
+failed = []
+
+
+def check(name, ok):
+    print('%-40s %s' % (name, 'ok' if ok else 'FAIL'))
+    if not ok:
+        failed.append(name)
+
+
+def main_chain():
+    """Ground and 11 bodies on spherical joints, as in src/main.cpp"""
+    sim = mbd.Dynamics_Sys(0.001)
+    z = (0., 0., 0.)
+    pj = (-1., 0., 0.)
+    ang1 = (0., -3. * 3.1415926 / 180.0, 0.)
+    prev = mbd.Ground(0)
+    sim.add(prev)
+    for i in range(11):
+        now = mbd.Mobilized_body(i + 1, z, 1.0, (1., 1., 1.), angle=z if i == 0 else ang1, force=(0., 0., 9.8))
+        sim.add(now)
+        sim.add(mbd.Joint(mbd.SPHERICAL_JOINT, z, pj, z, z, prev, now))
+        prev = now
+    sim.assembly()
+    sim.init()
+    return sim
+
+
+def positions(rows, nbody):
+    """Positions of the mobilized bodies in each state row, the data.csv columns"""
+    cols = [b * mbd.STATE_SIZE + mbd.STATE_POS + k for b in range(1, nbody) for k in range(3)]
+    return [[row[c] for c in cols] for row in rows]
+
+
+# run() against step(): the same solve() calls, so bit for bit
+sim = main_chain()
+t, traj = sim.run(NSTEPS)
+traj = traj.tolist()
+ref = main_chain()
+stepped = []
+for k in range(NSTEPS):
+    ref.step()
+    stepped.append(ref.state.tolist())
+check('run() equals step()', traj == stepped and t[NSTEPS - 1] == ref.time and len(t) == NSTEPS)
+
+# run_into() fills a preallocated buffer with every 10th state
+into = main_chain()
+buf = memoryview(bytearray(8 * (NSTEPS // 10) * into.state.shape[0])).cast('d', (NSTEPS // 10, into.state.shape[0]))
+into.run_into(buf, every=10)
+check('run_into() equals run()', buf.tolist() == traj[9::10])
+
+# run() against the C++ program: data.csv holds 6 significant digits
+if os.path.exists(MAIN):
+    with tempfile.TemporaryDirectory() as tmp:
+        subprocess.run([MAIN], cwd=tmp, check=True)
+        with open(os.path.join(tmp, 'data.csv')) as f:
+            csv = [[float(x) for x in f.readline().split()[1:]] for _ in range(NSTEPS)]
+    diff = max(abs(a - b) - 1e-5 * abs(b) for ra, rb in zip(positions(traj, sim.nbody), csv) for a, b in zip(ra, rb))
+    check('run() matches main data.csv', diff <= 1e-5)
+else:
+    print('%-40s skipped, no %s' % ('run() matches main data.csv', MAIN))
+
+# views follow the system and are read-only
+sim = main_chain()
+q = sim.state
+ans = sim.SYS_ANS
+p = sim.body(3).position
+before = q.tolist()
+p_before = p.tolist()
+sim.step(10)
+check('state view follows step()', q.tolist() != before and q.tolist() == sim.state.tolist())
+check('body view follows the body', p.tolist() != p_before and p.tolist() == sim.body(3).position.tolist())
+check('views are read-only', q.readonly and ans.readonly and p.readonly)
+check('SYS_ANS view has 6 nbody + ncons values', ans.shape == (6 * sim.nbody + sim.ncons,))
+tbi = sim.body(3).TBI
+check('TBI view is 3 x 3', tbi.shape == (3, 3) and abs(sum(x * x for x in tbi.tolist()[0]) - 1.0) < 1e-9)
+
+# init() with the same sizes keeps the buffers, a new size is refused under live views
+sim.init()
+sim.step()
+check('repeated init() keeps the state buffer', q.tolist() == sim.state.tolist())
+extra = mbd.Mobilized_body(sim.nbody, (0., 0., 0.), 1.0, (1., 1., 1.))
+sim.add(extra)
+sim.add(mbd.Joint(mbd.SPHERICAL_JOINT, (0., 0., 0.), (-1., 0., 0.), (0., 0., 0.), (0., 0., 0.),
+                  sim.body(sim.nbody - 2), extra))
+try:
+    sim.init()
+    check('init() refuses to reallocate under a view', False)
+except RuntimeError:
+    check('init() refuses to reallocate under a view', True)
+del q, ans
+gc.collect()
+sim.init()
+check('init() reallocates once the views are gone', sim.state.shape == (sim.nbody * mbd.STATE_SIZE,))
+
+# a restored checkpoint continues bit for bit
+sim = main_chain()
+sim.step(100)
+fork = mbd.restore(sim.save())
+sim.step(100)
+fork.step(100)
+check('restore(save()) continues bit for bit', fork.state.tolist() == sim.state.tolist())
+
+# step() releases the GIL: two systems stepped from two threads end as stepped alone
+sims = [main_chain(), main_chain()]
+threads = [threading.Thread(target=s.step, args=(NSTEPS,)) for s in sims]
+for th in threads:
+    th.start()
+for th in threads:
+    th.join()
+check('two threads step like one', sims[0].state.tolist() == stepped[-1] == sims[1].state.tolist())
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,51 @@
+"""Reader for the binary trajectory files written by Trajectory_Writer."""
+import struct
+import numpy as np
+
+FIELDS = [('pos', 1, 3), ('vel', 2, 3), ('quat', 4, 4), ('ang_vel', 8, 3)]
+
+
+def read_header(fileName):
+    """Header fields, plus 'bodies' (body number of each recorded body),
+    'joint_row' (first multiplier of each joint) and 'offset' (of the first
+    record). Version 1 files had neither table and skipped body 0 only."""
+    with open(fileName, 'rb') as f:
+        raw = f.read(64)
+        magic, version, nbody, mask, stride, dt, nrecords, nlambda, njoint, offset = \
+            struct.unpack('<8s4IdQ3I', raw[:52])
+        if magic[:7] != b'MBDTRAJ':
+            raise ValueError(fileName + ' is not a trajectory file')
+        if version == 1:
+            bodies, joint_row, offset = list(range(1, nbody + 1)), [], 64
+        else:
+            table = struct.unpack('<%dI' % (nbody + njoint), f.read(4 * (nbody + njoint)))
+            bodies, joint_row = list(table[:nbody]), list(table[nbody:])
+    fields = [(name, width) for name, bit, width in FIELDS if mask & bit]
+    return {'version': version, 'nbody': nbody, 'fields': fields, 'stride': stride,
+            'dt': dt, 'nrecords': nrecords, 'nlambda': nlambda,
+            'bodies': bodies, 'joint_row': joint_row, 'offset': offset}
+
+
+def read_traj(fileName):
+    """Returns (header, records); records is a memory-mapped (nrecords, stride)
+    array laid out as [time, fields of header['bodies'][0], ...]"""
+    header = read_header(fileName)
+    records = np.memmap(fileName, dtype='<f8', mode='r', offset=header['offset'],
+                        shape=(header['nrecords'], header['stride']))
+    return header, records
+
+
+def field(header, records, name):
+    """(nrecords, nbody, width) view of one field, e.g. field(h, r, 'pos'),
+    or (nrecords, nlambda) for 'lambda'; the multipliers of joint i start at
+    column header['joint_row'][i]"""
+    if name == 'lambda':
+        return records[:, header['stride'] - header['nlambda']:]
+    width = sum(w for _, w in header['fields'])
+    start = 1
+    for n, w in header['fields']:
+        if n == name:
+            body = records[:, 1:header['stride'] - header['nlambda']].reshape(len(records), header['nbody'], width)
+            return body[:, :, start - 1:start - 1 + w]
+        start += w
+    raise KeyError(name)
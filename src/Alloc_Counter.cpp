@@ -0,0 +1,63 @@
+#include "Alloc_Counter.hpp"
+
+#ifdef MBD_ALLOC_COUNTER
+
+#include <cerrno>
+#include <cstddef>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+/* Per thread, so ensemble members stepping concurrently see only their own */
+thread_local unsigned long n_alloc = 0;
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    n_alloc++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    n_alloc++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    n_alloc++;
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    n_alloc++;
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    n_alloc++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    n_alloc++;
+    *ptr = __libc_memalign(alignment, size);
+    return (*ptr == nullptr && size != 0) ? ENOMEM : 0;
+}
+
+}  // extern "C"
+
+bool alloc_counter::enabled() { return true; }
+unsigned long alloc_counter::count() { return n_alloc; }
+
+#else
+
+bool alloc_counter::enabled() { return false; }
+unsigned long alloc_counter::count() { return 0; }
+
+#endif  // MBD_ALLOC_COUNTER
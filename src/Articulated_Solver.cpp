@@ -0,0 +1,226 @@
+#include "Articulated_Solver.hpp"
+#include <algorithm>
+#include <queue>
+
+namespace {
+
+void copy_transposed(arma::mat &out, const arma::mat &A) {
+    for (unsigned int c = 0; c < A.n_cols; c++) {
+        for (unsigned int r = 0; r < A.n_rows; r++) out(c, r) = A(r, c);
+    }
+}
+
+/* Gauss-Jordan inversion without pivoting; the articulated blocks are either
+   positive definite (bodies) or negative definite (constraints) */
+void invert_in_place(arma::mat &A) {
+    unsigned int n = A.n_rows;
+    double p, f;
+
+    for (unsigned int k = 0; k < n; k++) {
+        p = 1.0 / A(k, k);
+        A(k, k) = 1.0;
+        for (unsigned int j = 0; j < n; j++) A(k, j) *= p;
+        for (unsigned int i = 0; i < n; i++) {
+            if (i == k) continue;
+            f = A(i, k);
+            A(i, k) = 0.0;
+            for (unsigned int j = 0; j < n; j++) A(i, j) -= f * A(k, j);
+        }
+    }
+}
+
+}  // namespace
+
+Articulated_Solver::Articulated_Solver() {
+    nbody = 0;
+    njoint = 0;
+    Body_array = nullptr;
+    Joint_array = nullptr;
+}
+
+/* Returns false when bodies and joints do not form a forest with one ground per tree */
+bool Articulated_Solver::build(std::vector<BodyPtr> &Body_In, std::vector<JointPtr> &Joint_In,
+        const std::vector<unsigned int> &joint_row_In, const std::vector<unsigned int> &ground_In,
+        const std::vector<unsigned int> &ground_row_In) {
+    unsigned int n_nodes, root, cur, next, n_rows;
+    std::vector<std::vector<unsigned int> > adjacency;
+    std::vector<bool> visited;
+    std::queue<unsigned int> open;
+
+    Body_array = &Body_In;
+    Joint_array = &Joint_In;
+    nbody = Body_In.size();
+    njoint = Joint_In.size();
+    if (nbody == 0 || ground_In.empty() || nbody != njoint + ground_In.size()) return false;
+
+    /* Node numbering: bodies by their number, then joints, then the rows of each ground */
+    n_nodes = nbody + njoint + ground_In.size();
+    nodes.assign(n_nodes, Node());
+    adjacency.assign(n_nodes, std::vector<unsigned int>());
+
+    for (unsigned int i = 0; i < nbody; i++) {
+        nodes[i].type = 0;
+        nodes[i].index = i;
+        nodes[i].offset = 6 * i;
+        nodes[i].dim = 6;
+    }
+    for (unsigned int i = 0; i < njoint; i++) {
+        n_rows = Joint_In[i]->get_Cqi().n_rows;
+        nodes[nbody + i].type = 1;
+        nodes[nbody + i].index = i;
+        nodes[nbody + i].offset = 6 * nbody + joint_row_In[i];
+        nodes[nbody + i].dim = n_rows;
+        adjacency[nbody + i].push_back(Joint_In[i]->get_body_i_ptr()->get_num());
+        adjacency[nbody + i].push_back(Joint_In[i]->get_body_j_ptr()->get_num());
+        adjacency[Joint_In[i]->get_body_i_ptr()->get_num()].push_back(nbody + i);
+        adjacency[Joint_In[i]->get_body_j_ptr()->get_num()].push_back(nbody + i);
+    }
+
+    /* Breadth-first from the ground rows; reaching a node twice means a loop */
+    visited.assign(n_nodes, false);
+    order.clear();
+    for (unsigned int g = 0; g < ground_In.size(); g++) {
+        root = nbody + njoint + g;
+        nodes[root].type = 1;
+        nodes[root].index = njoint + g;
+        nodes[root].offset = 6 * nbody + ground_row_In[g];
+        nodes[root].dim = 6;
+        nodes[root].parent = -1;
+        adjacency[root].push_back(ground_In[g]);
+        adjacency[ground_In[g]].push_back(root);
+        visited[root] = true;
+        open.push(root);
+    }
+    while (!open.empty()) {
+        cur = open.front();
+        open.pop();
+        order.push_back(cur);
+        for (unsigned int k = 0; k < adjacency[cur].size(); k++) {
+            next = adjacency[cur][k];
+            if (static_cast<int>(next) == nodes[cur].parent) continue;
+            if (visited[next]) return false;
+            visited[next] = true;
+            nodes[next].parent = cur;
+            open.push(next);
+        }
+    }
+    if (order.size() != n_nodes) return false;
+    std::reverse(order.begin(), order.end());
+
+    for (unsigned int k = 0; k < n_nodes; k++) {
+        Node &node = nodes[k];
+        node.D.zeros(node.dim, node.dim);
+        node.y.zeros(node.dim);
+        if (node.parent >= 0) {
+            node.J.zeros(node.dim, nodes[node.parent].dim);
+            node.L.zeros(node.dim, nodes[node.parent].dim);
+        }
+    }
+    return true;
+}
+
+/* Copy the mass blocks and joint Jacobians of the current stage into the tree */
+void Articulated_Solver::load_blocks() {
+    unsigned int b_num;
+    const Joint *joint;  // no reference counting per stage
+
+    for (unsigned int k = 0; k < nodes.size(); k++) {
+        Node &node = nodes[k];
+        if (node.type == 0) {
+            if ((*Body_array)[node.index]->get_type() == 0) {
+                node.D.eye();
+            } else {
+                node.D = (*Body_array)[node.index]->get_M();
+            }
+            /* Parent is a constraint: H(body, constraint) = Cq^T */
+            if (nodes[node.parent].index >= njoint) {
+                node.J.eye();
+            } else {
+                joint = (*Joint_array)[nodes[node.parent].index].get();
+                if (joint->get_body_i_ptr()->get_num() == node.index) {
+                    copy_transposed(node.J, joint->get_Cqi());
+                } else {
+                    copy_transposed(node.J, joint->get_Cqj());
+                }
+            }
+        } else {
+            node.D.zeros();
+            if (node.parent < 0) continue;
+            /* Parent is a body: H(constraint, body) = Cq */
+            joint = (*Joint_array)[node.index].get();
+            b_num = nodes[node.parent].index;
+            if (joint->get_body_i_ptr()->get_num() == b_num) {
+                node.J = joint->get_Cqi();
+            } else {
+                node.J = joint->get_Cqj();
+            }
+        }
+    }
+}
+
+/* Leaves-to-root elimination: D_parent -= J^T D^-1 J */
+void Articulated_Solver::factor() {
+    double sum;
+
+    load_blocks();
+    for (unsigned int k = 0; k < order.size(); k++) {
+        Node &node = nodes[order[k]];
+        invert_in_place(node.D);
+        if (node.parent < 0) continue;
+
+        Node &parent = nodes[node.parent];
+        for (unsigned int c = 0; c < parent.dim; c++) {
+            for (unsigned int r = 0; r < node.dim; r++) {
+                sum = 0.0;
+                for (unsigned int m = 0; m < node.dim; m++) sum += node.D(r, m) * node.J(m, c);
+                node.L(r, c) = sum;
+            }
+        }
+        for (unsigned int c = 0; c < parent.dim; c++) {
+            for (unsigned int r = 0; r < parent.dim; r++) {
+                sum = 0.0;
+                for (unsigned int m = 0; m < node.dim; m++) sum += node.J(m, r) * node.L(m, c);
+                parent.D(r, c) -= sum;
+            }
+        }
+    }
+}
+
+/* Forward reduction of the right-hand side, then back substitution root-to-leaves */
+void Articulated_Solver::solve(const arma::vec &RHS_In, arma::vec &ANS_Out) {
+    double sum;
+
+    for (unsigned int k = 0; k < nodes.size(); k++) {
+        for (unsigned int r = 0; r < nodes[k].dim; r++) nodes[k].y(r) = RHS_In(nodes[k].offset + r);
+    }
+
+    for (unsigned int k = 0; k < order.size(); k++) {
+        Node &node = nodes[order[k]];
+        if (node.parent < 0) continue;
+        Node &parent = nodes[node.parent];
+        for (unsigned int r = 0; r < parent.dim; r++) {
+            sum = 0.0;
+            for (unsigned int m = 0; m < node.dim; m++) sum += node.L(m, r) * node.y(m);
+            parent.y(r) -= sum;
+        }
+    }
+
+    for (unsigned int k = order.size(); k-- > 0;) {
+        Node &node = nodes[order[k]];
+        double x[6];  // blocks are at most 6 x 6
+        for (unsigned int r = 0; r < node.dim; r++) {
+            sum = 0.0;
+            for (unsigned int m = 0; m < node.dim; m++) sum += node.D(r, m) * node.y(m);
+            if (node.parent >= 0) {
+                for (unsigned int m = 0; m < nodes[node.parent].dim; m++) {
+                    sum -= node.L(r, m) * nodes[node.parent].y(m);
+                }
+            }
+            x[r] = sum;
+        }
+        for (unsigned int r = 0; r < node.dim; r++) {
+            node.y(r) = x[r];
+            ANS_Out(node.offset + r) = x[r];
+        }
+    }
+}
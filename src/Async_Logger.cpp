@@ -0,0 +1,103 @@
+#include "Async_Logger.hpp"
+#include <chrono>
+#include <iostream>
+
+Async_Logger::Async_Logger() : running(false), head(0), tail(0), dropped(0), written(0) {
+    policy = LOG_BLOCK;
+    capacity = 0;
+    stride = 0;
+    skip_shift = 0;
+    npush = 0;
+}
+
+Async_Logger::~Async_Logger() { stop(); }
+
+/* Opens the file and starts the writer thread; capacity is rounded up to a power of two */
+bool Async_Logger::start(const std::string &file_In, const Dynamics_Sys &sys_In, unsigned int field_mask_In,
+        unsigned int capacity_In, Log_Policy policy_In, Traj_Mode mode_In) {
+    stop();
+    if (!writer.open(file_In, sys_In, field_mask_In, 1, mode_In)) return false;
+
+    policy = policy_In;
+    stride = writer.get_stride();
+    capacity = 2;
+    while (capacity < capacity_In) capacity <<= 1;
+    ring.assign(capacity * stride, 0.0);
+    head.store(0);
+    tail.store(0);
+    skip_shift = 0;
+    npush = 0;
+    dropped.store(0);
+    written.store(0);
+
+    running.store(true);
+    consumer = std::thread(&Async_Logger::Writer_Loop, this);
+    return true;
+}
+
+/* Returns false when the snapshot was not queued */
+bool Async_Logger::push(const Dynamics_Sys &sys_In) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t used;
+
+    if (!running.load(std::memory_order_relaxed)) return false;
+
+    if (policy == LOG_DECIMATE) {
+        used = h - tail.load(std::memory_order_acquire);
+        if (skip_shift > 0 && used < capacity / 4) skip_shift--;
+        if ((npush++ & ((1ul << skip_shift) - 1)) != 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    while (h - tail.load(std::memory_order_acquire) == capacity) {
+        if (policy == LOG_BLOCK) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (policy == LOG_DECIMATE && skip_shift < 16) skip_shift++;
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    writer.pack(sys_In, &ring[(h & (capacity - 1)) * stride]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+/* Drains what is queued, then joins the writer thread and closes the file */
+void Async_Logger::stop() {
+    if (!running.load()) return;
+    running.store(false);
+    consumer.join();
+    writer.close();
+    if (dropped.load() > 0) {
+        std::cerr << "Async_Logger: dropped " << dropped.load() << " snapshots" << std::endl;
+    }
+}
+
+unsigned long Async_Logger::get_dropped() const { return dropped.load(); }
+unsigned long Async_Logger::get_written() const { return written.load(); }
+
+void Async_Logger::Writer_Loop() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h;
+    bool live;
+
+    while (true) {
+        /* Read the flag before head so the last pushes are drained after stop() */
+        live = running.load(std::memory_order_acquire);
+        h = head.load(std::memory_order_acquire);
+        if (h == t) {
+            if (!live) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        for (; t != h; t++) {
+            writer.write_record(&ring[(t & (capacity - 1)) * stride]);
+            tail.store(t + 1, std::memory_order_release);
+        }
+        written.store(t, std::memory_order_relaxed);
+    }
+}
@@ -1,44 +1,66 @@
 #include "Body.hpp"
 
 Body::Body() :
-    POSITION(3, arma::fill::zeros),
-    VELOCITY(3, arma::fill::zeros),
-    ACCELERATION(3, arma::fill::zeros),
-    ANGLE(3, arma::fill::zeros),
-    ANGLE_VEL(3, arma::fill::zeros),
-    ANGLE_ACC(3, arma::fill::zeros),
-    M(6, 6, arma::fill::eye),
-    FORCE(3, arma::fill::zeros),
-    TORQUE(3, arma::fill::zeros),
-    TBI(3, 3, arma::fill::zeros),
-    TBI_Q(4, arma::fill::zeros),
-    TBID_Q(4, arma::fill::zeros) {
+    POSITION(arma::fill::zeros),
+    VELOCITY(arma::fill::zeros),
+    ACCELERATION(arma::fill::zeros),
+    ANGLE(arma::fill::zeros),
+    ANGLE_VEL(arma::fill::zeros),
+    ANGLE_ACC(arma::fill::zeros),
+    M(arma::fill::eye),
+    FORCE(arma::fill::zeros),
+    TORQUE(arma::fill::zeros),
+    APPILED_TORQUE(arma::fill::zeros),
+    TBI(arma::fill::zeros),
+    TBI_Q(arma::fill::zeros),
+    TBID_Q(arma::fill::zeros) {
+    quat_gain = 50.0;
+    angle_valid = true;
 }
 
-arma::vec Body::get_POSITION() { return POSITION; }
-arma::mat Body::get_TBI() { return TBI; }
-arma::vec Body::get_ANGLE_VEL() { return ANGLE_VEL; }
-arma::vec Body::get_ANGLE() { return ANGLE; }
-arma::vec Body::get_VELOCITY() { return VELOCITY; }
-arma::vec Body::get_ACCELERATION() { return ACCELERATION; }
-arma::vec Body::get_ANGLE_ACC() { return ANGLE_ACC; }
-arma::vec Body::get_FORCE() { return FORCE; }
-arma::vec Body::get_TORQUE() { return TORQUE; }
-arma::mat Body::get_M() { return M; }
-arma::vec Body::get_TBI_Q() { return TBI_Q;}
-arma::vec Body::get_TBID_Q() { return TBID_Q;}
-unsigned int Body::get_num() { return num; }
+const arma::vec3 &Body::get_POSITION() const { return POSITION; }
+const arma::mat33 &Body::get_TBI() const { return TBI; }
+const arma::vec3 &Body::get_ANGLE_VEL() const { return ANGLE_VEL; }
+/* The dynamics never read the Euler angles of a moving body, so update()
+   only marks them stale and the asin/acos run here, once per step at most.
+   Not safe to call from several threads while the body is being updated. */
+const arma::vec3 &Body::get_ANGLE() const {
+    if (!angle_valid) {
+        ANGLE = euler_angle(TBI);
+        angle_valid = true;
+    }
+    return ANGLE;
+}
+const arma::vec3 &Body::get_VELOCITY() const { return VELOCITY; }
+const arma::vec3 &Body::get_ACCELERATION() const { return ACCELERATION; }
+const arma::vec3 &Body::get_ANGLE_ACC() const { return ANGLE_ACC; }
+const arma::vec3 &Body::get_FORCE() const { return FORCE; }
+const arma::vec3 &Body::get_TORQUE() const { return TORQUE; }
+const arma::vec3 &Body::get_APPLIED_TORQUE() const { return APPILED_TORQUE; }
+const arma::mat66 &Body::get_M() const { return M; }
+const arma::vec4 &Body::get_TBI_Q() const { return TBI_Q;}
+const arma::vec4 &Body::get_TBID_Q() const { return TBID_Q;}
+unsigned int Body::get_num() const { return num; }
+unsigned int Body::get_type() const { return type; }
+double Body::get_quat_gain() const { return quat_gain; }
 
 void Body::set_POSITION(const arma::vec &PosIn) { POSITION = PosIn; }
 void Body::set_VELOCITY(const arma::vec &VelIn) { VELOCITY = VelIn; }
 void Body::set_ACCELERATION(const arma::vec &AccIn) { ACCELERATION = AccIn; }
-void Body::set_ANGLE(const arma::vec &AngIn) { ANGLE = AngIn; }
+void Body::set_ANGLE(const arma::vec &AngIn) {
+    ANGLE = AngIn;
+    angle_valid = true;
+}
 void Body::set_ANGLE_VEL(const arma::vec &AngvelIn) { ANGLE_VEL = AngvelIn; }
 void Body::set_ANGLE_ACC(const arma::vec &AngaccIn) { ANGLE_ACC = AngaccIn; }
 void Body::set_TBI(const arma::mat &TBIIn) { 
     TBI = TBIIn; 
     Matrix2Quaternion(TBI, TBI_Q);
+    angle_valid = false;
     }
+void Body::set_quat_gain(double Gain_In) { quat_gain = Gain_In; }
+void Body::set_FORCE(const arma::vec &F_In) { FORCE = F_In; }
+void Body::set_APPLIED_TORQUE(const arma::vec &T_In) { APPILED_TORQUE = T_In; }
 
 Ground::Ground(unsigned int NumIn) {
     for (unsigned int i = 0; i < 3; i++) {
@@ -51,9 +73,16 @@ Ground::Ground(unsigned int NumIn) {
     TBI.eye();
 }
 
-Mobilized_body::Mobilized_body(unsigned int NumIn, arma::vec PosIn, arma::vec VelIn, arma::vec AccIn, arma::vec AttIn
-        , arma::vec ANG_VEL_In, arma::vec ANG_ACC_In, double MIn, arma::vec IIn
-        , arma::vec F_In, arma::vec T_In) {
+Ground::Ground(unsigned int NumIn, const arma::vec &PosIn, const arma::vec &AttIn) : Ground(NumIn) {
+    POSITION = PosIn;
+    build_psi_tht_phi_TM(AttIn(2), AttIn(1), AttIn(0), TBI);
+    Matrix2Quaternion(TBI, TBI_Q);
+    angle_valid = false;
+}
+
+Mobilized_body::Mobilized_body(unsigned int NumIn, const arma::vec &PosIn, const arma::vec &VelIn, const arma::vec &AccIn
+        , const arma::vec &AttIn, const arma::vec &ANG_VEL_In, const arma::vec &ANG_ACC_In, double MIn
+        , const arma::vec &IIn, const arma::vec &F_In, const arma::vec &T_In) {
     
     type = 1;
     num = NumIn;
@@ -80,14 +109,14 @@ Mobilized_body::Mobilized_body(unsigned int NumIn, arma::vec PosIn, arma::vec Ve
     ANGLE_ACC = trans(TBI) * ANGLE_ACC;
 }
 
-void Mobilized_body::update(arma::vec PosIn, arma::vec VelIn, arma::vec TBI_QIn
-        , arma::vec ANG_VEL_In) {
+void Mobilized_body::update(const arma::vec &PosIn, const arma::vec &VelIn, const arma::vec &TBI_QIn
+        , const arma::vec &ANG_VEL_In) {
 
     Quaternion2Matrix(TBI_QIn, TBI);
 
     POSITION = PosIn;
     VELOCITY = VelIn;
-    ANGLE = euler_angle(TBI);
+    angle_valid = false;
     ANGLE_VEL = ANG_VEL_In;
 
     /* Prepare for orthonormalization */
@@ -98,16 +127,32 @@ void Mobilized_body::update(arma::vec PosIn, arma::vec VelIn, arma::vec TBI_QIn
     /* Calculate Previous states */  //  Zipfel p.141
     TBID_Q(0) = 0.5 * (-ANG_VEL_In(0) * TBI_QIn(1) - ANG_VEL_In(1) * TBI_QIn(2) -
                            ANG_VEL_In(2) * TBI_QIn(3)) +
-                    50. * erq * TBI_QIn(0);
+                    quat_gain * erq * TBI_QIn(0);
     TBID_Q(1) = 0.5 * (ANG_VEL_In(0) * TBI_QIn(0) + ANG_VEL_In(2) * TBI_QIn(2) -
                            ANG_VEL_In(1) * TBI_QIn(3)) +
-                    50. * erq * TBI_QIn(1);
+                    quat_gain * erq * TBI_QIn(1);
     TBID_Q(2) = 0.5 * (ANG_VEL_In(1) * TBI_QIn(0) - ANG_VEL_In(2) * TBI_QIn(1) +
                            ANG_VEL_In(0) * TBI_QIn(3)) +
-                    50. * erq * TBI_QIn(2);
+                    quat_gain * erq * TBI_QIn(2);
     TBID_Q(3) = 0.5 * (ANG_VEL_In(2) * TBI_QIn(0) + ANG_VEL_In(1) * TBI_QIn(1) -
                            ANG_VEL_In(0) * TBI_QIn(2)) +
-                    50. * erq * TBI_QIn(3);
+                    quat_gain * erq * TBI_QIn(3);
+
+    TORQUE = APPILED_TORQUE - skew_sym(ANGLE_VEL) * M.submat(3, 3, 5, 5) * ANGLE_VEL;
+}
+
+void Mobilized_body::load_state(const double *Pos_In, const double *Vel_In, const double *Ang_Vel_In,
+        const double *TBI_In, const double *TBID_Q_In, unsigned int ld_In) {
+    for (unsigned int k = 0; k < 3; k++) {
+        POSITION(k) = Pos_In[k];
+        VELOCITY(k) = Vel_In[k];
+        ANGLE_VEL(k) = Ang_Vel_In[k];
+    }
+    angle_valid = false;
+    for (unsigned int r = 0; r < 3; r++) {
+        for (unsigned int c = 0; c < 3; c++) TBI(r, c) = TBI_In[(3 * r + c) * ld_In];
+    }
+    for (unsigned int k = 0; k < 4; k++) TBID_Q(k) = TBID_Q_In[k * ld_In];
 
     TORQUE = APPILED_TORQUE - skew_sym(ANGLE_VEL) * M.submat(3, 3, 5, 5) * ANGLE_VEL;
 }
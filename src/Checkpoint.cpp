@@ -0,0 +1,565 @@
+#include "Checkpoint.hpp"
+#include <boost/make_shared.hpp>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static_assert(sizeof(Ckpt_Header) == 184, "checkpoint header must stay 184 bytes");
+static_assert(sizeof(Ckpt_Body) == 96, "checkpoint body record must stay 96 bytes");
+static_assert(sizeof(Ckpt_Joint) == 160, "checkpoint joint record must stay 160 bytes");
+
+namespace {
+
+const uint32_t CKPT_VERSION = 2;
+
+/* Doubles of the state block: q, q_d, k1, q_out, 5 dense_coef columns, SYS_ANS */
+uint64_t state_doubles(uint64_t nbody_In, uint64_t ncons_In) {
+    return 9 * nbody_In * STATE_SIZE + 6 * nbody_In + ncons_In;
+}
+
+uint64_t checkpoint_bytes(uint64_t nbody_In, uint64_t njoint_In, uint64_t ncons_In) {
+    return sizeof(Ckpt_Header) + nbody_In * sizeof(Ckpt_Body) + njoint_In * sizeof(Ckpt_Joint)
+        + 8 * state_doubles(nbody_In, ncons_In);
+}
+
+char *put(char *p_In, const double *x_In, unsigned int n_In) {
+    std::memcpy(p_In, x_In, 8 * n_In);
+    return p_In + 8 * n_In;
+}
+
+const char *get(const char *p_In, double *x_Out, unsigned int n_In) {
+    std::memcpy(x_Out, p_In, 8 * n_In);
+    return p_In + 8 * n_In;
+}
+
+/* Counted array of the analysis block: a uint64 count, then the elements */
+template <typename T>
+void put_array(std::vector<char> &buf_Out, const std::vector<T> &x_In) {
+    const uint64_t count = x_In.size();
+    const char *p = reinterpret_cast<const char *>(&count);
+
+    buf_Out.insert(buf_Out.end(), p, p + 8);
+    p = reinterpret_cast<const char *>(x_In.data());
+    buf_Out.insert(buf_Out.end(), p, p + count * sizeof(T));
+}
+
+template <typename T>
+bool get_array(const char *&p_InOut, const char *end_In, std::vector<T> &x_Out) {
+    uint64_t count;
+
+    if (end_In - p_InOut < 8) return false;
+    std::memcpy(&count, p_InOut, 8);
+    p_InOut += 8;
+    if (count > static_cast<uint64_t>(end_In - p_InOut) / sizeof(T)) return false;
+    x_Out.resize(count);
+    if (count > 0) std::memcpy(x_Out.data(), p_InOut, count * sizeof(T));
+    p_InOut += count * sizeof(T);
+    return true;
+}
+
+bool all_below(const std::vector<unsigned int> &x_In, uint64_t bound_In) {
+    for (unsigned int k = 0; k < x_In.size(); k++) {
+        if (x_In[k] >= bound_In) return false;
+    }
+    return true;
+}
+
+/* Column pointers: n_In + 1 entries from 0, nondecreasing, ending at nnz_In */
+bool is_pointer(const std::vector<unsigned int> &p_In, unsigned int n_In, uint64_t nnz_In) {
+    if (p_In.size() != n_In + 1 || p_In[0] != 0 || p_In[n_In] != nnz_In) return false;
+    for (unsigned int k = 0; k < n_In; k++) {
+        if (p_In[k] > p_In[k + 1]) return false;
+    }
+    return true;
+}
+
+/* A ground keeps the pose it was built with in q; the default ground at
+   the origin has a zero quaternion there and keeps TBI = I */
+void restore_ground(Body &body_Out, const char *q_In) {
+    double x[STATE_SIZE];
+    arma::vec4 quat;
+    arma::mat TBI(3, 3, arma::fill::zeros);
+
+    get(q_In, x, STATE_SIZE);
+    body_Out.set_POSITION(arma::vec{x[STATE_POS], x[STATE_POS + 1], x[STATE_POS + 2]});
+    for (unsigned int k = 0; k < 4; k++) quat(k) = x[STATE_QUAT + k];
+    if (arma::dot(quat, quat) > 0.0) {
+        Quaternion2Matrix(quat, TBI);
+        body_Out.set_TBI(TBI);
+    }
+}
+
+}  // namespace
+
+bool Checkpoint::save(const Dynamics_Sys &sys_In, std::vector<char> &buf_Out, bool analysis_In) {
+    const Dynamics_Sys &s = sys_In;
+    Ckpt_Header header;
+    Ckpt_Body body;
+    Ckpt_Joint joint;
+    std::vector<char> analysis;
+    const unsigned int n = s.q.n_elem;
+
+    if (s.SYS_RHS.n_elem == 0) {
+        std::cerr << "Checkpoint: system is not initialized" << std::endl;
+        return false;
+    }
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "MBDCKPT", 8);
+    header.version = CKPT_VERSION;
+    header.nbody = s.nbody;
+    header.njoint = s.njoint;
+    header.ncons = s.ncons;
+    header.solver = s.solver;
+    header.integrator = s.integrator;
+    header.flags = (s.fsal_valid ? CKPT_FSAL : 0) | (s.proj_position ? CKPT_PROJ_POS : 0)
+        | (s.proj_velocity ? CKPT_PROJ_VEL : 0) | (analysis_In ? CKPT_ANALYSIS : 0);
+    header.proj_max_iter = s.proj_max_iter;
+    header.iter_max_iter = s.iter_max_iter;
+    header.dt = s.dt;
+    header.t_int = s.t_int;
+    header.t_sample = s.t_sample;
+    header.t_old = s.t_old;
+    header.h = s.h;
+    header.h_max = s.h_max;
+    header.rtol = s.rtol;
+    header.atol = s.atol;
+    header.baum_alpha = s.baum_alpha;
+    header.baum_beta = s.baum_beta;
+    header.proj_tol = s.proj_tol;
+    header.iter_tol = s.iter_tol;
+    header.n_feval = s.n_feval;
+    header.n_reject = s.n_reject;
+    header.n_newton = s.n_newton;
+    header.n_iter = s.n_iter;
+    header.bytes = checkpoint_bytes(s.nbody, s.njoint, s.ncons);
+    if (analysis_In) {
+        Save_Analysis(s, analysis);
+        header.bytes += analysis.size();
+    }
+
+    /* resize() keeps the capacity of a reused buffer */
+    buf_Out.resize(header.bytes);
+    char *p = buf_Out.data();
+    std::memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+
+    for (unsigned int i = 0; i < s.nbody; i++) {
+        const BodyPtr &b = s.Body_ptr_array[i];
+        const arma::mat66 &M = b->get_M();
+
+        std::memset(&body, 0, sizeof(body));
+        body.type = b->get_type();
+        body.num = b->get_num();
+        body.mass = M(0, 0);
+        for (unsigned int k = 0; k < 3; k++) {
+            body.inertia[k] = M(3 + k, 3 + k);
+            body.force[k] = b->get_FORCE()(k);
+            body.torque[k] = b->get_APPLIED_TORQUE()(k);
+        }
+        body.quat_gain = b->get_quat_gain();
+        std::memcpy(p, &body, sizeof(body));
+        p += sizeof(body);
+    }
+
+    for (unsigned int i = 0; i < s.njoint; i++) {
+        const JointPtr &jt = s.Joint_ptr_array[i];
+        arma::vec6 ref = jt->get_reference();
+
+        std::memset(&joint, 0, sizeof(joint));
+        joint.type = jt->get_type();
+        joint.body_i = jt->get_body_i_ptr()->get_num();
+        joint.body_j = jt->get_body_j_ptr()->get_num();
+        for (unsigned int k = 0; k < 3; k++) {
+            joint.pi[k] = jt->get_pi()(k);
+            joint.pj[k] = jt->get_pj()(k);
+            joint.qi[k] = jt->get_qi()(k);
+            joint.qj[k] = jt->get_qj()(k);
+        }
+        for (unsigned int k = 0; k < 6; k++) joint.ref[k] = ref(k);
+        std::memcpy(p, &joint, sizeof(joint));
+        p += sizeof(joint);
+    }
+
+    p = put(p, s.q.memptr(), n);
+    p = put(p, s.q_d.memptr(), n);
+    p = put(p, s.k1.memptr(), n);
+    p = put(p, s.q_out.memptr(), n);
+    p = put(p, s.dense_coef.memptr(), 5 * n);
+    p = put(p, s.SYS_ANS.memptr(), s.SYS_ANS.n_elem);
+    if (!analysis.empty()) std::memcpy(p, analysis.data(), analysis.size());
+    return true;
+}
+
+void Checkpoint::Save_Analysis(const Dynamics_Sys &sys_In, std::vector<char> &buf_Out) {
+    const Topology &topo = sys_In.TOPO;
+    const Sparse_LDL &kkt = sys_In.SP_KKT;
+    const std::vector<unsigned int> topo_size = {topo.nbody, topo.njoint, topo.nloop, topo.grounded ? 1u : 0u};
+
+    buf_Out.assign(8, 0);  // hash of the rest
+    put_array(buf_Out, topo_size);
+    put_array(buf_Out, topo.joint_i);
+    put_array(buf_Out, topo.joint_j);
+    put_array(buf_Out, topo.joint_dim);
+    put_array(buf_Out, topo.adj_ptr);
+    put_array(buf_Out, topo.adj_joint);
+    put_array(buf_Out, topo.ground);
+    put_array(buf_Out, topo.order);
+    put_array(buf_Out, topo.position);
+    put_array(buf_Out, topo.tree_joint);
+    put_array(buf_Out, topo.tree_body);
+    put_array(buf_Out, sys_In.ground_row);
+    put_array(buf_Out, sys_In.joint_row);
+    if (sys_In.solver == SPARSE_SOLVER) {
+        put_array(buf_Out, kkt.Ap);
+        put_array(buf_Out, kkt.Ai);
+        put_array(buf_Out, kkt.P);
+        put_array(buf_Out, kkt.Lp);
+        put_array(buf_Out, kkt.Parent);
+        put_array(buf_Out, sys_In.sp_mass_idx);
+        put_array(buf_Out, sys_In.sp_joint_idx);
+        put_array(buf_Out, sys_In.sp_joint_off);
+    }
+    const uint64_t h = hash(buf_Out.data() + 8, buf_Out.size() - 8);
+    std::memcpy(buf_Out.data(), &h, 8);
+}
+
+bool Checkpoint::save(const Dynamics_Sys &sys_In, const std::string &file_In) {
+    std::vector<char> buf;
+
+    if (!save(sys_In, buf)) return false;
+
+    std::ofstream fout(file_In, std::ios::binary | std::ios::trunc);
+    fout.write(buf.data(), buf.size());
+    if (!fout) {
+        std::cerr << "Checkpoint: cannot write " << file_In << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::Check(const char *buf_In, size_t size_In, Ckpt_Header &header_Out) {
+    if (size_In < sizeof(header_Out)) {
+        std::cerr << "Checkpoint: truncated header" << std::endl;
+        return false;
+    }
+    std::memcpy(&header_Out, buf_In, sizeof(header_Out));
+    if (std::memcmp(header_Out.magic, "MBDCKPT", 8) != 0) {
+        std::cerr << "Checkpoint: not a checkpoint" << std::endl;
+        return false;
+    }
+    if (header_Out.version != CKPT_VERSION) {
+        std::cerr << "Checkpoint: unsupported version " << header_Out.version << std::endl;
+        return false;
+    }
+    const uint64_t base = checkpoint_bytes(header_Out.nbody, header_Out.njoint, header_Out.ncons);
+    if (header_Out.nbody < 1 || header_Out.bytes != size_In
+        || ((header_Out.flags & CKPT_ANALYSIS) ? header_Out.bytes < base + 8 : header_Out.bytes != base)) {
+        std::cerr << "Checkpoint: size does not match the header" << std::endl;
+        return false;
+    }
+    if (header_Out.solver > ITERATIVE_SOLVER || header_Out.integrator > IMPLICIT_EULER_INTEGRATOR) {
+        std::cerr << "Checkpoint: unknown solver " << header_Out.solver << " or integrator "
+                  << header_Out.integrator << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* Everything but the bodies and joints themselves; the step-size history and
+   the FSAL stage come along, so a continuation repeats the uninterrupted run
+   bit for bit. Implicit Euler keeps nothing between steps. */
+void Checkpoint::Apply(Dynamics_Sys &sys_In, const Ckpt_Header &header_In, const char *buf_In) {
+    Dynamics_Sys &s = sys_In;
+    Ckpt_Joint joint;
+    arma::vec6 ref;
+    const unsigned int n = s.q.n_elem;
+    const char *p = buf_In + sizeof(Ckpt_Header) + s.nbody * sizeof(Ckpt_Body);
+
+    s.iter_tol = header_In.iter_tol;
+    s.iter_max_iter = header_In.iter_max_iter;
+    if (s.solver != static_cast<Solver_Type>(header_In.solver)) {
+        s.set_solver(static_cast<Solver_Type>(header_In.solver));
+    } else {
+        s.set_iterative(s.iter_tol, s.iter_max_iter);
+    }
+    s.integrator = static_cast<Integrator_Type>(header_In.integrator);
+    s.dt = header_In.dt;
+    s.t_int = header_In.t_int;
+    s.t_sample = header_In.t_sample;
+    s.t_old = header_In.t_old;
+    s.h = header_In.h;
+    s.h_max = header_In.h_max;
+    s.rtol = header_In.rtol;
+    s.atol = header_In.atol;
+    s.baum_alpha = header_In.baum_alpha;
+    s.baum_beta = header_In.baum_beta;
+    s.proj_position = (header_In.flags & CKPT_PROJ_POS) != 0;
+    s.proj_velocity = (header_In.flags & CKPT_PROJ_VEL) != 0;
+    s.proj_tol = header_In.proj_tol;
+    s.proj_max_iter = header_In.proj_max_iter;
+    s.n_feval = header_In.n_feval;
+    s.n_reject = header_In.n_reject;
+    s.n_newton = header_In.n_newton;
+    s.n_iter = header_In.n_iter;
+
+    for (unsigned int i = 0; i < s.njoint; i++) {
+        std::memcpy(&joint, p, sizeof(joint));
+        p += sizeof(joint);
+        for (unsigned int k = 0; k < 6; k++) ref(k) = joint.ref[k];
+        s.Joint_ptr_array[i]->load_reference(ref);
+    }
+
+    p = get(p, s.q.memptr(), n);
+    p = get(p, s.q_d.memptr(), n);
+    p = get(p, s.k1.memptr(), n);
+    p = get(p, s.q_out.memptr(), n);
+    p = get(p, s.dense_coef.memptr(), 5 * n);
+    get(p, s.SYS_ANS.memptr(), s.SYS_ANS.n_elem);
+    s.fsal_valid = (header_In.flags & CKPT_FSAL) != 0;
+    s.step_failed = false;
+
+    /* Bodies and joints at q, as after a step */
+    s.Update_Kinematics(s.q);
+    s.Cal_Constraints();
+}
+
+/* An uninitialized system is initialized first, from its own bodies */
+bool Checkpoint::load(Dynamics_Sys &sys_In, const char *buf_In, size_t size_In) {
+    Ckpt_Header header;
+    Ckpt_Joint joint;
+
+    if (!Check(buf_In, size_In, header)) return false;
+    if (sys_In.SYS_RHS.n_elem == 0) sys_In.init();
+
+    bool same = header.nbody == sys_In.nbody && header.njoint == sys_In.njoint && header.ncons == sys_In.ncons;
+    const char *p = buf_In + sizeof(Ckpt_Header) + header.nbody * sizeof(Ckpt_Body);
+    for (unsigned int i = 0; same && i < header.njoint; i++) {
+        const JointPtr &jt = sys_In.Joint_ptr_array[i];
+
+        std::memcpy(&joint, p + i * sizeof(joint), sizeof(joint));
+        same = joint.type == static_cast<uint32_t>(jt->get_type())
+            && joint.body_i == jt->get_body_i_ptr()->get_num()
+            && joint.body_j == jt->get_body_j_ptr()->get_num();
+    }
+    if (!same) {
+        std::cerr << "Checkpoint: topology differs from the system" << std::endl;
+        return false;
+    }
+
+    Apply(sys_In, header, buf_In);
+    return true;
+}
+
+bool Checkpoint::load(Dynamics_Sys &sys_In, const std::vector<char> &buf_In) {
+    return load(sys_In, buf_In.data(), buf_In.size());
+}
+
+bool Checkpoint::load(Dynamics_Sys &sys_In, const std::string &file_In) {
+    std::vector<char> buf;
+
+    return Read_File(file_In, buf) && load(sys_In, buf);
+}
+
+/* Bodies are numbered by their position in the system, so records come back
+   in order; the initial pose given to the constructors is overwritten by q */
+DynSysPtr Checkpoint::restore(const char *buf_In, size_t size_In) {
+    Ckpt_Header header;
+    Ckpt_Body body;
+    Ckpt_Joint joint;
+    std::vector<BodyPtr> bodies;
+    arma::vec3 zero(arma::fill::zeros);
+    arma::vec3 inertia, force, torque, pi, pj, qi, qj;
+
+    if (!Check(buf_In, size_In, header)) return DynSysPtr();
+
+    DynSysPtr sys = boost::make_shared<Dynamics_Sys>(header.dt);
+    const char *p = buf_In + sizeof(Ckpt_Header);
+    const char *state = p + header.nbody * sizeof(Ckpt_Body) + header.njoint * sizeof(Ckpt_Joint);  // q
+
+    for (unsigned int i = 0; i < header.nbody; i++) {
+        std::memcpy(&body, p, sizeof(body));
+        p += sizeof(body);
+        if (body.num != i) {
+            std::cerr << "Checkpoint: body " << i << " is numbered " << body.num << std::endl;
+            return DynSysPtr();
+        }
+        if (body.type > 1) {
+            std::cerr << "Checkpoint: body " << i << " has unknown type " << body.type << std::endl;
+            return DynSysPtr();
+        }
+        for (unsigned int k = 0; k < 3; k++) {
+            inertia(k) = body.inertia[k];
+            force(k) = body.force[k];
+            torque(k) = body.torque[k];
+        }
+        if (body.type == 0) {
+            bodies.push_back(sys->Create<Ground>(body.num));
+            restore_ground(*bodies.back(), state + 8 * i * STATE_SIZE);
+        } else {
+            bodies.push_back(sys->Create<Mobilized_body>(body.num, zero, zero, zero, zero, zero, zero,
+                body.mass, inertia, force, torque));
+        }
+        bodies.back()->set_quat_gain(body.quat_gain);
+    }
+
+    for (unsigned int i = 0; i < header.njoint; i++) {
+        std::memcpy(&joint, p, sizeof(joint));
+        p += sizeof(joint);
+        if (joint.body_i >= header.nbody || joint.body_j >= header.nbody) {
+            std::cerr << "Checkpoint: joint " << i << " references a missing body" << std::endl;
+            return DynSysPtr();
+        }
+        if (joint.type > UNIVERSAL_JOINT) {
+            std::cerr << "Checkpoint: joint " << i << " has unknown type " << joint.type << std::endl;
+            return DynSysPtr();
+        }
+        for (unsigned int k = 0; k < 3; k++) {
+            pi(k) = joint.pi[k];
+            pj(k) = joint.pj[k];
+            qi(k) = joint.qi[k];
+            qj(k) = joint.qj[k];
+        }
+        sys->Create_Joint(static_cast<Joint_Type>(joint.type), pi, pj, qi, qj,
+            bodies[joint.body_i], bodies[joint.body_j]);
+    }
+
+    sys->solver = static_cast<Solver_Type>(header.solver);
+    if (header.flags & CKPT_ANALYSIS) {
+        sys->ncons = header.ncons;
+        if (!Load_Analysis(*sys, buf_In + checkpoint_bytes(header.nbody, header.njoint, header.ncons),
+                buf_In + size_In)) return DynSysPtr();
+        sys->Init_State();
+        sys->Init_Handles();
+        sys->Init_Analyzed();
+    } else {
+        sys->init();
+    }
+    if (sys->ncons != header.ncons) {
+        std::cerr << "Checkpoint: rebuilt system has " << sys->ncons << " constraint rows, expected "
+                  << header.ncons << std::endl;
+        return DynSysPtr();
+    }
+    Apply(*sys, header, buf_In);
+    return sys;
+}
+
+/* Sizes and index ranges are checked against the rebuilt bodies and joints,
+   so a damaged block is refused before any solver reads it */
+bool Checkpoint::Load_Analysis(Dynamics_Sys &sys_In, const char *buf_In, const char *end_In) {
+    Dynamics_Sys &s = sys_In;
+    Topology &topo = s.TOPO;
+    Sparse_LDL &kkt = s.SP_KKT;
+    std::vector<unsigned int> topo_size;
+    const char *p = buf_In + 8;
+    const unsigned int nkkt = 6 * s.nbody + s.ncons;
+    uint64_t h;
+    bool ok;
+
+    std::memcpy(&h, buf_In, 8);
+    ok = h == hash(p, end_In - p) && get_array(p, end_In, topo_size) && get_array(p, end_In, topo.joint_i)
+        && get_array(p, end_In, topo.joint_j) && get_array(p, end_In, topo.joint_dim)
+        && get_array(p, end_In, topo.adj_ptr) && get_array(p, end_In, topo.adj_joint)
+        && get_array(p, end_In, topo.ground) && get_array(p, end_In, topo.order)
+        && get_array(p, end_In, topo.position) && get_array(p, end_In, topo.tree_joint)
+        && get_array(p, end_In, topo.tree_body) && get_array(p, end_In, s.ground_row)
+        && get_array(p, end_In, s.joint_row);
+    ok = ok && topo_size.size() == 4 && topo_size[0] == s.nbody && topo_size[1] == s.njoint
+        && topo.joint_i.size() == s.njoint && topo.joint_j.size() == s.njoint && topo.joint_dim.size() == s.njoint
+        && is_pointer(topo.adj_ptr, s.nbody, topo.adj_joint.size()) && all_below(topo.adj_joint, s.njoint)
+        && all_below(topo.ground, s.nbody) && topo.order.size() == s.nbody && all_below(topo.order, s.nbody)
+        && topo.position.size() == s.nbody && all_below(topo.position, s.nbody)
+        && topo.tree_joint.size() == topo.tree_body.size() && all_below(topo.tree_joint, s.njoint)
+        && all_below(topo.tree_body, s.nbody) && s.ground_row.size() == topo.ground.size()
+        && s.joint_row.size() == s.njoint;
+    unsigned int nground = 0;
+    for (unsigned int i = 0; i < s.nbody; i++) nground += s.Body_ptr_array[i]->get_type() == 0;
+    ok = ok && nground == topo.ground.size();
+    for (unsigned int g = 0; ok && g < s.ground_row.size(); g++) {
+        ok = s.Body_ptr_array[topo.ground[g]]->get_type() == 0 && s.ground_row[g] + 6 <= s.ncons;
+    }
+    for (unsigned int i = 0; ok && i < s.njoint; i++) {
+        ok = topo.joint_i[i] == s.Joint_ptr_array[i]->get_body_i_ptr()->get_num()
+            && topo.joint_j[i] == s.Joint_ptr_array[i]->get_body_j_ptr()->get_num()
+            && topo.joint_dim[i] == s.Joint_ptr_array[i]->get_Cqi().n_rows
+            && s.joint_row[i] + topo.joint_dim[i] <= s.ncons;
+    }
+
+    if (ok && s.solver == SPARSE_SOLVER) {
+        ok = get_array(p, end_In, kkt.Ap) && get_array(p, end_In, kkt.Ai) && get_array(p, end_In, kkt.P)
+            && get_array(p, end_In, kkt.Lp) && get_array(p, end_In, kkt.Parent)
+            && get_array(p, end_In, s.sp_mass_idx) && get_array(p, end_In, s.sp_joint_idx)
+            && get_array(p, end_In, s.sp_joint_off);
+        ok = ok && is_pointer(kkt.Ap, nkkt, kkt.Ai.size()) && all_below(kkt.Ai, nkkt) && kkt.P.size() == nkkt
+            && all_below(kkt.P, nkkt) && !kkt.Lp.empty() && is_pointer(kkt.Lp, nkkt, kkt.Lp.back())
+            && kkt.Parent.size() == nkkt && s.sp_mass_idx.size() == 36 * s.nbody
+            && all_below(s.sp_mass_idx, kkt.Ai.size()) && all_below(s.sp_joint_idx, kkt.Ai.size())
+            && s.sp_joint_off.size() == s.njoint;
+        kkt.n = nkkt;
+        kkt.Pinv.assign(nkkt, nkkt);
+        for (unsigned int k = 0; ok && k < nkkt; k++) {
+            ok = kkt.Pinv[kkt.P[k]] == nkkt && (kkt.Parent[k] == -1
+                || (kkt.Parent[k] > static_cast<int>(k) && kkt.Parent[k] < static_cast<int>(nkkt)));
+            kkt.Pinv[kkt.P[k]] = k;
+        }
+        for (unsigned int i = 0; ok && i < s.njoint; i++) {
+            ok = s.sp_joint_off[i] + 24 * topo.joint_dim[i] <= s.sp_joint_idx.size();
+        }
+        if (ok) {
+            /* Workspace of factor() and solve(), sized as analyze() does */
+            kkt.Ax.assign(kkt.Ai.size(), 0.0);
+            kkt.Li.assign(kkt.Lp[nkkt], 0);
+            kkt.Lx.assign(kkt.Lp[nkkt], 0.0);
+            kkt.D.assign(nkkt, 0.0);
+            kkt.Y.assign(nkkt, 0.0);
+            kkt.Lnz.assign(nkkt, 0);
+            kkt.Flag.assign(nkkt, 0);
+            kkt.Pattern.assign(nkkt, 0);
+        }
+    }
+    if (!ok || p != end_In) {
+        std::cerr << "Checkpoint: analysis block does not match the system" << std::endl;
+        return false;
+    }
+    topo.nbody = s.nbody;
+    topo.njoint = s.njoint;
+    topo.nloop = topo_size[2];
+    topo.grounded = topo_size[3] != 0;
+    return true;
+}
+
+DynSysPtr Checkpoint::restore(const std::vector<char> &buf_In) { return restore(buf_In.data(), buf_In.size()); }
+
+DynSysPtr Checkpoint::restore(const std::string &file_In) {
+    std::vector<char> buf;
+
+    if (!Read_File(file_In, buf)) return DynSysPtr();
+    return restore(buf);
+}
+
+uint64_t Checkpoint::hash(const char *buf_In, size_t size_In) {
+    uint64_t h = 14695981039346656037ull;
+
+    for (size_t k = 0; k < size_In; k++) {
+        h ^= static_cast<unsigned char>(buf_In[k]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool Checkpoint::Read_File(const std::string &file_In, std::vector<char> &buf_Out) {
+    std::ifstream fin(file_In, std::ios::binary | std::ios::ate);
+
+    if (!fin) {
+        std::cerr << "Checkpoint: cannot open " << file_In << std::endl;
+        return false;
+    }
+    buf_Out.resize(static_cast<size_t>(fin.tellg()));
+    fin.seekg(0);
+    fin.read(buf_Out.data(), buf_Out.size());
+    if (!fin) {
+        std::cerr << "Checkpoint: cannot read " << file_In << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,506 @@
+#include "Contact.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+inline double dot3(const double *a, const double *b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+/* Closest points c1 on [p1, q1] and c2 on [p2, q2] (Ericson, Real-Time
+   Collision Detection 5.1.9); either segment may be a point */
+void closest_segments(const double *p1, const double *q1, const double *p2, const double *q2, double *c1_Out,
+        double *c2_Out) {
+    double d1[3], d2[3], r[3];
+    double a, e, f, b, cc, denom, s = 0.0, t = 0.0;
+
+    for (unsigned int k = 0; k < 3; k++) {
+        d1[k] = q1[k] - p1[k];
+        d2[k] = q2[k] - p2[k];
+        r[k] = p1[k] - p2[k];
+    }
+    a = dot3(d1, d1);
+    e = dot3(d2, d2);
+    f = dot3(d2, r);
+    if (a <= 1e-24 && e <= 1e-24) {
+        s = 0.0;
+        t = 0.0;
+    } else if (a <= 1e-24) {
+        t = std::min(std::max(f / e, 0.0), 1.0);
+    } else {
+        cc = dot3(d1, r);
+        if (e <= 1e-24) {
+            s = std::min(std::max(-cc / a, 0.0), 1.0);
+        } else {
+            b = dot3(d1, d2);
+            denom = a * e - b * b;
+            s = (denom > 1e-24) ? std::min(std::max((b * f - cc * e) / denom, 0.0), 1.0) : 0.0;
+            t = (b * s + f) / e;
+            if (t < 0.0) {
+                t = 0.0;
+                s = std::min(std::max(-cc / a, 0.0), 1.0);
+            } else if (t > 1.0) {
+                t = 1.0;
+                s = std::min(std::max((b - cc) / a, 0.0), 1.0);
+            }
+        }
+    }
+    for (unsigned int k = 0; k < 3; k++) {
+        c1_Out[k] = p1[k] + d1[k] * s;
+        c2_Out[k] = p2[k] + d2[k] * t;
+    }
+}
+
+}  // namespace
+
+Contact_Force::Contact_Force(double k_In, double c_In, double mu_In) {
+    k = k_In;
+    c = c_In;
+    mu = mu_In;
+    friction_vel = 1e-3;
+    axis = 3;  // none yet: the first sweep sorts from scratch
+    npair = 0;
+}
+
+unsigned int Contact_Force::add_sphere(BodyPtr body_In, const arma::vec &center_In, double r_In) {
+    arma::vec3 zero(arma::fill::zeros);
+
+    return add_capsule(body_In, center_In, zero, r_In);
+}
+
+unsigned int Contact_Force::add_capsule(BodyPtr body_In, const arma::vec &center_In, const arma::vec &half_axis_In,
+        double r_In) {
+    Shape s = Shape();
+
+    s.body_ptr = body_In;
+    s.body = body_In.get();
+    s.type = arma::norm(half_axis_In) > 0.0 ? SHAPE_CAPSULE : SHAPE_SPHERE;
+    for (unsigned int m = 0; m < 3; m++) {
+        s.center[m] = center_In(m);
+        s.dim[m] = half_axis_In(m);
+    }
+    s.r = r_In;
+    shape.push_back(s);
+    return shape.size() - 1;
+}
+
+unsigned int Contact_Force::add_box(BodyPtr body_In, const arma::vec &center_In, const arma::vec &half_In) {
+    Shape s = Shape();
+
+    s.body_ptr = body_In;
+    s.body = body_In.get();
+    s.type = SHAPE_BOX;
+    for (unsigned int m = 0; m < 3; m++) {
+        s.center[m] = center_In(m);
+        s.dim[m] = half_In(m);
+    }
+    s.r = 0.0;
+    shape.push_back(s);
+    return shape.size() - 1;
+}
+
+unsigned int Contact_Force::add_plane(const arma::vec &normal_In, double offset_In) {
+    double len = arma::norm(normal_In);
+
+    for (unsigned int m = 0; m < 3; m++) plane_n.push_back(normal_In(m) / len);
+    plane_d.push_back(offset_In / len);
+    return plane_d.size() - 1;
+}
+
+void Contact_Force::exclude(BodyPtr i_In, BodyPtr j_In) {
+    uint64_t a = std::min(i_In->get_num(), j_In->get_num());
+    uint64_t b = std::max(i_In->get_num(), j_In->get_num());
+    uint64_t key = (a << 32) | b;
+    std::vector<uint64_t>::iterator it = std::lower_bound(excluded.begin(), excluded.end(), key);
+
+    if (it == excluded.end() || *it != key) excluded.insert(it, key);
+}
+
+/* Neighbouring links overlap at their joint, so chains and ropes want this */
+void Contact_Force::exclude_joined(const Dynamics_Sys &sys_In) {
+    for (unsigned int i = 0; i < sys_In.get_njoint(); i++) {
+        exclude(sys_In.get_joint(i)->get_body_i_ptr(), sys_In.get_joint(i)->get_body_j_ptr());
+    }
+}
+
+/* Broad phase, narrow phase, then the loads of all contacts */
+void Contact_Force::apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) {
+    double v_i[3], v_j[3], v_t[3], F[3];
+    double vn, vt, fn, scale, low;
+
+    contact.clear();
+    update_shapes();
+    sweep();
+    for (unsigned int p = 0; p < plane_d.size(); p++) {
+        for (unsigned int s = 0; s < shape.size(); s++) {
+            if (shape[s].body->get_type() == 0) continue;
+            /* Lowest corner of the AABB along the normal */
+            low = 0.0;
+            for (unsigned int m = 0; m < 3; m++) {
+                low += plane_n[3 * p + m] * ((plane_n[3 * p + m] > 0.0) ? lo[3 * s + m] : hi[3 * s + m]);
+            }
+            if (low < plane_d[p]) collide_plane(s, p);
+        }
+    }
+
+    for (unsigned int n = 0; n < contact.size(); n++) {
+        Contact &C = contact[n];
+        Body *bi = Body_In[C.body_i].get();
+        Body *bj = (C.body_j == plane_body) ? nullptr : Body_In[C.body_j].get();
+        const arma::vec3 &V_i = bi->get_VELOCITY();
+        arma::vec3 w_i = trans(bi->get_TBI()) * bi->get_ANGLE_VEL();
+        double r[3];
+
+        for (unsigned int m = 0; m < 3; m++) r[m] = C.point[m] - bi->get_POSITION()(m);
+        v_i[0] = V_i(0) + w_i(1) * r[2] - w_i(2) * r[1];
+        v_i[1] = V_i(1) + w_i(2) * r[0] - w_i(0) * r[2];
+        v_i[2] = V_i(2) + w_i(0) * r[1] - w_i(1) * r[0];
+        v_j[0] = v_j[1] = v_j[2] = 0.0;
+        if (bj) {
+            const arma::vec3 &V_j = bj->get_VELOCITY();
+            arma::vec3 w_j = trans(bj->get_TBI()) * bj->get_ANGLE_VEL();
+            for (unsigned int m = 0; m < 3; m++) r[m] = C.point[m] - bj->get_POSITION()(m);
+            v_j[0] = V_j(0) + w_j(1) * r[2] - w_j(2) * r[1];
+            v_j[1] = V_j(1) + w_j(2) * r[0] - w_j(0) * r[2];
+            v_j[2] = V_j(2) + w_j(0) * r[1] - w_j(1) * r[0];
+        }
+
+        /* Relative velocity of j at the point; the depth grows at -n . v */
+        for (unsigned int m = 0; m < 3; m++) v_t[m] = v_j[m] - v_i[m];
+        vn = dot3(C.normal, v_t);
+        fn = k * C.depth - c * vn;
+        if (!(fn > 0.0)) {
+            C.force = 0.0;
+            continue;
+        }
+        C.force = fn;
+        for (unsigned int m = 0; m < 3; m++) v_t[m] -= vn * C.normal[m];
+        vt = std::sqrt(dot3(v_t, v_t) + friction_vel * friction_vel);
+        scale = mu * fn / vt;
+        for (unsigned int m = 0; m < 3; m++) F[m] = fn * C.normal[m] - scale * v_t[m];  // on body j
+        apply_load(bi, C.point, F, -1.0, RHS_Out);
+        if (bj) apply_load(bj, C.point, F, 1.0, RHS_Out);
+    }
+}
+
+/* sign_In F at the inertial point p_In: the force in the inertial frame,
+   the torque TBI ((p - X) x F) in the body frame. Grounds take none. */
+void Contact_Force::apply_load(Body *body_In, const double *p_In, const double *F_In, double sign_In,
+        double *RHS_Out) const {
+    const arma::mat33 &TBI = body_In->get_TBI();
+    const arma::vec3 &X = body_In->get_POSITION();
+    double r[3], m[3];
+    unsigned int b = body_In->get_num() * 6;
+
+    if (body_In->get_type() == 0) return;
+    for (unsigned int a = 0; a < 3; a++) r[a] = p_In[a] - X(a);
+    m[0] = sign_In * (r[1] * F_In[2] - r[2] * F_In[1]);
+    m[1] = sign_In * (r[2] * F_In[0] - r[0] * F_In[2]);
+    m[2] = sign_In * (r[0] * F_In[1] - r[1] * F_In[0]);
+    for (unsigned int a = 0; a < 3; a++) {
+        RHS_Out[b + a] += sign_In * F_In[a];
+        RHS_Out[b + 3 + a] += TBI(a, 0) * m[0] + TBI(a, 1) * m[1] + TBI(a, 2) * m[2];
+    }
+}
+
+/* World pose and AABB of every shape at the current stage */
+void Contact_Force::update_shapes() {
+    double e;
+
+    lo.resize(3 * shape.size());
+    hi.resize(3 * shape.size());
+    for (unsigned int s = 0; s < shape.size(); s++) {
+        Shape &S = shape[s];
+        const arma::mat33 &TBI = S.body->get_TBI();
+        const arma::vec3 &X = S.body->get_POSITION();
+
+        /* R = TIB: column m is body axis m in the inertial frame */
+        for (unsigned int m = 0; m < 3; m++) {
+            for (unsigned int r = 0; r < 3; r++) S.R[m * 3 + r] = TBI(m, r);
+        }
+        for (unsigned int r = 0; r < 3; r++) {
+            S.c[r] = X(r);
+            S.a[r] = 0.0;
+            for (unsigned int m = 0; m < 3; m++) {
+                S.c[r] += S.R[m * 3 + r] * S.center[m];
+                S.a[r] += S.R[m * 3 + r] * S.dim[m];
+            }
+            if (S.type == SHAPE_BOX) {
+                e = 0.0;
+                for (unsigned int m = 0; m < 3; m++) e += std::fabs(S.R[m * 3 + r]) * S.dim[m];
+            } else {
+                e = std::fabs(S.a[r]) + S.r;
+            }
+            lo[3 * s + r] = S.c[r] - e;
+            hi[3 * s + r] = S.c[r] + e;
+        }
+    }
+}
+
+/* Sweep and prune along the axis where the shapes spread most. The order
+   of the last stage is nearly sorted, so insertion sort repairs it in
+   about one pass; a new axis is sorted from scratch. */
+void Contact_Force::sweep() {
+    const unsigned int n = shape.size();
+    double mean[3] = {0.0, 0.0, 0.0}, var[3] = {0.0, 0.0, 0.0}, x, key;
+    unsigned int best = 0, s, t, ax, ay;
+    uint64_t pair;
+
+    npair = 0;
+    if (n < 2) return;
+    for (s = 0; s < n; s++) {
+        for (unsigned int m = 0; m < 3; m++) mean[m] += 0.5 * (lo[3 * s + m] + hi[3 * s + m]);
+    }
+    for (unsigned int m = 0; m < 3; m++) mean[m] /= n;
+    for (s = 0; s < n; s++) {
+        for (unsigned int m = 0; m < 3; m++) {
+            x = 0.5 * (lo[3 * s + m] + hi[3 * s + m]) - mean[m];
+            var[m] += x * x;
+        }
+    }
+    for (unsigned int m = 1; m < 3; m++) {
+        if (var[m] > var[best]) best = m;
+    }
+
+    /* Keep the current axis unless another spreads clearly more, so the
+       order stays warm */
+    if (axis > 2 || order.size() != n || var[best] > 2.0 * var[axis]) {
+        axis = best;
+        order.resize(n);
+        for (s = 0; s < n; s++) order[s] = s;
+        std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) {
+            return lo[3 * a + axis] < lo[3 * b + axis];
+        });
+    } else {
+        for (unsigned int i = 1; i < n; i++) {
+            t = order[i];
+            key = lo[3 * t + axis];
+            unsigned int j = i;
+            for (; j > 0 && lo[3 * order[j - 1] + axis] > key; j--) order[j] = order[j - 1];
+            order[j] = t;
+        }
+    }
+
+    /* AABBs copied in sweep order, so the inner loop reads memory in sequence */
+    ax = (axis + 1) % 3;
+    ay = (axis + 2) % 3;
+    box.resize(6 * n);
+    for (unsigned int i = 0; i < n; i++) {
+        s = order[i];
+        box[6 * i] = lo[3 * s + axis];
+        box[6 * i + 1] = hi[3 * s + axis];
+        box[6 * i + 2] = lo[3 * s + ax];
+        box[6 * i + 3] = hi[3 * s + ax];
+        box[6 * i + 4] = lo[3 * s + ay];
+        box[6 * i + 5] = hi[3 * s + ay];
+    }
+    for (unsigned int i = 0; i < n; i++) {
+        const double *bi = &box[6 * i];
+        for (unsigned int j = i + 1; j < n && box[6 * j] <= bi[1]; j++) {
+            const double *bj = &box[6 * j];
+            if (bj[2] > bi[3] || bi[2] > bj[3] || bj[4] > bi[5] || bi[4] > bj[5]) continue;
+            s = order[i];
+            t = order[j];
+            const Body *bs = shape[s].body;
+            const Body *bt = shape[t].body;
+            if (bs == bt || (bs->get_type() == 0 && bt->get_type() == 0)) continue;
+            if (!excluded.empty()) {
+                pair = (static_cast<uint64_t>(std::min(bs->get_num(), bt->get_num())) << 32)
+                    | std::max(bs->get_num(), bt->get_num());
+                if (std::binary_search(excluded.begin(), excluded.end(), pair)) continue;
+            }
+            npair++;
+            collide(s, t);
+        }
+    }
+}
+
+/* Narrow phase of a candidate pair. Spheres and capsules are a radius about
+   a segment; boxes are tested by their vertices against the other box,
+   which finds vertex-face contacts (edge-edge crossings are left out). */
+void Contact_Force::collide(unsigned int s_In, unsigned int t_In) {
+    const Shape *A = &shape[s_In];
+    const Shape *B = &shape[t_In];
+    double p0[3], p1[3], q0[3], q1[3], ca[3], cb[3], n[3], l[3], v[3];
+    double d, depth, pen;
+    unsigned int face;
+
+    if (A->type > B->type) std::swap(A, B);
+    for (unsigned int m = 0; m < 3; m++) {
+        p0[m] = A->c[m] - A->a[m];
+        p1[m] = A->c[m] + A->a[m];
+    }
+
+    if (B->type != SHAPE_BOX) {
+        for (unsigned int m = 0; m < 3; m++) {
+            q0[m] = B->c[m] - B->a[m];
+            q1[m] = B->c[m] + B->a[m];
+        }
+        closest_segments(p0, p1, q0, q1, ca, cb);
+        for (unsigned int m = 0; m < 3; m++) n[m] = cb[m] - ca[m];
+        d = std::sqrt(dot3(n, n));
+        depth = A->r + B->r - d;
+        if (!(depth > 0.0)) return;
+        if (d > 1e-12) {
+            for (unsigned int m = 0; m < 3; m++) n[m] /= d;
+        } else {
+            n[0] = 0.0;
+            n[1] = 0.0;
+            n[2] = 1.0;
+        }
+        for (unsigned int m = 0; m < 3; m++) ca[m] += n[m] * (A->r - 0.5 * depth);
+        add_contact(*A, B, 0, ca, n, depth);
+        return;
+    }
+
+    /* Segment or point against a box: the two caps, or when neither
+       touches (a capsule across an edge) the segment point found by
+       alternating the closest points */
+    if (A->type != SHAPE_BOX) {
+        if (A->type == SHAPE_CAPSULE) {
+            if (point_box(*A, p0, *B) + point_box(*A, p1, *B) > 0) return;
+        }
+        for (unsigned int m = 0; m < 3; m++) ca[m] = A->c[m];
+        for (unsigned int it = 0; it < 4 && A->type == SHAPE_CAPSULE; it++) {
+            for (unsigned int a = 0; a < 3; a++) {
+                l[a] = 0.0;
+                for (unsigned int m = 0; m < 3; m++) l[a] += B->R[a * 3 + m] * (ca[m] - B->c[m]);
+                l[a] = std::min(std::max(l[a], -B->dim[a]), B->dim[a]);
+            }
+            for (unsigned int m = 0; m < 3; m++) {
+                cb[m] = B->c[m];
+                for (unsigned int a = 0; a < 3; a++) cb[m] += B->R[a * 3 + m] * l[a];
+            }
+            closest_segments(p0, p1, cb, cb, ca, v);
+        }
+        point_box(*A, ca, *B);
+        return;
+    }
+
+    /* Box against box: the vertices of each inside the other */
+    for (unsigned int side = 0; side < 2; side++) {
+        const Shape *P = side ? B : A;  // vertices
+        const Shape *Q = side ? A : B;  // box tested against
+        for (unsigned int corner = 0; corner < 8; corner++) {
+            for (unsigned int m = 0; m < 3; m++) {
+                v[m] = P->c[m];
+                for (unsigned int a = 0; a < 3; a++) {
+                    v[m] += P->R[a * 3 + m] * (((corner >> a) & 1u) ? P->dim[a] : -P->dim[a]);
+                }
+            }
+            pen = 0.0;
+            face = 0;
+            for (unsigned int a = 0; a < 3; a++) {
+                l[a] = 0.0;
+                for (unsigned int m = 0; m < 3; m++) l[a] += Q->R[a * 3 + m] * (v[m] - Q->c[m]);
+                d = Q->dim[a] - std::fabs(l[a]);
+                if (a == 0 || d < pen) {
+                    pen = d;
+                    face = a;
+                }
+            }
+            if (!(pen > 0.0)) continue;
+            /* Outward normal of Q's face, turned to point from A to B */
+            for (unsigned int m = 0; m < 3; m++) {
+                n[m] = ((l[face] < 0.0) ? -1.0 : 1.0) * Q->R[face * 3 + m] * (side ? 1.0 : -1.0);
+            }
+            add_contact(*A, B, 0, v, n, pen);
+        }
+    }
+}
+
+/* Sphere of A's radius at p_In against box B; returns the contacts added */
+unsigned int Contact_Force::point_box(const Shape &A_In, const double *p_In, const Shape &B_In) {
+    double l[3], q[3], n[3], p[3], d, depth, pen = 0.0;
+    unsigned int face = 0;
+
+    for (unsigned int a = 0; a < 3; a++) {
+        l[a] = 0.0;
+        for (unsigned int m = 0; m < 3; m++) l[a] += B_In.R[a * 3 + m] * (p_In[m] - B_In.c[m]);
+        d = B_In.dim[a] - std::fabs(l[a]);
+        if (a == 0 || d < pen) {
+            pen = d;
+            face = a;
+        }
+    }
+    if (pen < 0.0) {
+        /* Outside: the clamped point is the closest box point */
+        for (unsigned int a = 0; a < 3; a++) l[a] = std::min(std::max(l[a], -B_In.dim[a]), B_In.dim[a]);
+        for (unsigned int m = 0; m < 3; m++) {
+            q[m] = B_In.c[m];
+            for (unsigned int a = 0; a < 3; a++) q[m] += B_In.R[a * 3 + m] * l[a];
+            n[m] = q[m] - p_In[m];
+        }
+        d = std::sqrt(dot3(n, n));
+        depth = A_In.r - d;
+        if (!(depth > 0.0) || d <= 1e-12) return 0;
+        for (unsigned int m = 0; m < 3; m++) {
+            n[m] /= d;
+            p[m] = p_In[m] + n[m] * (A_In.r - 0.5 * depth);
+        }
+    } else {
+        /* Inside: out through the nearest face */
+        for (unsigned int m = 0; m < 3; m++) {
+            n[m] = -((l[face] < 0.0) ? -1.0 : 1.0) * B_In.R[face * 3 + m];
+            p[m] = p_In[m];
+        }
+        depth = A_In.r + pen;
+    }
+    add_contact(A_In, &B_In, 0, p, n, depth);
+    return 1;
+}
+
+/* Shape against a half-space: the sphere, both capsule caps or the box
+   vertices below the plane. The normal points from the shape into the plane. */
+void Contact_Force::collide_plane(unsigned int s_In, unsigned int p_In) {
+    const Shape &S = shape[s_In];
+    const double *np = &plane_n[3 * p_In];
+    double n[3], v[3], depth;
+    unsigned int nv = (S.type == SHAPE_BOX) ? 8 : (S.type == SHAPE_CAPSULE) ? 2 : 1;
+
+    for (unsigned int m = 0; m < 3; m++) n[m] = -np[m];
+    for (unsigned int corner = 0; corner < nv; corner++) {
+        for (unsigned int m = 0; m < 3; m++) {
+            if (S.type == SHAPE_BOX) {
+                v[m] = S.c[m];
+                for (unsigned int a = 0; a < 3; a++) {
+                    v[m] += S.R[a * 3 + m] * (((corner >> a) & 1u) ? S.dim[a] : -S.dim[a]);
+                }
+            } else {
+                v[m] = S.c[m] + (corner ? S.a[m] : -S.a[m]);
+            }
+        }
+        depth = plane_d[p_In] + S.r - dot3(np, v);
+        if (!(depth > 0.0)) continue;
+        for (unsigned int m = 0; m < 3; m++) v[m] += n[m] * (S.r - 0.5 * depth);
+        add_contact(S, nullptr, p_In, v, n, depth);
+    }
+}
+
+void Contact_Force::add_contact(const Shape &A_In, const Shape *B_In, unsigned int plane_In, const double *p_In,
+        const double *n_In, double depth_In) {
+    Contact C;
+
+    C.body_i = A_In.body->get_num();
+    C.body_j = B_In ? B_In->body->get_num() : plane_body;
+    C.plane = B_In ? 0 : plane_In;
+    for (unsigned int m = 0; m < 3; m++) {
+        C.point[m] = p_In[m];
+        C.normal[m] = n_In[m];
+    }
+    C.depth = depth_In;
+    C.force = 0.0;
+    contact.push_back(C);
+}
+
+void Contact_Force::set_stiffness(double k_In) { k = k_In; }
+void Contact_Force::set_damping(double c_In) { c = c_In; }
+
+/* Below vel_In of sliding the friction force grows linearly from 0 */
+void Contact_Force::set_friction(double mu_In, double vel_In) {
+    mu = mu_In;
+    friction_vel = vel_In;
+}
+
+unsigned int Contact_Force::get_nshape() const { return shape.size(); }
+unsigned long Contact_Force::get_npair() const { return npair; }
+const std::vector<Contact> &Contact_Force::get_contacts() const { return contact; }
@@ -1,201 +1,1348 @@
 #include "Dynamics_System.hpp"
+#include "Alloc_Counter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <typeinfo>
 
 Dynamics_Sys::Dynamics_Sys(double dt_In) {
+    arena = boost::make_shared<Object_Arena>();
     nbody = 0;
     njoint = 0;
+    ncons = 0;
     dt = dt_In;
+    t_int = 0.0;
+    t_sample = 0.0;
+    solver = DENSE_SOLVER;
+    integrator = RK4_INTEGRATOR;
+    t_old = 0.0;
+    h = dt_In;
+    h_max = 0.0;
+    rtol = 1e-6;
+    atol = 1e-8;
+    fsal_valid = false;
+    n_feval = 0;
+    n_reject = 0;
+    step_failed = false;
+    newton_max_iter = 7;
+    newton_max_split = 4;
+    n_newton = 0;
+    alloc_check = false;
+    step_allocs = 0;
+    cond_pending = false;
+    par_min_bodies = 512;
+    baum_alpha = 1.0;
+    baum_beta = 1.0;
+    proj_position = false;
+    proj_velocity = false;
+    proj_tol = 1e-10;
+    proj_max_iter = 3;
+    reuse_factor = false;
+    skip_projection = false;
+    factor_valid = false;
+    kkt_valid = false;
+    iter_tol = 1e-10;
+    iter_max_iter = 0;
+    n_iter = 0;
+    n_cg_fail = 0;
 }
 
-void Dynamics_Sys::Add(BodyPtr bodyPtr_In) {
+unsigned int Dynamics_Sys::Add(BodyPtr bodyPtr_In) {
     Body_ptr_array.push_back(bodyPtr_In);
-    nbody++;
+    return nbody++;
 }
 
-void Dynamics_Sys::Add(JointPtr jointPtr_In) {
+unsigned int Dynamics_Sys::Add(JointPtr jointPtr_In) {
     Joint_ptr_array.push_back(jointPtr_In);
-    njoint++;
+    return njoint++;
 }
 
+JointPtr Dynamics_Sys::Create_Joint(Joint_Type Type_In, const arma::vec &piIn, const arma::vec &pjIn,
+        const arma::vec &qiIn, const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) {
+    JointPtr joint = allocate_joint(Arena_Allocator<Joint>(arena), Type_In, piIn, pjIn, qiIn, qjIn, i_In, j_In);
+
+    Add(joint);
+    return joint;
+}
+
+/* Force elements may be added at any time, also after init() */
+void Dynamics_Sys::Add(ForcePtr forcePtr_In) { Force_ptr_array.push_back(forcePtr_In); }
+
 void Dynamics_Sys::Cal_Constraints() {
-    unsigned int i_num, j_num;
-    arma::mat tmp_Cq(3, nbody * 6, arma::fill::zeros);
-    arma::mat tmp_Cqi, tmp_Cqj;
+    /* SYS_MAT and SYS_RHS are sized in init(); every block is written in place:
+       bodies own columns 6 * num, constraint rows start at row 6 * nbody.
+       Joints write disjoint rows, so the per-joint loops may run on the pool. */
+    unsigned int cons_off = 6 * nbody;
+    const double stab_d = 2.0 * baum_alpha;
+    const double stab_p = baum_beta * baum_beta;
 
-    SYS_Cq.eye(6, 6);
-    SYS_GAMMA = arma::zeros<arma::vec>(6, 1);
-    SYS_M.eye(6, 6);
-    SYS_C.zeros(0, 0);
+    /* Every ground is fixed where it was built through 6 identity rows */
+    for (unsigned int g = 0; g < ground_row.size(); g++) {
+        SYS_C.subvec(ground_row[g], ground_row[g] + 5).zeros();
+        SYS_GAMMA.subvec(ground_row[g], ground_row[g] + 5).zeros();
+    }
 
-    SYS_C = arma::join_cols(Body_ptr_array[0]->get_POSITION(), Body_ptr_array[0]->get_ANGLE());
-    SYS_Cq = arma::join_rows(SYS_Cq, arma::zeros<arma::mat>(6, 6 * (nbody - 1)));
+    Parallel_For(njoint, [&](unsigned int begin, unsigned int end) {
+        unsigned int row, n_rows;
+        arma::vec6 tmp_vi, tmp_vj;
 
-    for (unsigned int i = 0; i < njoint; i++) {
-        tmp_Cq.zeros(); // Reset tmp_Cq to zeros
-        i_num = Joint_ptr_array[i]->get_body_i_ptr()->get_num();
-        j_num = Joint_ptr_array[i]->get_body_j_ptr()->get_num();
-        tmp_Cqi = Joint_ptr_array[i]->get_Cqi();
-        tmp_Cqj = Joint_ptr_array[i]->get_Cqj();
-        for (unsigned int ii = 0; ii < tmp_Cq.n_rows; ++ii) {
-            for (unsigned int jj = 0; jj < tmp_Cqi.n_cols; ++jj) {
-                tmp_Cq(ii, i_num * 6 + jj) = tmp_Cqi(ii, jj);
-                tmp_Cq(ii, j_num * 6 + jj) = tmp_Cqj(ii, jj);
+        for (unsigned int i = begin; i < end; i++) {
+            const arma::mat &tmp_Cqi = Joint_array[i]->get_Cqi();
+            const arma::mat &tmp_Cqj = Joint_array[i]->get_Cqj();
+            n_rows = tmp_Cqi.n_rows;
+            row = joint_row[i];
+
+            tmp_vi.subvec(0, 2) = Body_array[joint_body_i[i]]->get_VELOCITY();
+            tmp_vi.subvec(3, 5) = Body_array[joint_body_i[i]]->get_ANGLE_VEL();
+            tmp_vj.subvec(0, 2) = Body_array[joint_body_j[i]]->get_VELOCITY();
+            tmp_vj.subvec(3, 5) = Body_array[joint_body_j[i]]->get_ANGLE_VEL();
+
+            SYS_C.subvec(row, row + n_rows - 1) = Joint_array[i]->get_CONSTRAINT();
+            SYS_GAMMA.subvec(row, row + n_rows - 1) = Joint_array[i]->get_GAMMA()
+                - stab_d * (tmp_Cqi * tmp_vi + tmp_Cqj * tmp_vj) - stab_p * SYS_C.subvec(row, row + n_rows - 1);
+        }
+    });
+
+    for (unsigned int i = 0; i < nbody; i++) {
+        SYS_RHS.subvec(i * 6, i * 6 + 2) = Body_array[i]->get_FORCE();
+        SYS_RHS.subvec(i * 6 + 3, i * 6 + 5) = Body_array[i]->get_TORQUE();
+    }
+    SYS_RHS.subvec(cons_off, cons_off + ncons - 1) = SYS_GAMMA;
+
+    if (solver == SPARSE_SOLVER) {
+        Assemble_Sparse();
+    } else if (solver == DENSE_SOLVER) {
+        Assemble_Dense();
+    }
+}
+
+/* Per stage only the Jacobian columns from joint_col0 on change (the
+   rotational ones for most joint types): the ground rows, the mass blocks and
+   the constant translational columns are written once by Assemble_Constant() */
+void Dynamics_Sys::Assemble_Dense() {
+    Parallel_For(njoint, [this](unsigned int begin, unsigned int end) {
+        unsigned int i_col, j_col, row, n_rows;
+        unsigned int cons_off = 6 * nbody;
+
+        for (unsigned int i = begin; i < end; i++) {
+            i_col = joint_body_i[i] * 6;
+            j_col = joint_body_j[i] * 6;
+            const arma::mat &tmp_Cqi = Joint_array[i]->get_Cqi();
+            const arma::mat &tmp_Cqj = Joint_array[i]->get_Cqj();
+            n_rows = tmp_Cqi.n_rows;
+            row = cons_off + joint_row[i];
+
+            for (unsigned int c = joint_col0[i]; c < 6; c++) {
+                for (unsigned int r = 0; r < n_rows; r++) {
+                    SYS_MAT(row + r, i_col + c) = tmp_Cqi(r, c);
+                    SYS_MAT(row + r, j_col + c) = tmp_Cqj(r, c);
+                    SYS_MAT(i_col + c, row + r) = tmp_Cqi(r, c);
+                    SYS_MAT(j_col + c, row + r) = tmp_Cqj(r, c);
+                }
+            }
+        }
+    });
+}
+
+void Dynamics_Sys::Assemble_Sparse() {
+    Parallel_For(njoint, [this](unsigned int begin, unsigned int end) {
+        unsigned int n_rows, idx;
+        std::vector<double> &Ax = SP_KKT.values();
+
+        for (unsigned int i = begin; i < end; i++) {
+            const arma::mat &tmp_Cqi = Joint_array[i]->get_Cqi();
+            const arma::mat &tmp_Cqj = Joint_array[i]->get_Cqj();
+            n_rows = tmp_Cqi.n_rows;
+            idx = sp_joint_off[i] + 4 * joint_col0[i] * n_rows;
+
+            for (unsigned int c = joint_col0[i]; c < 6; c++) {
+                for (unsigned int r = 0; r < n_rows; r++) {
+                    Ax[sp_joint_idx[idx]] = tmp_Cqi(r, c);
+                    Ax[sp_joint_idx[idx + 1]] = tmp_Cqj(r, c);
+                    Ax[sp_joint_idx[idx + 2]] = tmp_Cqi(r, c);
+                    Ax[sp_joint_idx[idx + 3]] = tmp_Cqj(r, c);
+                    idx += 4;
+                }
+            }
+        }
+    });
+}
+
+/* State-independent KKT entries, written once after the solver storage is set
+   up: the ground identity blocks, the constant masses and the Jacobian
+   columns before joint_col0. Assemble_Dense/Sparse() leave them untouched. */
+void Dynamics_Sys::Assemble_Constant() {
+    unsigned int i_col, j_col, row, n_rows, idx;
+    unsigned int cons_off = 6 * nbody;
+    const std::vector<unsigned int> &ground = TOPO.get_ground();
+
+    if (solver == DENSE_SOLVER) {
+        for (unsigned int g = 0; g < ground.size(); g++) {
+            i_col = ground[g] * 6;
+            row = cons_off + ground_row[g];
+            SYS_MAT.submat(i_col, i_col, i_col + 5, i_col + 5).eye();
+            SYS_MAT.submat(row, i_col, row + 5, i_col + 5).eye();
+            SYS_MAT.submat(i_col, row, i_col + 5, row + 5).eye();
+        }
+
+        for (unsigned int i = 0; i < njoint; i++) {
+            i_col = Joint_ptr_array[i]->get_body_i_ptr()->get_num() * 6;
+            j_col = Joint_ptr_array[i]->get_body_j_ptr()->get_num() * 6;
+            const arma::mat &tmp_Cqi = Joint_ptr_array[i]->get_Cqi();
+            const arma::mat &tmp_Cqj = Joint_ptr_array[i]->get_Cqj();
+            n_rows = tmp_Cqi.n_rows;
+            row = cons_off + joint_row[i];
+
+            for (unsigned int c = 0; c < joint_col0[i]; c++) {
+                for (unsigned int r = 0; r < n_rows; r++) {
+                    SYS_MAT(row + r, i_col + c) = tmp_Cqi(r, c);
+                    SYS_MAT(row + r, j_col + c) = tmp_Cqj(r, c);
+                    SYS_MAT(i_col + c, row + r) = tmp_Cqi(r, c);
+                    SYS_MAT(j_col + c, row + r) = tmp_Cqj(r, c);
+                }
+            }
+        }
+
+        for (unsigned int i = 0; i < nbody; i++) {
+            if (Body_array[i]->get_type() == 0) continue;
+            SYS_MAT.submat(i * 6, i * 6, i * 6 + 5, i * 6 + 5) = Body_ptr_array[i]->get_M();
+        }
+    } else if (solver == SPARSE_SOLVER) {
+        std::vector<double> &Ax = SP_KKT.values();
+
+        for (unsigned int g = 0; g < ground.size(); g++) {
+            i_col = ground[g] * 6;
+            row = cons_off + ground_row[g];
+            for (unsigned int k = 0; k < 6; k++) {
+                Ax[sp_mass_idx[ground[g] * 36 + 7 * k]] = 1.0;
+                Ax[SP_KKT.index(row + k, i_col + k)] = 1.0;
+                Ax[SP_KKT.index(i_col + k, row + k)] = 1.0;
             }
         }
 
-        SYS_Cq = arma::join_cols(SYS_Cq, tmp_Cq);
-        // SYS_Cq = arma::join_cols(arma::join_rows(SYS_Cq, arma::zeros<arma::mat>(6 + i * 3, 6)),
-        //     arma::join_rows(arma::zeros<arma::mat>(3, 6 * i), Joint_ptr_array[i]->get_Cq()));
+        for (unsigned int i = 0; i < njoint; i++) {
+            const arma::mat &tmp_Cqi = Joint_ptr_array[i]->get_Cqi();
+            const arma::mat &tmp_Cqj = Joint_ptr_array[i]->get_Cqj();
+            n_rows = tmp_Cqi.n_rows;
+            idx = sp_joint_off[i];
+
+            for (unsigned int c = 0; c < joint_col0[i]; c++) {
+                for (unsigned int r = 0; r < n_rows; r++) {
+                    Ax[sp_joint_idx[idx]] = tmp_Cqi(r, c);
+                    Ax[sp_joint_idx[idx + 1]] = tmp_Cqj(r, c);
+                    Ax[sp_joint_idx[idx + 2]] = tmp_Cqi(r, c);
+                    Ax[sp_joint_idx[idx + 3]] = tmp_Cqj(r, c);
+                    idx += 4;
+                }
+            }
+        }
+
+        for (unsigned int i = 0; i < nbody; i++) {
+            if (Body_array[i]->get_type() == 0) continue;
+            const arma::mat &tmp_M = Body_ptr_array[i]->get_M();
+            for (unsigned int k = 0; k < 36; k++) {
+                Ax[sp_mass_idx[i * 36 + k]] = tmp_M(k);
+            }
+        }
+    }
+}
+
+/* Build the KKT sparsity pattern from the joint topology and run the symbolic
+   factorization. The pattern is fixed once the system is assembled. */
+void Dynamics_Sys::Setup_Solver() {
+    unsigned int i_col, j_col, row, n_rows;
+    unsigned int cons_off = 6 * nbody;
+    const std::vector<unsigned int> &ground = TOPO.get_ground();
+    std::vector<unsigned int> rows, cols, order;
+
+    factor_valid = false;
+    if (solver == TREE_SOLVER && !TREE.build(Body_ptr_array, Joint_ptr_array, joint_row, ground, ground_row)) {
+        std::cerr << "Dynamics_Sys: topology is not a tree with one ground per tree, using the dense solver"
+                  << std::endl;
+        solver = DENSE_SOLVER;
+    }
+    if (solver == DENSE_SOLVER) {
+        SYS_MAT.zeros(cons_off + ncons, cons_off + ncons);
+        SYS_LU.zeros(cons_off + ncons, cons_off + ncons);
+        SYS_PIV.assign(cons_off + ncons, 0);
+        Assemble_Constant();
+        return;
+    }
+    SYS_MAT.reset();
+    SYS_LU.reset();
+    if (solver == SCHUR_SOLVER || solver == ITERATIVE_SOLVER) {
+        SCHUR.build(Body_ptr_array, Joint_ptr_array, joint_row, ground, ground_row, ncons);
+        SCHUR.set_iterative(solver == ITERATIVE_SOLVER, iter_tol, iter_max_iter);
+    }
+    if (solver != SPARSE_SOLVER) return;
+
+    for (unsigned int i = 0; i < nbody; i++) {
+        for (unsigned int c = 0; c < 6; c++) {
+            for (unsigned int r = 0; r < 6; r++) {
+                rows.push_back(i * 6 + r);
+                cols.push_back(i * 6 + c);
+            }
+        }
+    }
+    for (unsigned int g = 0; g < ground.size(); g++) {
+        for (unsigned int k = 0; k < 6; k++) {
+            rows.push_back(cons_off + ground_row[g] + k);
+            cols.push_back(ground[g] * 6 + k);
+            rows.push_back(ground[g] * 6 + k);
+            cols.push_back(cons_off + ground_row[g] + k);
+        }
+    }
+    for (unsigned int i = 0; i < njoint; i++) {
+        i_col = Joint_ptr_array[i]->get_body_i_ptr()->get_num() * 6;
+        j_col = Joint_ptr_array[i]->get_body_j_ptr()->get_num() * 6;
+        n_rows = Joint_ptr_array[i]->get_Cqi().n_rows;
+        row = cons_off + joint_row[i];
+        for (unsigned int c = 0; c < 6; c++) {
+            for (unsigned int r = 0; r < n_rows; r++) {
+                rows.push_back(row + r);
+                cols.push_back(i_col + c);
+                rows.push_back(row + r);
+                cols.push_back(j_col + c);
+                rows.push_back(i_col + c);
+                cols.push_back(row + r);
+                rows.push_back(j_col + c);
+                cols.push_back(row + r);
+            }
+        }
+    }
 
-        SYS_GAMMA = arma::join_cols(SYS_GAMMA, Joint_ptr_array[i]->get_GAMMA());
+    SP_KKT.set_pattern(cons_off + ncons, rows, cols);
+    TOPO.kkt_order(ground_row, joint_row, order);
+    SP_KKT.set_order(order);
+    SP_KKT.analyze();
 
-        SYS_C = arma::join_cols(SYS_C, Joint_ptr_array[i]->get_CONSTRAINT());
+    sp_mass_idx.clear();
+    for (unsigned int i = 0; i < nbody; i++) {
+        for (unsigned int c = 0; c < 6; c++) {
+            for (unsigned int r = 0; r < 6; r++) {
+                sp_mass_idx.push_back(SP_KKT.index(i * 6 + r, i * 6 + c));
+            }
+        }
+    }
+    sp_joint_idx.clear();
+    sp_joint_off.clear();
+    for (unsigned int i = 0; i < njoint; i++) {
+        sp_joint_off.push_back(sp_joint_idx.size());
+        i_col = Joint_ptr_array[i]->get_body_i_ptr()->get_num() * 6;
+        j_col = Joint_ptr_array[i]->get_body_j_ptr()->get_num() * 6;
+        n_rows = Joint_ptr_array[i]->get_Cqi().n_rows;
+        row = cons_off + joint_row[i];
+        for (unsigned int c = 0; c < 6; c++) {
+            for (unsigned int r = 0; r < n_rows; r++) {
+                sp_joint_idx.push_back(SP_KKT.index(row + r, i_col + c));
+                sp_joint_idx.push_back(SP_KKT.index(row + r, j_col + c));
+                sp_joint_idx.push_back(SP_KKT.index(i_col + c, row + r));
+                sp_joint_idx.push_back(SP_KKT.index(j_col + c, row + r));
+            }
+        }
     }
+    Assemble_Constant();
+}
 
-    for (unsigned int i = 1; i < nbody; i++) {
-        SYS_M = arma::join_cols(arma::join_rows(SYS_M, arma::zeros<arma::mat>(6 * i, 6)), 
-            arma::join_rows(arma::zeros<arma::mat>(6, 6 * i), Body_ptr_array[i]->get_M()));
+void Dynamics_Sys::Solve_System() {
+    MBD_PROF_BEGIN(prof, PROF_LINEAR_SOLVE);
+    if (reuse_factor && factor_valid) {
+        Solve_Frozen();
+        kkt_valid = true;
+    } else if (solver == SPARSE_SOLVER) {
+        factor_valid = SP_KKT.factor();
+        if (!factor_valid) {
+            std::cerr << "Dynamics_Sys: singular KKT matrix in sparse factorization" << std::endl;
+        }
+        SYS_ANS = SYS_RHS;
+        SP_KKT.solve(SYS_ANS);
+        kkt_valid = factor_valid;
+    } else if (solver == TREE_SOLVER) {
+        TREE.factor();
+        TREE.solve(SYS_RHS, SYS_ANS);
+        kkt_valid = true;
+    } else if (solver == SCHUR_SOLVER) {
+        kkt_valid = SCHUR.factor();
+        if (!kkt_valid) {
+            std::cerr << "Dynamics_Sys: Cq M^-1 Cq^T is not positive definite, redundant constraints?" << std::endl;
+        }
+        SCHUR.solve(SYS_RHS, SYS_ANS);
+    } else if (solver == ITERATIVE_SOLVER) {
+        /* The multipliers left in SYS_ANS by the previous stage are the start */
+        kkt_valid = SCHUR.factor();
+        if (!kkt_valid) {
+            std::cerr << "Dynamics_Sys: singular constraint block in the CG preconditioner" << std::endl;
+        }
+        SCHUR.solve(SYS_RHS, SYS_ANS);
+        Count_Iterations();
+    } else {
+        /* LAPACK directly on preallocated storage: arma::solve() allocates every call */
+        arma::blas_int n = SYS_MAT.n_rows;
+        arma::blas_int nrhs = 1;
+        arma::blas_int info = 0;
+
+        SYS_LU = SYS_MAT;
+        SYS_ANS = SYS_RHS;
+        arma::lapack::gesv(&n, &nrhs, SYS_LU.memptr(), &n, SYS_PIV.data(), SYS_ANS.memptr(), &n, &info);
+        if (info != 0) {
+            std::cerr << "Dynamics_Sys: singular KKT matrix in dense solve" << std::endl;
+        }
+        factor_valid = (info == 0);
+        kkt_valid = factor_valid;
+    }
+    MBD_PROF_END(prof, PROF_LINEAR_SOLVE);
+#ifdef MBD_PROFILE
+    if (cond_pending) {
+        cond_pending = false;
+        Estimate_Cond();
     }
+#endif
+}
 
-    arma::vec tmp_vec;
+/* Solve with the dense or sparse factors of an earlier stage and one
+   refinement sweep against the current matrix, x += A_old^-1 (b - A x).
+   The tree, Schur and iterative solvers factor in time linear in the body
+   count and always refactor. */
+void Dynamics_Sys::Solve_Frozen() {
+    SYS_ANS = SYS_RHS;
+    if (solver == SPARSE_SOLVER) {
+        SP_KKT.solve(SYS_ANS);
+        SP_KKT.multiply(SYS_ANS, SYS_RES);
+        SYS_RES = SYS_RHS - SYS_RES;
+        SP_KKT.solve(SYS_RES);
+    } else {
+        char trans = 'N';
+        arma::blas_int n = SYS_MAT.n_rows;
+        arma::blas_int nrhs = 1;
+        arma::blas_int info = 0;
+        const double *A = SYS_MAT.memptr();
+        double *r = SYS_RES.memptr();
 
-    for (auto it_body = Body_ptr_array.begin(); it_body != Body_ptr_array.end(); it_body++) {
-        
-        tmp_vec = arma::join_cols(tmp_vec, arma::join_cols((*it_body)->get_FORCE(), (*it_body)->get_TORQUE()));
+        arma::lapack::getrs(&trans, &n, &nrhs, SYS_LU.memptr(), &n, SYS_PIV.data(), SYS_ANS.memptr(), &n, &info);
+        for (arma::blas_int i = 0; i < n; i++) r[i] = SYS_RHS(i);
+        for (arma::blas_int c = 0; c < n; c++) {
+            for (arma::blas_int i = 0; i < n; i++) r[i] -= A[c * n + i] * SYS_ANS(c);
+        }
+        arma::lapack::getrs(&trans, &n, &nrhs, SYS_LU.memptr(), &n, SYS_PIV.data(), r, &n, &info);
     }
+    SYS_ANS += SYS_RES;
+}
+
+/* ANS_Out = K^-1 RHS_In with the factors the last Solve_System() used */
+void Dynamics_Sys::Solve_Factored(const arma::vec &RHS_In, arma::vec &ANS_Out) {
+    MBD_PROF_BEGIN(prof, PROF_LINEAR_SOLVE);
+    if (solver == SPARSE_SOLVER) {
+        ANS_Out = RHS_In;
+        SP_KKT.solve(ANS_Out);
+    } else if (solver == TREE_SOLVER) {
+        TREE.solve(RHS_In, ANS_Out);
+    } else if (solver == SCHUR_SOLVER || solver == ITERATIVE_SOLVER) {
+        SCHUR.solve(RHS_In, ANS_Out);
+        if (solver == ITERATIVE_SOLVER) Count_Iterations();
+    } else {
+        char trans = 'N';
+        arma::blas_int n = SYS_LU.n_rows;
+        arma::blas_int nrhs = 1;
+        arma::blas_int info = 0;
 
-    arma::vec tmp_vec2;
-    tmp_vec2.zeros(0, 0);
-    for (auto it = Body_ptr_array.begin(); it != Body_ptr_array.end(); ++it) {
-        tmp_vec2 = arma::join_cols(tmp_vec2, (*it)->get_VELOCITY());
-        tmp_vec2 = arma::join_cols(tmp_vec2, (*it)->get_ANGLE_VEL());
+        ANS_Out = RHS_In;
+        arma::lapack::getrs(&trans, &n, &nrhs, SYS_LU.memptr(), &n, SYS_PIV.data(), ANS_Out.memptr(), &n, &info);
     }
+    MBD_PROF_END(prof, PROF_LINEAR_SOLVE);
+}
+
+/* Statistics of the last CG solve; a solve stopped by max_iter above the
+   tolerance is counted, not reported, since it may happen every stage */
+void Dynamics_Sys::Count_Iterations() {
+    const bool converged = SCHUR.get_residual() <= iter_tol;
 
-    SYS_GAMMA = SYS_GAMMA - 2.0 * SYS_Cq * tmp_vec2 - SYS_C;
+    n_iter += SCHUR.get_iterations();
+    if (!converged) n_cg_fail++;
+#ifdef MBD_PROFILE
+    prof.add_iterations(SCHUR.get_iterations(), SCHUR.get_residual(), converged);
+#endif
+}
 
-    SYS_RHS = arma::join_cols(tmp_vec, SYS_GAMMA);
+/* 1-norm condition estimate of the factored KKT matrix: LAPACK gecon on the
+   dense LU, the pivot ratio max|D| / min|D| of the sparse LDL^T and the
+   squared diagonal ratio of the Schur complement Cholesky. The tree and
+   iterative solvers keep no global factor, so they report 0. */
+void Dynamics_Sys::Estimate_Cond() {
+    if (solver == SPARSE_SOLVER) {
+        prof.set_cond(SP_KKT.pivot_ratio());
+    } else if (solver == SCHUR_SOLVER) {
+        prof.set_cond(SCHUR.pivot_ratio());
+    } else if (solver == DENSE_SOLVER) {
+        arma::blas_int n = SYS_MAT.n_rows;
+        arma::blas_int info = 0;
+        char norm_id = '1';
+        double anorm = 0.0, col, rcond = 0.0;
 
-    SYS_MAT = arma::join_cols(arma::join_rows(SYS_M, trans(SYS_Cq)), 
-        arma::join_rows(SYS_Cq, arma::zeros<arma::mat>(SYS_Cq.n_rows, SYS_Cq.n_rows))); 
+        for (unsigned int c = 0; c < SYS_MAT.n_cols; c++) {
+            col = 0.0;
+            for (unsigned int r = 0; r < SYS_MAT.n_rows; r++) col += std::fabs(SYS_MAT(r, c));
+            anorm = std::max(anorm, col);
+        }
+        cond_work.resize(4 * n);
+        cond_iwork.resize(n);
+        arma::lapack::gecon(&norm_id, &n, SYS_LU.memptr(), &n, &anorm, &rcond, cond_work.data(),
+            cond_iwork.data(), &info);
+        prof.set_cond((info == 0 && rcond > 0.0) ? 1.0 / rcond : 0.0);
+    } else {
+        prof.set_cond(0.0);
+    }
+}
+
+void Dynamics_Sys::set_solver(Solver_Type Type_In) {
+    solver = Type_In;
+    if (SYS_RHS.n_elem > 0) {
+        Setup_Solver();
+        Cal_Constraints();
+    }
 }
 
-void Dynamics_Sys::Assembly() { //Need to be done, Initialization sequence!!!
+/* Places the bodies from the grounds outwards along the spanning forest of
+   the joints, whatever order they were added in: a body's pose and velocity
+   given to its constructor are taken relative to the body it is reached
+   from. Loop-closing joints are not solved for; they start with whatever
+   error the tree placement leaves, which set_projection() removes. */
+void Dynamics_Sys::Assembly() {
     BodyPtr i_ptr, j_ptr;
     arma::mat TIB_i(3, 3, arma::fill::zeros);
     arma::mat TIB_j(3, 3, arma::fill::zeros);
+    arma::vec3 p_i, p_j;
 
-    for (unsigned int i = 0; i < njoint; ++i) {
-        i_ptr = Joint_ptr_array[i]->get_body_i_ptr();
-        j_ptr = Joint_ptr_array[i]->get_body_j_ptr();
+    TOPO.build(Body_ptr_array, Joint_ptr_array);
+    for (unsigned int k = 0; k < TOPO.get_tree_joint().size(); ++k) {
+        const JointPtr &joint = Joint_ptr_array[TOPO.get_tree_joint()[k]];
+
+        /* j is the body being placed, i the placed one */
+        if (joint->get_body_j_ptr()->get_num() == TOPO.get_tree_body()[k]) {
+            i_ptr = joint->get_body_i_ptr();
+            j_ptr = joint->get_body_j_ptr();
+            p_i = joint->get_pi();
+            p_j = joint->get_pj();
+        } else {
+            i_ptr = joint->get_body_j_ptr();
+            j_ptr = joint->get_body_i_ptr();
+            p_i = joint->get_pj();
+            p_j = joint->get_pi();
+        }
         j_ptr->set_TBI(j_ptr->get_TBI() * i_ptr->get_TBI());
 
         TIB_i = trans(i_ptr->get_TBI());
         TIB_j = trans(j_ptr->get_TBI());
 
-        j_ptr->set_POSITION(i_ptr->get_POSITION() + TIB_i * Joint_ptr_array[i]->get_pi()
-            - TIB_j * Joint_ptr_array[i]->get_pj());
+        j_ptr->set_POSITION(i_ptr->get_POSITION() + TIB_i * p_i - TIB_j * p_j);
         j_ptr->set_ANGLE_VEL(trans(j_ptr->get_TBI() * TIB_i) * i_ptr->get_ANGLE_VEL() + j_ptr->get_ANGLE_VEL());
         j_ptr->set_VELOCITY(TIB_j * j_ptr->get_VELOCITY() + i_ptr->get_VELOCITY() - TIB_j * (skew_sym(j_ptr->get_ANGLE_VEL())
-                    * Joint_ptr_array[i]->get_pj()) + TIB_i * (skew_sym(i_ptr->get_ANGLE_VEL())
-                    * Joint_ptr_array[i]->get_pi())); // V_j_I = TIB_j * V_j_B + V_i_I - TIB_j * w_j_B X p_j + TIB_i * w_i_B X p_i
+                    * p_j) + TIB_i * (skew_sym(i_ptr->get_ANGLE_VEL())
+                    * p_i)); // V_j_I = TIB_j * V_j_B + V_i_I - TIB_j * w_j_B X p_j + TIB_i * w_i_B X p_i
     }
 }
 
 void Dynamics_Sys::init() {
-    for (auto it = Body_ptr_array.begin(); it != Body_ptr_array.end(); it++) {
-        q.push_back((*it)->get_POSITION());
-        q.push_back((*it)->get_VELOCITY());
-        q.push_back((*it)->get_TBI_Q());
-        q.push_back((*it)->get_ANGLE_VEL());
+    Init_State();
+    Init_Handles();
+
+    /* Constraint rows follow the body order of the topology graph */
+    TOPO.build(Body_ptr_array, Joint_ptr_array);
+    ncons = TOPO.constraint_rows(ground_row, joint_row);
+    Init_Joints();
+    Init_Buffers();
+
+    Setup_Solver();
 
-        q_d.push_back((*it)->get_VELOCITY());
-        q_d.push_back((*it)->get_ACCELERATION());
-        q_d.push_back((*it)->get_TBID_Q());
-        q_d.push_back((*it)->get_ANGLE_ACC());
-    }
     Cal_Constraints();
 }
 
-void Dynamics_Sys::solve() {
-    std::vector<arma::vec> q_temp;
-    std::vector<arma::vec> k1(q.size());
-    std::vector<arma::vec> k2(q.size());
-    std::vector<arma::vec> k3(q.size());
-    std::vector<arma::vec> k4(q.size());
-    
-    q_temp = q;
+/* init() for ensemble members: the row offsets and the sparse symbolic
+   factorization are copied from an initialized system with the same topology,
+   and the template's solver is used. Falls back to init() on a mismatch. */
+void Dynamics_Sys::init(const Dynamics_Sys &Template_In) {
+    if (Template_In.SYS_RHS.n_elem == 0 || !Same_Topology(Template_In)) {
+        std::cerr << "Dynamics_Sys: template topology differs, running full init()" << std::endl;
+        init();
+        return;
+    }
+    Init_State();
+    Init_Handles();
 
-    dynamic_function(q_temp, k1);
-    for (unsigned int i = 0; i < q_temp.size(); i++) {
-        q_temp[i] = q[i] + 0.5 * dt * k1[i];        
+    TOPO = Template_In.TOPO;
+    ncons = Template_In.ncons;
+    ground_row = Template_In.ground_row;
+    joint_row = Template_In.joint_row;
+    solver = Template_In.solver;
+    if (solver == SPARSE_SOLVER) {
+        SP_KKT = Template_In.SP_KKT;
+        sp_mass_idx = Template_In.sp_mass_idx;
+        sp_joint_idx = Template_In.sp_joint_idx;
+        sp_joint_off = Template_In.sp_joint_off;
     }
+    Init_Analyzed();
+}
 
-    dynamic_function(q_temp, k2);
-    for (unsigned int i = 0; i < q_temp.size(); i++) {
-        q_temp[i] = q[i] + 0.5 * dt * k2[i];        
-    }    
+/* The rest of init() once TOPO, ncons and the constraint rows are in place
+   and, for SPARSE_SOLVER, the symbolic factorization and value slots: from a
+   template, or from a Checkpoint that carries them */
+void Dynamics_Sys::Init_Analyzed() {
+    Init_Joints();
+    Init_Buffers();
 
-    dynamic_function(q_temp, k3);
-    for (unsigned int i = 0; i < q_temp.size(); i++) {
-        q_temp[i] = q[i] + dt * k3[i];        
-    } 
+    if (solver == SPARSE_SOLVER) {
+        factor_valid = false;
+        Assemble_Constant();  // this system's masses, not the template's
+    } else {
+        Setup_Solver();
+    }
 
-    dynamic_function(q_temp, k4);
-    for (unsigned int i = 0; i < q_temp.size(); i++) {
-        q_d[i] = (1.0 / 6.0) * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
-        q[i] = q[i] + q_d[i] * dt;        
-    } 
-    // std::cout << "POS:" << '\t' << q[4](0) << '\t' << q[4](1) << '\t' << q[4](2) << '\t';
-    // std::cout << "ANG:" << '\t' << q[7](0) * 180.0 / 3.1415926 << '\t'
-    //      << q[7](1) * 180.0 / 3.1415926 << '\t' << q[7](2) * 180.0 / 3.1415926 << std::endl;
+    Cal_Constraints();
+}
 
+/* Same bodies, grounds, joint connectivity and joint types */
+bool Dynamics_Sys::Same_Topology(const Dynamics_Sys &Other_In) const {
+    if (nbody != Other_In.nbody || njoint != Other_In.njoint) return false;
+    for (unsigned int i = 0; i < nbody; i++) {
+        if (Body_ptr_array[i]->get_type() != Other_In.Body_ptr_array[i]->get_type()) return false;
+    }
+    for (unsigned int i = 0; i < njoint; i++) {
+        const JointPtr &a = Joint_ptr_array[i];
+        const JointPtr &b = Other_In.Joint_ptr_array[i];
+        if (a->get_body_i_ptr()->get_num() != b->get_body_i_ptr()->get_num()
+            || a->get_body_j_ptr()->get_num() != b->get_body_j_ptr()->get_num()
+            || a->get_type() != b->get_type()) return false;
+    }
+    return true;
 }
 
-void Dynamics_Sys::dynamic_function(std::vector<arma::vec> qIn, std::vector<arma::vec> &qdOut) {
+void Dynamics_Sys::Init_State() {
+    unsigned int off;
+
+    /* One contiguous buffer, STATE_SIZE doubles per body. zeros() keeps the
+       memory of q, q_out and SYS_ANS when the size is unchanged, so views
+       of them (the Python module) survive a repeated init() */
+    q.zeros(nbody * STATE_SIZE);
+    q_d.zeros(nbody * STATE_SIZE);
+    for (unsigned int i = 0; i < nbody; i++) {
+        off = i * STATE_SIZE;
+        q.subvec(off + STATE_POS, off + STATE_POS + 2) = Body_ptr_array[i]->get_POSITION();
+        q.subvec(off + STATE_VEL, off + STATE_VEL + 2) = Body_ptr_array[i]->get_VELOCITY();
+        q.subvec(off + STATE_QUAT, off + STATE_QUAT + 3) = Body_ptr_array[i]->get_TBI_Q();
+        q.subvec(off + STATE_ANG_VEL, off + STATE_ANG_VEL + 2) = Body_ptr_array[i]->get_ANGLE_VEL();
+
+        q_d.subvec(off + STATE_POS, off + STATE_POS + 2) = Body_ptr_array[i]->get_VELOCITY();
+        q_d.subvec(off + STATE_VEL, off + STATE_VEL + 2) = Body_ptr_array[i]->get_ACCELERATION();
+        q_d.subvec(off + STATE_QUAT, off + STATE_QUAT + 3) = Body_ptr_array[i]->get_TBID_Q();
+        q_d.subvec(off + STATE_ANG_VEL, off + STATE_ANG_VEL + 2) = Body_ptr_array[i]->get_ANGLE_ACC();
+    }
+    q_temp.zeros(q.n_elem);
+    k1.zeros(q.n_elem);
+    k2.zeros(q.n_elem);
+    k3.zeros(q.n_elem);
+    k4.zeros(q.n_elem);
+    k5.zeros(q.n_elem);
+    k6.zeros(q.n_elem);
+    k7.zeros(q.n_elem);
+    q_new.zeros(q.n_elem);
+    q_out = q;
+    dense_coef.zeros(q.n_elem, 5);
+    fsal_valid = false;
+    step_failed = false;
+}
 
+/* The owners stay in Body_ptr_array and Joint_ptr_array */
+void Dynamics_Sys::Init_Handles() {
+    Body_array.clear();
+    Mobilized_array.clear();
+    virtual_body.clear();
     for (unsigned int i = 0; i < nbody; i++) {
-        Body_ptr_array[i]->update(qIn[i * 4], qIn[(i * 4) + 1], qIn[(i * 4) + 2], qIn[(i * 4) + 3]);
+        Body *b = Body_ptr_array[i].get();
+
+        Body_array.push_back(b);
+        if (typeid(*b) == typeid(Mobilized_body)) {
+            Mobilized_array.push_back(static_cast<Mobilized_body *>(b));
+        } else if (typeid(*b) != typeid(Ground)) {
+            virtual_body.push_back(i);
+        }
     }
+    BATCH_Q.assign(4 * Mobilized_array.size(), 0.0);
+    BATCH_W.assign(3 * Mobilized_array.size(), 0.0);
+    BATCH_GAIN.assign(Mobilized_array.size(), 0.0);
+    BATCH_TBI.assign(9 * Mobilized_array.size(), 0.0);
+    BATCH_QD.assign(4 * Mobilized_array.size(), 0.0);
 
-    for (auto it = Joint_ptr_array.begin(); it != Joint_ptr_array.end(); it++) {
-        (*it)->update();
+    Joint_array.clear();
+    joint_body_i.clear();
+    joint_body_j.clear();
+    for (unsigned int i = 0; i < njoint; i++) {
+        Joint_array.push_back(Joint_ptr_array[i].get());
+        joint_body_i.push_back(Joint_ptr_array[i]->get_body_i_ptr()->get_num());
+        joint_body_j.push_back(Joint_ptr_array[i]->get_body_j_ptr()->get_num());
     }
+}
 
-    Cal_Constraints();
+/* Joints hold the relative orientation of the assembled bodies, and report
+   which of their Jacobian columns change with the state */
+void Dynamics_Sys::Init_Joints() {
+    joint_col0.clear();
+    for (unsigned int i = 0; i < njoint; i++) {
+        Joint_ptr_array[i]->set_reference();
+        joint_col0.push_back(Joint_ptr_array[i]->get_varying_col());
+    }
+}
+
+void Dynamics_Sys::Init_Buffers() {
+    SYS_RHS.zeros(6 * nbody + ncons);
+    SYS_ANS.zeros(6 * nbody + ncons);
+    SYS_C.zeros(ncons);
+    SYS_GAMMA.zeros(ncons);
+    PROJ_RHS.zeros(6 * nbody + ncons);
+    PROJ_ANS.zeros(6 * nbody + ncons);
+    SYS_RES.zeros(6 * nbody + ncons);
+    NEWTON_RHS.zeros(6 * nbody + ncons);
+    NEWTON_ANS.zeros(6 * nbody + ncons);
+    NEWTON_RES.assign(12 * nbody, 0.0);
+    PROJ.build(Body_ptr_array, Joint_ptr_array, joint_row, TOPO.get_ground(), ground_row, ncons);
+}
 
-    arma::vec ANS;
+/* out = x + a * y over the flat state buffers */
+static void state_axpy(arma::vec &out, const arma::vec &x, double a, const arma::vec &y) {
+    double *o = out.memptr();
+    const double *xp = x.memptr();
+    const double *yp = y.memptr();
 
-    ANS = arma::solve(SYS_MAT, SYS_RHS);
+    for (unsigned int i = 0; i < out.n_elem; i++) o[i] = xp[i] + a * yp[i];
+}
 
-    // for (auto it = ANS.begin(); it != ANS.end(); it++) std::cout << *it << std::endl;
-    // for (unsigned int i = 0; i < SYS_MAT.n_rows; i++) {
-    //    for (unsigned int j = 0; j < SYS_MAT.n_cols; j++) {
-    //        std::cout << SYS_MAT(i, j) << '\t';
-    //     }
-    //     std::cout << std::endl;
-    // }
+bool Dynamics_Sys::solve() {
+    unsigned long alloc_start = alloc_counter::count();
+
+    if (step_failed) return false;
+
+    MBD_PROF_BEGIN(prof, PROF_STEP);
+#ifdef MBD_PROFILE
+    cond_pending = prof.cond_due();
+#endif
+    if (integrator == DOPRI45_INTEGRATOR) {
+        Step_DOPRI45();
+    } else if (integrator == IMPLICIT_EULER_INTEGRATOR) {
+        Step_Implicit();
+    } else {
+        Step_RK4();
+    }
+    if ((proj_position || proj_velocity) && !skip_projection && !step_failed) Project_State();
+    MBD_PROF_END(prof, PROF_STEP);
+#ifdef MBD_PROFILE
+    /* Drift of the last evaluated stage */
+    double drift = 0.0;
+    for (unsigned int i = 0; i < SYS_C.n_elem; i++) drift += SYS_C(i) * SYS_C(i);
+    prof.end_step(SYS_RHS.n_elem, std::sqrt(drift));
+#endif
+
+    step_allocs = alloc_counter::count() - alloc_start;
+    if (alloc_check && step_allocs > 0) {
+        std::cerr << "Dynamics_Sys: solve() made " << step_allocs << " heap allocations" << std::endl;
+        std::abort();
+    }
+    return !step_failed;
+}
+
+void Dynamics_Sys::Step_RK4() {
+    double *qp = q.memptr();
+    double *qdp = q_d.memptr();
+
+    dynamic_function(t_int, q, k1);
+    state_axpy(q_temp, q, 0.5 * dt, k1);
+
+    dynamic_function(t_int + 0.5 * dt, q_temp, k2);
+    state_axpy(q_temp, q, 0.5 * dt, k2);
+
+    dynamic_function(t_int + 0.5 * dt, q_temp, k3);
+    state_axpy(q_temp, q, dt, k3);
+
+    dynamic_function(t_int + dt, q_temp, k4);
+    for (unsigned int i = 0; i < q.n_elem; i++) {
+        qdp[i] = (1.0 / 6.0) * (k1(i) + 2.0 * k2(i) + 2.0 * k3(i) + k4(i));
+        qp[i] += qdp[i] * dt;
+    }
+    n_feval += 4;
+    t_int += dt;
+    t_sample = t_int;
+}
+
+/* Dormand-Prince 5(4) tableau (Hairer, Norsett & Wanner, "Solving ODEs I") */
+namespace {
+const double C2 = 1.0 / 5.0, C3 = 3.0 / 10.0, C4 = 4.0 / 5.0, C5 = 8.0 / 9.0;
+const double A21 = 1.0 / 5.0;
+const double A31 = 3.0 / 40.0, A32 = 9.0 / 40.0;
+const double A41 = 44.0 / 45.0, A42 = -56.0 / 15.0, A43 = 32.0 / 9.0;
+const double A51 = 19372.0 / 6561.0, A52 = -25360.0 / 2187.0, A53 = 64448.0 / 6561.0,
+    A54 = -212.0 / 729.0;
+const double A61 = 9017.0 / 3168.0, A62 = -355.0 / 33.0, A63 = 46732.0 / 5247.0,
+    A64 = 49.0 / 176.0, A65 = -5103.0 / 18656.0;
+const double A71 = 35.0 / 384.0, A73 = 500.0 / 1113.0, A74 = 125.0 / 192.0,
+    A75 = -2187.0 / 6784.0, A76 = 11.0 / 84.0;
+const double E1 = 71.0 / 57600.0, E3 = -71.0 / 16695.0, E4 = 71.0 / 1920.0,
+    E5 = -17253.0 / 339200.0, E6 = 22.0 / 525.0, E7 = -1.0 / 40.0;
+const double D1 = -12715105075.0 / 11282082432.0, D3 = 87487479700.0 / 32700410799.0,
+    D4 = -10690763975.0 / 1880347072.0, D5 = 701980252875.0 / 199316789632.0,
+    D6 = -1453857185.0 / 822651844.0, D7 = 69997945.0 / 29380423.0;
+}  // namespace
+
+/* Take accepted steps until t_int passes the next output time, then sample
+   the continuous extension there; one step may cover several samples */
+void Dynamics_Sys::Step_DOPRI45() {
+    const unsigned int n = q.n_elem;
+    const double t_target = t_sample + dt;
+    double err, sk, e, fac;
+    bool rejected;
+    double *yp = q.memptr();
+    double *tp = q_temp.memptr();
+    double *np = q_new.memptr();
+    const double *p1 = k1.memptr();
+    const double *p2 = k2.memptr();
+    const double *p3 = k3.memptr();
+    const double *p4 = k4.memptr();
+    const double *p5 = k5.memptr();
+    const double *p6 = k6.memptr();
+    const double *p7 = k7.memptr();
+
+    if (!fsal_valid) {
+        dynamic_function(t_int, q, k1);
+        n_feval++;
+        fsal_valid = true;
+    }
+
+    while (t_int < t_target) {
+        rejected = false;
+        while (true) {
+            if (h_max > 0.0 && h > h_max) h = h_max;
+
+            for (unsigned int i = 0; i < n; i++) tp[i] = yp[i] + h * A21 * p1[i];
+            dynamic_function(t_int + C2 * h, q_temp, k2);
+            for (unsigned int i = 0; i < n; i++) tp[i] = yp[i] + h * (A31 * p1[i] + A32 * p2[i]);
+            dynamic_function(t_int + C3 * h, q_temp, k3);
+            for (unsigned int i = 0; i < n; i++) {
+                tp[i] = yp[i] + h * (A41 * p1[i] + A42 * p2[i] + A43 * p3[i]);
+            }
+            dynamic_function(t_int + C4 * h, q_temp, k4);
+            for (unsigned int i = 0; i < n; i++) {
+                tp[i] = yp[i] + h * (A51 * p1[i] + A52 * p2[i] + A53 * p3[i] + A54 * p4[i]);
+            }
+            dynamic_function(t_int + C5 * h, q_temp, k5);
+            for (unsigned int i = 0; i < n; i++) {
+                tp[i] = yp[i] + h * (A61 * p1[i] + A62 * p2[i] + A63 * p3[i] + A64 * p4[i] + A65 * p5[i]);
+            }
+            dynamic_function(t_int + h, q_temp, k6);
+            for (unsigned int i = 0; i < n; i++) {
+                np[i] = yp[i] + h * (A71 * p1[i] + A73 * p3[i] + A74 * p4[i] + A75 * p5[i] + A76 * p6[i]);
+            }
+            dynamic_function(t_int + h, q_new, k7);
+            n_feval += 6;
+
+            /* RMS of the embedded 4th-order error, scaled by the tolerances */
+            err = 0.0;
+            for (unsigned int i = 0; i < n; i++) {
+                sk = atol + rtol * std::max(std::fabs(yp[i]), std::fabs(np[i]));
+                e = h * (E1 * p1[i] + E3 * p3[i] + E4 * p4[i] + E5 * p5[i] + E6 * p6[i] + E7 * p7[i]) / sk;
+                err += e * e;
+            }
+            err = std::sqrt(err / n);
+
+            if (err <= 1.0) break;
+            n_reject++;
+            rejected = true;
+            h *= std::max(0.2, 0.9 * std::pow(err, -0.2));
+            if (h < 1e-12 * std::max(1.0, std::fabs(t_int))) {
+                /* The trial is dropped: q, k1 and the last sample stay as they were */
+                std::cerr << "Dynamics_Sys: DOPRI45 step size underflow at t = " << t_int << ", stopping"
+                          << std::endl;
+                step_failed = true;
+                return;
+            }
+        }
+
+        for (unsigned int i = 0; i < n; i++) {
+            double ydiff = np[i] - yp[i];
+            double bspl = h * p1[i] - ydiff;
+            dense_coef(i, 0) = yp[i];
+            dense_coef(i, 1) = ydiff;
+            dense_coef(i, 2) = bspl;
+            dense_coef(i, 3) = ydiff - h * p7[i] - bspl;
+            dense_coef(i, 4) = h * (D1 * p1[i] + D3 * p3[i] + D4 * p4[i] + D5 * p5[i] + D6 * p6[i] + D7 * p7[i]);
+        }
+        t_old = t_int;
+        t_int += h;
+        q = q_new;
+        k1 = k7;
+        q_d = k7;
+
+        /* No growth right after a rejection */
+        fac = (err > 0.0) ? 0.9 * std::pow(err, -0.2) : 5.0;
+        fac = std::min(rejected ? 1.0 : 5.0, std::max(0.2, fac));
+        h *= fac;
+    }
+
+    Interpolate(t_target);
+    t_sample = t_target;
+}
+
+/* Backward Euler on the index-reduced ODE of dynamic_function():
+   y = q + dt f(y), see Newton_Step(). A step whose Newton iteration fails
+   is rejected and retried as two half steps, down to dt / 2^newton_max_split,
+   returning to longer substeps once aligned. If the shortest one fails
+   too, q, q_d and the time go back to the start of the step and the
+   failure is reported by solve(). */
+void Dynamics_Sys::Step_Implicit() {
+    const unsigned long units = 1ul << newton_max_split;
+    const double t_start = t_int;
+    unsigned long done = 0, span;
+    unsigned int level = 0;
+
+    k2 = q;
+    k3 = q_d;
+    while (done < units) {
+        span = units >> level;
+        if (Newton_Step(t_start + dt * (done + span) / units, dt * span / units)) {
+            q_d = k1;
+            q = q_new;
+            done += span;
+            t_int = t_start + dt * done / units;  // exact: units is a power of 2
+            if (level > 0 && done % (2 * span) == 0) level--;
+        } else {
+            n_reject++;
+            if (level == newton_max_split) {
+                std::cerr << "Dynamics_Sys: implicit Euler Newton did not converge at t = " << t_int
+                          << " with a step of dt / " << units << ", stopping" << std::endl;
+                q = k2;
+                q_d = k3;
+                t_int = t_start;
+                Update_Kinematics(q);
+                step_failed = true;
+                return;
+            }
+            level++;
+        }
+    }
+    t_sample = t_int;
+}
+
+/* Newton iterations for y = q + h_In f(y) in q_new, true once the update
+   is inside the set_tolerance() band. Linearized in the velocity update dw,
+   with the pose following by h_In dw, the mass rows and the stabilized
+   constraint rows Cq a = GAMMA - 2 alpha Cq v - beta^2 C of f give
+       [M Cq^T; Cq 0] [dw; mu] = [-M Rv; (h beta^2 Cq Rx - Cq Rv) / s],
+   s = 1 + 2 alpha h + beta^2 h^2, Rv and Rx the velocity and pose parts of
+   the residual y - q - h f(y) (Rx in body-frame rotations). That is the KKT
+   matrix of the stage that has just evaluated f(y), so an iteration costs
+   one dynamic_function() plus one solve with its factors, whatever the
+   solver; nothing of size n x n is formed. Force elements, GAMMA and the
+   change of Cq with the state enter through the residual only, so a spring
+   of stiffness k and damping c on a body of mass m is a fixed point
+   iteration that contracts by about h^2 k / m + h c / m: it needs that
+   well below 1 (below about 0.1 to converge in newton_max_iter), and a
+   stiffer step is only rescued by the halving in Step_Implicit(). */
+bool Dynamics_Sys::Newton_Step(double t_In, double h_In) {
+    const unsigned int n = q.n_elem;
+    const unsigned int cons_off = 6 * nbody;
+    const double s = 1.0 + 2.0 * baum_alpha * h_In + baum_beta * baum_beta * h_In * h_In;
+    const double cx = h_In * baum_beta * baum_beta / s;
+    const double cv = 1.0 / s;
+    const double *yp = q.memptr();
+    const double *fp = k1.memptr();
+    const double *dp = NEWTON_ANS.memptr();
+    double *np = q_new.memptr();
+    double *rp = q_temp.memptr();
+    double *rhs = NEWTON_RHS.memptr();
+    double norm, norm_old = 0.0, sum_v, sum_x, sk, dq[4], qq, gain, a;
+    unsigned int off, row;
+
+    /* The update goes to zero as Newton converges; a zero start for the
+       warm-started CG keeps the step a function of q alone, so a restored
+       Checkpoint continues bit for bit */
+    q_new = q;
+    NEWTON_ANS.zeros();
+    for (unsigned int it = 0; it < newton_max_iter; it++) {
+        dynamic_function(t_In, q_new, k1);
+        n_feval++;
+        n_newton++;
+        if (!kkt_valid) return false;
+        for (unsigned int i = 0; i < n; i++) rp[i] = np[i] - yp[i] - h_In * fp[i];
+
+        /* Mass rows; grounds are not integrated, their residual and rows stay 0 */
+        NEWTON_RHS.zeros();
+        for (unsigned int b = 0; b < nbody; b++) {
+            if (Body_array[b]->get_type() == 0) continue;
+            off = b * STATE_SIZE;
+            double *w = NEWTON_RES.data() + 12 * b;
+            const double *qt = np + off + STATE_QUAT;
+            const double *rq = rp + off + STATE_QUAT;
+            const arma::mat66 &M = Body_array[b]->get_M();
+
+            for (unsigned int k = 0; k < 3; k++) {
+                w[k] = rp[off + STATE_VEL + k];
+                w[3 + k] = rp[off + STATE_ANG_VEL + k];
+                w[6 + k] = rp[off + STATE_POS + k];
+            }
+            w[9] = 2.0 * (-qt[1] * rq[0] + qt[0] * rq[1] + qt[3] * rq[2] - qt[2] * rq[3]);
+            w[10] = 2.0 * (-qt[2] * rq[0] - qt[3] * rq[1] + qt[0] * rq[2] + qt[1] * rq[3]);
+            w[11] = 2.0 * (-qt[3] * rq[0] + qt[2] * rq[1] - qt[1] * rq[2] + qt[0] * rq[3]);
+            for (unsigned int r = 0; r < 6; r++) {
+                sum_v = 0.0;
+                for (unsigned int c = 0; c < 6; c++) sum_v += M(r, c) * w[c];
+                rhs[b * 6 + r] = -sum_v;
+            }
+        }
+        for (unsigned int i = 0; i < njoint; i++) {
+            const arma::mat &tmp_Cqi = Joint_array[i]->get_Cqi();
+            const arma::mat &tmp_Cqj = Joint_array[i]->get_Cqj();
+            const double *wi = NEWTON_RES.data() + 12 * joint_body_i[i];
+            const double *wj = NEWTON_RES.data() + 12 * joint_body_j[i];
+            row = cons_off + joint_row[i];
+
+            for (unsigned int r = 0; r < tmp_Cqi.n_rows; r++) {
+                sum_v = 0.0;
+                sum_x = 0.0;
+                for (unsigned int c = 0; c < 6; c++) {
+                    sum_v += tmp_Cqi(r, c) * wi[c] + tmp_Cqj(r, c) * wj[c];
+                    sum_x += tmp_Cqi(r, c) * wi[6 + c] + tmp_Cqj(r, c) * wj[6 + c];
+                }
+                rhs[row + r] = cx * sum_x - cv * sum_v;
+            }
+        }
+        Solve_Factored(NEWTON_RHS, NEWTON_ANS);
+
+        /* dv and dw as solved, dx = h dv - Rx and dq = h Xi(q) dw / 2 - Rq */
+        norm = 0.0;
+        for (unsigned int b = 0; b < nbody; b++) {
+            if (Body_array[b]->get_type() == 0) continue;
+            off = b * STATE_SIZE;
+            const double *d = dp + b * 6;
+            const double *r = rp + off;
+            double *y = np + off;
+            const double *qt = y + STATE_QUAT;
+
+            dq[0] = 0.5 * h_In * (-d[3] * qt[1] - d[4] * qt[2] - d[5] * qt[3]) - r[STATE_QUAT];
+            dq[1] = 0.5 * h_In * (d[3] * qt[0] + d[5] * qt[2] - d[4] * qt[3]) - r[STATE_QUAT + 1];
+            dq[2] = 0.5 * h_In * (d[4] * qt[0] - d[5] * qt[1] + d[3] * qt[3]) - r[STATE_QUAT + 2];
+            dq[3] = 0.5 * h_In * (d[5] * qt[0] + d[4] * qt[1] - d[3] * qt[2]) - r[STATE_QUAT + 3];
+            /* The norm pull g (1 - |q|^2) q of the rate is stiff (h g of order 1):
+               dq = (a I + b q q^T)^-1 dq, a = 1 - h g (1 - |q|^2), b = 2 h g */
+            qq = qt[0] * qt[0] + qt[1] * qt[1] + qt[2] * qt[2] + qt[3] * qt[3];
+            gain = Body_array[b]->get_quat_gain();
+            a = 1.0 - h_In * gain * (1.0 - qq);
+            sum_v = 2.0 * h_In * gain * (qt[0] * dq[0] + qt[1] * dq[1] + qt[2] * dq[2] + qt[3] * dq[3])
+                / (a + 2.0 * h_In * gain * qq);
+            for (unsigned int k = 0; k < 4; k++) dq[k] = (dq[k] - sum_v * qt[k]) / a;
+            for (unsigned int k = 0; k < 3; k++) {
+                y[STATE_POS + k] += h_In * d[k] - r[STATE_POS + k];
+                y[STATE_VEL + k] += d[k];
+                y[STATE_ANG_VEL + k] += d[3 + k];
+                sk = atol + rtol * std::fabs(y[STATE_POS + k]);
+                norm += (h_In * d[k] - r[STATE_POS + k]) * (h_In * d[k] - r[STATE_POS + k]) / (sk * sk);
+                sk = atol + rtol * std::fabs(y[STATE_VEL + k]);
+                norm += d[k] * d[k] / (sk * sk);
+                sk = atol + rtol * std::fabs(y[STATE_ANG_VEL + k]);
+                norm += d[3 + k] * d[3 + k] / (sk * sk);
+            }
+            for (unsigned int k = 0; k < 4; k++) {
+                y[STATE_QUAT + k] += dq[k];
+                sk = atol + rtol * std::fabs(y[STATE_QUAT + k]);
+                norm += dq[k] * dq[k] / (sk * sk);
+            }
+        }
+        norm = std::sqrt(norm / n);
+        if (norm <= 1.0) return true;
+        if (it > 0 && norm > 0.9 * norm_old) return false;  // not contracting
+        norm_old = norm;
+    }
+    return false;
+}
+
+/* Continuous extension of the last accepted step, t_old <= t_In <= t_int */
+void Dynamics_Sys::Interpolate(double t_In) {
+    const double theta = (t_In - t_old) / (t_int - t_old);
+    const double theta1 = 1.0 - theta;
+    double *op = q_out.memptr();
+
+    for (unsigned int i = 0; i < q_out.n_elem; i++) {
+        op[i] = dense_coef(i, 0) + theta * (dense_coef(i, 1) + theta1 * (dense_coef(i, 2)
+            + theta * (dense_coef(i, 3) + theta1 * dense_coef(i, 4))));
+    }
+}
+
+/* Bodies only touch their own state and joints only read their two
+   bodies, so both loops are split over the pool for large scenes */
+void Dynamics_Sys::Update_Kinematics(const arma::vec &qIn) {
+    MBD_PROF_BEGIN(prof, PROF_BODY_UPDATE);
+    /* Gather the chunk into the batch buffers, convert it with the vector
+       kernels and hand each body its item */
+    Parallel_For(Mobilized_array.size(), [&](unsigned int begin, unsigned int end) {
+        unsigned int off;
+        const unsigned int ld = Mobilized_array.size();
+        const double *qp = qIn.memptr();
+
+        for (unsigned int i = begin; i < end; i++) {
+            off = Mobilized_array[i]->get_num() * STATE_SIZE;
+            for (unsigned int k = 0; k < 4; k++) BATCH_Q[k * ld + i] = qp[off + STATE_QUAT + k];
+            for (unsigned int k = 0; k < 3; k++) BATCH_W[k * ld + i] = qp[off + STATE_ANG_VEL + k];
+            BATCH_GAIN[i] = Mobilized_array[i]->get_quat_gain();
+        }
+        Quaternion2Matrix_batch(end - begin, BATCH_Q.data() + begin, BATCH_TBI.data() + begin, ld);
+        quaternion_rate_batch(end - begin, BATCH_Q.data() + begin, BATCH_W.data() + begin,
+            BATCH_GAIN.data() + begin, BATCH_QD.data() + begin, ld);
+        for (unsigned int i = begin; i < end; i++) {
+            off = Mobilized_array[i]->get_num() * STATE_SIZE;
+            Mobilized_array[i]->load_state(qp + off + STATE_POS, qp + off + STATE_VEL, qp + off + STATE_ANG_VEL,
+                BATCH_TBI.data() + i, BATCH_QD.data() + i, ld);
+        }
+    });
+    for (unsigned int k = 0; k < virtual_body.size(); k++) {
+        unsigned int off = virtual_body[k] * STATE_SIZE;
+
+        Body_array[virtual_body[k]]->update(qIn.subvec(off + STATE_POS, off + STATE_POS + 2),
+            qIn.subvec(off + STATE_VEL, off + STATE_VEL + 2),
+            qIn.subvec(off + STATE_QUAT, off + STATE_QUAT + 3),
+            qIn.subvec(off + STATE_ANG_VEL, off + STATE_ANG_VEL + 2));
+    }
+    MBD_PROF_END(prof, PROF_BODY_UPDATE);
+
+    MBD_PROF_BEGIN(prof, PROF_JOINT_UPDATE);
+    Parallel_For(njoint, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) Joint_array[i]->update();
+    });
+    MBD_PROF_END(prof, PROF_JOINT_UPDATE);
+}
+
+void Dynamics_Sys::dynamic_function(double tIn, const arma::vec &qIn, arma::vec &qdOut) {
+    unsigned int off;
+
+    Update_Kinematics(qIn);
+
+    MBD_PROF_BEGIN(prof, PROF_CONSTRAINTS);
+    Cal_Constraints();
+    for (unsigned int k = 0; k < Force_ptr_array.size(); k++) {
+        if (Force_ptr_array[k]->is_active()) Force_ptr_array[k]->apply(tIn, Body_ptr_array, SYS_RHS.memptr());
+    }
+    MBD_PROF_END(prof, PROF_CONSTRAINTS);
+
+    Solve_System();
 
     for (unsigned int i = 0; i < nbody; i++) {
-        qdOut[(i * 4)] = qIn[(i * 4) + 1];
-        qdOut[(i * 4) + 1] = ANS.subvec((i * 6), (i * 6)+2);
-        qdOut[(i * 4) + 2] = Body_ptr_array[i]->get_TBID_Q();
-        qdOut[(i * 4) + 3] = ANS.subvec((i * 6) + 3, (i * 6) + 5);
+        off = i * STATE_SIZE;
+        qdOut.subvec(off + STATE_POS, off + STATE_POS + 2) = qIn.subvec(off + STATE_VEL, off + STATE_VEL + 2);
+        qdOut.subvec(off + STATE_VEL, off + STATE_VEL + 2) = SYS_ANS.subvec(i * 6, i * 6 + 2);
+        qdOut.subvec(off + STATE_QUAT, off + STATE_QUAT + 3) = Body_array[i]->get_TBID_Q();
+        qdOut.subvec(off + STATE_ANG_VEL, off + STATE_ANG_VEL + 2) = SYS_ANS.subvec(i * 6 + 3, i * 6 + 5);
+    }
+    /* Grounds keep their pose in q exactly, not up to the round-off of their solved accelerations */
+    for (unsigned int g = 0; g < TOPO.get_ground().size(); g++) {
+        off = TOPO.get_ground()[g] * STATE_SIZE;
+        qdOut.subvec(off, off + STATE_SIZE - 1).zeros();
+    }
+}
+
+/* Mass-weighted projection of q onto the constraint manifold after a step:
+   dq = -M^-1 Cq^T (Cq M^-1 Cq^T)^-1 C, repeated while |C| > proj_tol, then
+   one linear step removing Cq v. The rotational part of dq is a body-frame
+   rotation applied through the quaternion rate. Under DOPRI45 the
+   integration state is projected, the interpolated output sample is not. */
+void Dynamics_Sys::Project_State() {
+    unsigned int cons_off = 6 * nbody;
+    unsigned int off, row, n_rows;
+    double c_max, norm;
+    double *qp = q.memptr();
+    arma::vec6 tmp_vi, tmp_vj;
+    double tmp_Cv;
+
+    MBD_PROF_BEGIN(prof, PROF_PROJECTION);
+    for (unsigned int it = 0; proj_position && it < proj_max_iter; it++) {
+        Update_Kinematics(q);
+
+        /* Grounds are not integrated, so their rows stay at zero correction */
+        c_max = 0.0;
+        PROJ_RHS.zeros();
+        for (unsigned int i = 0; i < njoint; i++) {
+            const arma::vec &tmp_C = Joint_array[i]->get_CONSTRAINT();
+            row = cons_off + joint_row[i];
+            for (unsigned int r = 0; r < tmp_C.n_elem; r++) {
+                PROJ_RHS(row + r) = -tmp_C(r);
+                c_max = std::max(c_max, std::fabs(tmp_C(r)));
+            }
+        }
+        if (c_max <= proj_tol) break;
+
+        if (!PROJ.factor()) {
+            std::cerr << "Dynamics_Sys: singular constraint projection" << std::endl;
+            break;
+        }
+        PROJ.solve(PROJ_RHS, PROJ_ANS);
+        for (unsigned int b = 0; b < nbody; b++) {
+            if (Body_array[b]->get_type() == 0) continue;
+            off = b * STATE_SIZE;
+            const double *d = PROJ_ANS.memptr() + b * 6;
+            double *qt = qp + off + STATE_QUAT;
+            double q0 = qt[0], q1 = qt[1], q2 = qt[2], q3 = qt[3];
+
+            for (unsigned int k = 0; k < 3; k++) qp[off + STATE_POS + k] += d[k];
+            qt[0] += 0.5 * (-d[3] * q1 - d[4] * q2 - d[5] * q3);
+            qt[1] += 0.5 * (d[3] * q0 + d[5] * q2 - d[4] * q3);
+            qt[2] += 0.5 * (d[4] * q0 - d[5] * q1 + d[3] * q3);
+            qt[3] += 0.5 * (d[5] * q0 + d[4] * q1 - d[3] * q2);
+            norm = std::sqrt(qt[0] * qt[0] + qt[1] * qt[1] + qt[2] * qt[2] + qt[3] * qt[3]);
+            for (unsigned int k = 0; k < 4; k++) qt[k] /= norm;
+        }
     }
 
-    // for (auto it = qdOut.begin(); it != qdOut.end(); it++) {
-    //     for (unsigned int i = 0; i < 3; i++) {
-    //         std::cout << (*it)(i) << '\t';
-    //     }
-    //     std::cout << std::endl;
-    // }
+    if (proj_velocity) {
+        Update_Kinematics(q);
+        PROJ_RHS.zeros();
+        for (unsigned int i = 0; i < njoint; i++) {
+            const arma::mat &tmp_Cqi = Joint_array[i]->get_Cqi();
+            const arma::mat &tmp_Cqj = Joint_array[i]->get_Cqj();
+            n_rows = tmp_Cqi.n_rows;
+            row = cons_off + joint_row[i];
+
+            tmp_vi.subvec(0, 2) = Body_array[joint_body_i[i]]->get_VELOCITY();
+            tmp_vi.subvec(3, 5) = Body_array[joint_body_i[i]]->get_ANGLE_VEL();
+            tmp_vj.subvec(0, 2) = Body_array[joint_body_j[i]]->get_VELOCITY();
+            tmp_vj.subvec(3, 5) = Body_array[joint_body_j[i]]->get_ANGLE_VEL();
+            for (unsigned int r = 0; r < n_rows; r++) {
+                tmp_Cv = 0.0;
+                for (unsigned int c = 0; c < 6; c++) tmp_Cv += tmp_Cqi(r, c) * tmp_vi(c) + tmp_Cqj(r, c) * tmp_vj(c);
+                PROJ_RHS(row + r) = -tmp_Cv;
+            }
+        }
+
+        if (PROJ.factor()) {
+            PROJ.solve(PROJ_RHS, PROJ_ANS);
+            for (unsigned int b = 0; b < nbody; b++) {
+                if (Body_array[b]->get_type() == 0) continue;
+                off = b * STATE_SIZE;
+                for (unsigned int k = 0; k < 3; k++) {
+                    qp[off + STATE_VEL + k] += PROJ_ANS(b * 6 + k);
+                    qp[off + STATE_ANG_VEL + k] += PROJ_ANS(b * 6 + 3 + k);
+                }
+            }
+        } else {
+            std::cerr << "Dynamics_Sys: singular constraint projection" << std::endl;
+        }
+    }
+
+    /* q moved, the stored first stage derivative no longer matches it */
+    fsal_valid = false;
+    MBD_PROF_END(prof, PROF_PROJECTION);
 }
+
 void Dynamics_Sys::output_data(std::ofstream &fout_In) {
-    // arma::vec3 v_temp;
-    for (unsigned int i = 1; i < nbody; i++) {
-        // v_temp = Joint_ptr_array[i - 1]->get_Pj();
-        fout_In << q[i * 4](0) << '\t' << q[i * 4](1) << '\t' << q[i * 4](2) << '\t';
+    const arma::vec &qs = get_state();
+
+    for (unsigned int i = 0; i < nbody; i++) {
+        if (Body_ptr_array[i]->get_type() == 0) continue;
+        fout_In << qs(i * STATE_SIZE) << '\t' << qs(i * STATE_SIZE + 1) << '\t' << qs(i * STATE_SIZE + 2) << '\t';
+    }
+    fout_In << '\n';  // no flush per line; the stream flushes on close
+}
+
+void Dynamics_Sys::set_alloc_check(bool Check_In) {
+    if (Check_In && !alloc_counter::enabled()) {
+        std::cerr << "Dynamics_Sys: allocation check needs a build with -DMBD_ALLOC_COUNTER" << std::endl;
     }
-    fout_In << std::endl;
+    alloc_check = Check_In;
+}
+
+/* Runs the per-stage body, joint and assembly loops on nthreads_In threads
+   (0: one per core, 1: serial) once the scene has min_bodies_In bodies;
+   below that the fork-join overhead outweighs the work. Keep it at 1 for
+   Ensemble members, which already run one system per thread. */
+void Dynamics_Sys::set_threads(unsigned int nthreads_In, unsigned int min_bodies_In) {
+    par_min_bodies = min_bodies_In;
+    pool.reset();
+    if (nthreads_In != 1) {
+        pool.reset(new Thread_Pool(nthreads_In));
+        if (pool->get_nthreads() < 2) pool.reset();
+    }
+}
+
+/* Baumgarte gains of C'' + 2 alpha C' + beta^2 C = 0; (1, 1) is the original
+   stabilization. Larger gains hold the chain together at a larger dt, up to
+   beta * dt of about 1. */
+void Dynamics_Sys::set_baumgarte(double alpha_In, double beta_In) {
+    baum_alpha = alpha_In;
+    baum_beta = beta_In;
+}
+
+/* Gain of the quaternion norm correction in Mobilized_body::update, 50 by default */
+void Dynamics_Sys::set_quat_gain(double Gain_In) {
+    for (unsigned int i = 0; i < nbody; i++) Body_ptr_array[i]->set_quat_gain(Gain_In);
+}
+
+/* Projection of the positions (up to max_iter_In Gauss-Newton corrections
+   until |C| <= tol_In) and/or the velocities after every solve() */
+void Dynamics_Sys::set_projection(bool position_In, bool velocity_In, double tol_In, unsigned int max_iter_In) {
+    proj_position = position_In;
+    proj_velocity = velocity_In;
+    proj_tol = tol_In;
+    proj_max_iter = max_iter_In;
+}
+
+/* Holds for every solve() until reset; the tree, Schur and iterative solvers always refactor */
+void Dynamics_Sys::set_degraded(bool reuse_factor_In, bool skip_projection_In) {
+    reuse_factor = reuse_factor_In;
+    skip_projection = skip_projection_In;
+}
+
+/* CG stops at |r| <= tol_In |Cq M^-1 F - GAMMA| or after max_iter_In
+   iterations, 0 meaning the constraint count */
+void Dynamics_Sys::set_iterative(double tol_In, unsigned int max_iter_In) {
+    iter_tol = tol_In;
+    iter_max_iter = max_iter_In;
+    if (solver == ITERATIVE_SOLVER) SCHUR.set_iterative(true, iter_tol, iter_max_iter);
+}
+
+/* Switching resets the step-size history; call after init() to continue from q */
+void Dynamics_Sys::set_integrator(Integrator_Type Type_In) {
+    integrator = Type_In;
+    fsal_valid = false;
+    step_failed = false;
+    h = dt;
+    t_sample = t_int;
+    if (q_out.n_elem > 0) q_out = q;
+}
+
+/* Mixed error test per state entry: |err| <= atol + rtol * |q| */
+void Dynamics_Sys::set_tolerance(double rtol_In, double atol_In) {
+    rtol = rtol_In;
+    atol = atol_In;
+}
+
+void Dynamics_Sys::set_max_step(double h_max_In) { h_max = h_max_In; }
+
+unsigned long Dynamics_Sys::get_step_allocs() { return step_allocs; }
+double Dynamics_Sys::get_time() const { return t_sample; }
+double Dynamics_Sys::get_dt() const { return dt; }
+bool Dynamics_Sys::get_failed() const { return step_failed; }
+unsigned long Dynamics_Sys::get_feval_count() { return n_feval; }
+unsigned long Dynamics_Sys::get_reject_count() { return n_reject; }
+unsigned long Dynamics_Sys::get_newton_count() { return n_newton; }
+unsigned long Dynamics_Sys::get_iteration_count() { return n_iter; }
+unsigned long Dynamics_Sys::get_cg_fail_count() { return n_cg_fail; }
+unsigned int Dynamics_Sys::get_nbody() const { return nbody; }
+unsigned int Dynamics_Sys::get_njoint() const { return njoint; }
+
+/* Flat state at get_time(), STATE_SIZE doubles per body */
+const arma::vec &Dynamics_Sys::get_state() const {
+    return (integrator == DOPRI45_INTEGRATOR) ? q_out : q;
 }
 
-unsigned int Dynamics_Sys::get_nbody() { return nbody; }
-unsigned int Dynamics_Sys::get_njoint() { return njoint; }
+/* Accelerations (6 per body) then get_ncons() multipliers, from the last
+   dynamic_function() call, i.e. the final stage of the last step */
+const arma::vec &Dynamics_Sys::get_SYS_ANS() const { return SYS_ANS; }
+unsigned int Dynamics_Sys::get_ncons() const { return ncons; }
+unsigned int Dynamics_Sys::get_threads() const { return pool ? pool->get_nthreads() : 1; }
+Profiler &Dynamics_Sys::get_profiler() { return prof; }
+const BodyPtr &Dynamics_Sys::get_body(unsigned int i_In) const { return Body_ptr_array[i_In]; }
+const JointPtr &Dynamics_Sys::get_joint(unsigned int i_In) const { return Joint_ptr_array[i_In]; }
+unsigned int Dynamics_Sys::get_joint_row(unsigned int i_In) const { return joint_row[i_In]; }
+const Topology &Dynamics_Sys::get_topology() const { return TOPO; }
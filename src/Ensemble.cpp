@@ -0,0 +1,98 @@
+#include "Ensemble.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+Ensemble::Ensemble(unsigned int nthreads_In) {
+    nthreads = nthreads_In;
+    if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0) nthreads = 1;
+    nsteps = 0;
+    output_every = 1;
+}
+
+/* Members are built by the caller (bodies, joints, Assembly()) but not init()ed */
+void Ensemble::Add(DynSysPtr sysPtr_In) {
+    members.push_back(sysPtr_In);
+}
+
+void Ensemble::init() {
+    if (members.empty()) return;
+    members[0]->init();
+    for (unsigned int i = 1; i < members.size(); i++) members[i]->init(*members[0]);
+}
+
+void Ensemble::run(unsigned int nsteps_In, const std::string &prefix_In, unsigned int output_every_In) {
+    std::vector<std::thread> workers;
+    unsigned int n_workers = std::min<unsigned int>(nthreads, members.size());
+
+    if (n_workers == 0) return;
+    nsteps = nsteps_In;
+    prefix = prefix_In;
+    output_every = (output_every_In == 0) ? 1 : output_every_In;
+
+    /* Round-robin start; stealing evens out members that take longer */
+    queues.clear();
+    for (unsigned int w = 0; w < n_workers; w++) queues.emplace_back(new Task_Queue());
+    for (unsigned int i = 0; i < members.size(); i++) queues[i % n_workers]->tasks.push_back(i);
+
+    for (unsigned int w = 1; w < n_workers; w++) workers.emplace_back(&Ensemble::Worker_Loop, this, w);
+    Worker_Loop(0);
+    for (unsigned int w = 0; w < workers.size(); w++) workers[w].join();
+}
+
+/* Own queue from the back, then steal from the front of the others. Tasks are
+   only ever removed, so one empty sweep over all queues means the run is done. */
+bool Ensemble::Pop_Task(unsigned int worker, unsigned int &task) {
+    unsigned int n_workers = queues.size();
+
+    {
+        std::lock_guard<std::mutex> guard(queues[worker]->lock);
+        if (!queues[worker]->tasks.empty()) {
+            task = queues[worker]->tasks.back();
+            queues[worker]->tasks.pop_back();
+            return true;
+        }
+    }
+    for (unsigned int k = 1; k < n_workers; k++) {
+        Task_Queue &victim = *queues[(worker + k) % n_workers];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Ensemble::Worker_Loop(unsigned int worker) {
+    unsigned int task;
+
+    while (Pop_Task(worker, task)) Run_Member(task);
+}
+
+void Ensemble::Run_Member(unsigned int i) {
+    std::ofstream fout;
+    Dynamics_Sys &sys = *members[i];
+
+    if (!prefix.empty()) {
+        fout.open(prefix + std::to_string(i) + ".csv");
+        if (!fout) std::cerr << "Ensemble: cannot open output for member " << i << std::endl;
+    }
+    for (unsigned int k = 0; k < nsteps; k++) {
+        if (!sys.solve()) {
+            std::cerr << "Ensemble: member " << i << " stopped at t = " << sys.get_time() << std::endl;
+            break;
+        }
+        if (fout.is_open() && k % output_every == 0) {
+            fout << sys.get_time() << '\t';
+            sys.output_data(fout);
+        }
+    }
+}
+
+unsigned int Ensemble::get_nmember() { return members.size(); }
+unsigned int Ensemble::get_nthreads() { return nthreads; }
+DynSysPtr Ensemble::get_member(unsigned int i) { return members[i]; }
@@ -0,0 +1,77 @@
+#include "Force_Element.hpp"
+#include <cmath>
+
+Gravity_Field::Gravity_Field(const arma::vec &g_In) : g(arma::fill::zeros) { g = g_In; }
+
+void Gravity_Field::apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) {
+    double m;
+
+    for (unsigned int i = 0; i < Body_In.size(); i++) {
+        if (Body_In[i]->get_type() == 0) continue;
+        m = Body_In[i]->get_M()(0, 0);
+        RHS_Out[i * 6] += m * g(0);
+        RHS_Out[i * 6 + 1] += m * g(1);
+        RHS_Out[i * 6 + 2] += m * g(2);
+    }
+}
+
+void Gravity_Field::set_g(const arma::vec &g_In) { g = g_In; }
+const arma::vec3 &Gravity_Field::get_g() const { return g; }
+
+Spring_Damper::Spring_Damper(BodyPtr i_In, BodyPtr j_In, const arma::vec &piIn, const arma::vec &pjIn,
+        double k_In, double c_In, double L0_In) :
+    pi(arma::fill::zeros),
+    pj(arma::fill::zeros) {
+        body_i_ptr = i_In;
+        body_j_ptr = j_In;
+        pi = piIn;
+        pj = pjIn;
+        k = k_In;
+        c = c_In;
+        L0 = L0_In;
+        L = 0.0;
+        f = 0.0;
+}
+
+/* Point velocities V + TIB (w x p) with w in the body frame; the torque on
+   each body is p x (TBI F) */
+void Spring_Damper::apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) {
+    arma::mat33 TIB_i = trans(body_i_ptr->get_TBI());
+    arma::mat33 TIB_j = trans(body_j_ptr->get_TBI());
+    arma::vec3 d = body_j_ptr->get_POSITION() + TIB_j * pj - body_i_ptr->get_POSITION() - TIB_i * pi;
+    arma::vec3 v = body_j_ptr->get_VELOCITY() + TIB_j * arma::cross(body_j_ptr->get_ANGLE_VEL(), pj)
+        - body_i_ptr->get_VELOCITY() - TIB_i * arma::cross(body_i_ptr->get_ANGLE_VEL(), pi);
+    arma::vec3 u, F, Ti, Tj;
+    unsigned int bi = body_i_ptr->get_num() * 6;
+    unsigned int bj = body_j_ptr->get_num() * 6;
+
+    L = arma::norm(d);
+    if (L < 1e-12) {
+        f = 0.0;
+        return;
+    }
+    u = d / L;
+    f = k * (L - L0) + c * arma::dot(u, v);
+    F = f * u;  // on body i, -F on body j
+    Ti = arma::cross(pi, body_i_ptr->get_TBI() * F);
+    Tj = -arma::cross(pj, body_j_ptr->get_TBI() * F);
+
+    for (unsigned int r = 0; r < 3; r++) {
+        RHS_Out[bi + r] += F(r);
+        RHS_Out[bi + 3 + r] += Ti(r);
+        RHS_Out[bj + r] -= F(r);
+        RHS_Out[bj + 3 + r] += Tj(r);
+    }
+}
+
+void Spring_Damper::set_stiffness(double k_In) { k = k_In; }
+void Spring_Damper::set_damping(double c_In) { c = c_In; }
+void Spring_Damper::set_rest_length(double L0_In) { L0 = L0_In; }
+double Spring_Damper::get_length() const { return L; }
+double Spring_Damper::get_tension() const { return f; }
+
+Callback_Force::Callback_Force(const Force_Callback &fn_In) { fn = fn_In; }
+
+void Callback_Force::apply(double t_In, const std::vector<BodyPtr> &Body_In, double *RHS_Out) {
+    if (fn) fn(t_In, Body_In, RHS_Out);
+}
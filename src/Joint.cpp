@@ -1,93 +1,219 @@
 #include "Joint.hpp"
+#include <cmath>
+#include <iostream>
 
-Joint::Joint(unsigned int TypeIn, arma::vec piIn, arma::vec pjIn, arma::vec qiIn,
-            arma::vec qjIn, BodyPtr i_In, BodyPtr j_In) :
-    pi(3, arma::fill::zeros),
-    pj(3, arma::fill::zeros),
-    qi(3, arma::fill::zeros),
-    qj(3, arma::fill::zeros),
-    Cqi(3, 6, arma::fill::zeros),
-    Cqj(3, 6, arma::fill::zeros),
-    GAMMA(3, arma::fill::zeros),
-    CONSTRAINT(3, arma::fill::zeros),
-    TBI_i(3, 3, arma::fill::eye),
-    TBI_j(3, 3, arma::fill::eye),
-    Pi(3, arma::fill::zeros),
-    Pj(3, arma::fill::zeros),
-    Qi(3, arma::fill::zeros),
-    Qj(3, arma::fill::zeros),
-    wi(3, arma::fill::zeros),
-    wj(3, arma::fill::zeros),
-    Si(3, arma::fill::zeros),
-    Sj(3, arma::fill::zeros) {
-        Type = TypeIn;
+namespace {
+
+/* Unit vector along v, or along fallback when v is zero */
+arma::vec3 unit_axis(const arma::vec3 &v, const arma::vec3 &fallback, const char *name) {
+    double len = arma::norm(v);
+
+    if (len < 1e-12) {
+        if (name) std::cerr << "Joint: zero " << name << " axis, using " << fallback(0) << ' '
+                            << fallback(1) << ' ' << fallback(2) << std::endl;
+        return fallback;
+    }
+    return v / len;
+}
+
+/* Two unit vectors completing the unit vector a to a right-handed triad */
+void perp_basis(const arma::vec3 &a, arma::vec3 &b1, arma::vec3 &b2) {
+    arma::vec3 e(arma::fill::zeros);
+    unsigned int k = 0;
+
+    for (unsigned int c = 1; c < 3; c++) {
+        if (std::fabs(a(c)) < std::fabs(a(k))) k = c;
+    }
+    e(k) = 1.0;
+    b1 = arma::cross(a, e);
+    b1 /= arma::norm(b1);
+    b2 = arma::cross(a, b1);
+}
+
+const arma::vec3 X_AXIS = {1., 0., 0.};
+const arma::vec3 Z_AXIS = {0., 0., 1.};
+
+}  // namespace
+
+Joint::Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) :
+    pi(arma::fill::zeros),
+    pj(arma::fill::zeros),
+    qi(arma::fill::zeros),
+    qj(arma::fill::zeros),
+    TIB_i(arma::fill::eye),
+    TIB_j(arma::fill::eye),
+    Pi(arma::fill::zeros),
+    Pj(arma::fill::zeros),
+    Qi(arma::fill::zeros),
+    Qj(arma::fill::zeros),
+    wi(arma::fill::zeros),
+    wj(arma::fill::zeros),
+    Wi(arma::fill::zeros),
+    Wj(arma::fill::zeros),
+    Si(arma::fill::zeros),
+    Sj(arma::fill::zeros),
+    Vi(arma::fill::zeros),
+    Vj(arma::fill::zeros) {
         body_i_ptr = i_In;
         body_j_ptr = j_In;
         pi = piIn;
         pj = pjIn;
         qi = qiIn;
         qj = qjIn;
-
-        update();
 }
 
+/* Derived constructors call update() once their rows are set up */
 void Joint::update() {
-    TBI_i = body_i_ptr->get_TBI();
-    TBI_j = body_j_ptr->get_TBI();
+    TIB_i = trans(body_i_ptr->get_TBI());
+    TIB_j = trans(body_j_ptr->get_TBI());
     wi = body_i_ptr->get_ANGLE_VEL();
     wj = body_j_ptr->get_ANGLE_VEL();
-    Pi = trans(TBI_i) * pi;
-    Pj = trans(TBI_j) * pj;
-    Qi = trans(TBI_i) * qi;
-    Qj = trans(TBI_j) * qj;
+    Wi = TIB_i * wi;
+    Wj = TIB_j * wj;
+    Pi = TIB_i * pi;
+    Pj = TIB_j * pj;
+    Qi = TIB_i * qi;
+    Qj = TIB_j * qj;
     Si = body_i_ptr->get_POSITION();
     Sj = body_j_ptr->get_POSITION();
+    Vi = body_i_ptr->get_VELOCITY();
+    Vj = body_j_ptr->get_VELOCITY();
 
-    Build_C();
-    Build_Cq();
-    Build_GAMMA();
+    Build_Rows();
 }
 
-void Joint::Build_C() {
-    CONSTRAINT = Si + Pi - Sj - Pj;
+/* Spherical, revolute, fixed and universal rows have constant (+-I or zero)
+   translational columns */
+unsigned int Joint::get_varying_col() const { return 3; }
+
+arma::vec6 Joint::get_reference() const { return arma::vec6(arma::fill::zeros); }
+
+const arma::vec3 &Joint::get_Pi() const { return Pi; }
+const arma::vec3 &Joint::get_Pj() const { return Pj; }
+const arma::vec3 &Joint::get_pi() const { return pi; }
+const arma::vec3 &Joint::get_pj() const { return pj; }
+const arma::vec3 &Joint::get_qi() const { return qi; }
+const arma::vec3 &Joint::get_qj() const { return qj; }
+const BodyPtr &Joint::get_body_i_ptr() const { return body_i_ptr; }
+const BodyPtr &Joint::get_body_j_ptr() const { return body_j_ptr; }
+
+Spherical_Joint::Spherical_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) :
+    Joint_Rows<3>(piIn, pjIn, qiIn, qjIn, i_In, j_In) {
+        Set_Spherical_Identity(0);
+        update();
 }
 
-void Joint::Build_Cq() {
-    arma::mat temp_matrix_1(3, 3, arma::fill::eye);
-    arma::mat temp_matrix_2(3, 3, arma::fill::zeros);
-    arma::mat temp_matrix_3(3, 3, arma::fill::eye);
-    arma::mat temp_matrix_4(3, 3, arma::fill::zeros);
+void Spherical_Joint::Build_Rows() { Spherical_Rows(0); }
 
-    temp_matrix_2 = -skew_sym(Pi) * trans(TBI_i);
-    temp_matrix_4 = skew_sym(Pj) * trans(TBI_j);
+Revolute_Joint::Revolute_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) :
+    Joint_Rows<5>(piIn, pjIn, qiIn, qjIn, i_In, j_In) {
+        ai = unit_axis(qi, Z_AXIS, "revolute qi");
+        perp_basis(unit_axis(qj, Z_AXIS, "revolute qj"), bj1, bj2);
+        Set_Spherical_Identity(0);
+        update();
+}
 
-    Cqi = join_rows(temp_matrix_1, temp_matrix_2);
-    Cqj = join_rows(-temp_matrix_3, temp_matrix_4);
+void Revolute_Joint::Build_Rows() {
+    Spherical_Rows(0);
+    Dot_Row(3, ai, bj1);
+    Dot_Row(4, ai, bj2);
 }
 
-void Joint::Build_GAMMA() {
-    arma::mat33 Skew_Omega_i = skew_sym(wi);
-    arma::mat33 Skew_Omega_j = skew_sym(wj);
+Prismatic_Joint::Prismatic_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) :
+    Joint_Rows<5>(piIn, pjIn, qiIn, qjIn, i_In, j_In) {
+        ai = unit_axis(qi, X_AXIS, "prismatic qi");
+        perp_basis(ai, bi1, bi2);
+        set_reference();
+}
 
-    GAMMA = -trans(TBI_i) * Skew_Omega_i * Skew_Omega_i * pi + trans(TBI_j) * Skew_Omega_j * Skew_Omega_j * pj;
+/* The relative orientation of the bodies at this call is the one held */
+void Prismatic_Joint::set_reference() {
+    arma::mat33 TBJI = body_j_ptr->get_TBI() * trans(body_i_ptr->get_TBI());
+
+    bj1 = TBJI * bi1;
+    bj2 = TBJI * bi2;
+    update();
 }
 
-arma::mat Joint::get_Cqi() { return Cqi; }
-arma::mat Joint::get_Cqj() { return Cqj; }
-arma::vec Joint::get_CONSTRAINT() { return CONSTRAINT; }
-arma::vec Joint::get_GAMMA() { return GAMMA; }
-arma::vec Joint::get_Pi() { return Pi; }
-arma::vec Joint::get_Pj() { return Pj; }
-arma::vec Joint::get_pi() { return pi; }
-arma::vec Joint::get_pj() { return pj; }
-BodyPtr Joint::get_body_i_ptr() { return body_i_ptr; };
-BodyPtr Joint::get_body_j_ptr() { return body_j_ptr; };
+arma::vec6 Prismatic_Joint::get_reference() const {
+    arma::vec6 Ref;
 
+    Ref.subvec(0, 2) = bj1;
+    Ref.subvec(3, 5) = bj2;
+    return Ref;
+}
 
+void Prismatic_Joint::load_reference(const arma::vec6 &Ref_In) {
+    bj1 = Ref_In.subvec(0, 2);
+    bj2 = Ref_In.subvec(3, 5);
+    update();
+}
 
+void Prismatic_Joint::Build_Rows() {
+    Dot_Row(0, ai, bj1);
+    Dot_Row(1, ai, bj2);
+    Dot_Row(2, bi1, bj2);
+    Slide_Row(3, bi1);
+    Slide_Row(4, bi2);
+}
+
+Fixed_Joint::Fixed_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) :
+    Joint_Rows<6>(piIn, pjIn, qiIn, qjIn, i_In, j_In) {
+        ai = unit_axis(qi, X_AXIS, nullptr);
+        perp_basis(ai, bi1, bi2);
+        Set_Spherical_Identity(0);
+        set_reference();
+}
+
+void Fixed_Joint::set_reference() {
+    arma::mat33 TBJI = body_j_ptr->get_TBI() * trans(body_i_ptr->get_TBI());
+
+    bj1 = TBJI * bi1;
+    bj2 = TBJI * bi2;
+    update();
+}
+
+arma::vec6 Fixed_Joint::get_reference() const {
+    arma::vec6 Ref;
 
+    Ref.subvec(0, 2) = bj1;
+    Ref.subvec(3, 5) = bj2;
+    return Ref;
+}
 
+void Fixed_Joint::load_reference(const arma::vec6 &Ref_In) {
+    bj1 = Ref_In.subvec(0, 2);
+    bj2 = Ref_In.subvec(3, 5);
+    update();
+}
 
+void Fixed_Joint::Build_Rows() {
+    Spherical_Rows(0);
+    Dot_Row(3, ai, bj1);
+    Dot_Row(4, ai, bj2);
+    Dot_Row(5, bi1, bj2);
+}
 
+Universal_Joint::Universal_Joint(const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+            const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) :
+    Joint_Rows<4>(piIn, pjIn, qiIn, qjIn, i_In, j_In) {
+        ai = unit_axis(qi, X_AXIS, "universal qi");
+        aj = unit_axis(qj, Z_AXIS, "universal qj");
+        Set_Spherical_Identity(0);
+        update();
+}
 
+void Universal_Joint::Build_Rows() {
+    Spherical_Rows(0);
+    Dot_Row(3, ai, aj);
+}
 
+JointPtr make_joint(Joint_Type Type_In, const arma::vec &piIn, const arma::vec &pjIn, const arma::vec &qiIn,
+        const arma::vec &qjIn, BodyPtr i_In, BodyPtr j_In) {
+    return allocate_joint(std::allocator<Joint>(), Type_In, piIn, pjIn, qiIn, qjIn, i_In, j_In);
+}
@@ -1,5 +1,8 @@
 #include "Math.hpp"
 #include <algorithm>
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 #define PI 3.1415926536  ///< circumference of unit diameter circle
 #define EPS 1.e-10      ///< machine precision error (type double)
@@ -40,15 +43,27 @@ arma::mat skew_sym(arma::vec3 const &vec) {
     return std::move(RESULT);
 }
 
-void Matrix2Quaternion(arma::mat33 Matrix_in, arma::vec &Quaternion) {
+void skew_sym(arma::vec3 const &vec, arma::mat33 &Matrix_out) {
+    Matrix_out(0, 0) = 0.0;
+    Matrix_out(1, 0) = vec(2);
+    Matrix_out(2, 0) = -vec(1);
+    Matrix_out(0, 1) = -vec(2);
+    Matrix_out(1, 1) = 0.0;
+    Matrix_out(2, 1) = vec(0);
+    Matrix_out(0, 2) = vec(1);
+    Matrix_out(1, 2) = -vec(0);
+    Matrix_out(2, 2) = 0.0;
+}
+
+void Matrix2Quaternion(const arma::mat33 &Matrix_in, arma::vec &Quaternion) {
     arma::vec4 q_square;
     double q_square_max;
     int j;
-    Matrix_in = trans(Matrix_in);
-    q_square[0] = fabs(1.0 + Matrix_in(0, 0) + Matrix_in(1, 1) + Matrix_in(2, 2));
-    q_square[1] = fabs(1.0 + Matrix_in(0, 0) - Matrix_in(1, 1) - Matrix_in(2, 2));
-    q_square[2] = fabs(1.0 - Matrix_in(0, 0) + Matrix_in(1, 1) - Matrix_in(2, 2));
-    q_square[3] = fabs(1.0 - Matrix_in(0, 0) - Matrix_in(1, 1) + Matrix_in(2, 2));
+    const arma::mat33 T = trans(Matrix_in);
+    q_square[0] = fabs(1.0 + T(0, 0) + T(1, 1) + T(2, 2));
+    q_square[1] = fabs(1.0 + T(0, 0) - T(1, 1) - T(2, 2));
+    q_square[2] = fabs(1.0 - T(0, 0) + T(1, 1) - T(2, 2));
+    q_square[3] = fabs(1.0 - T(0, 0) - T(1, 1) + T(2, 2));
 
     q_square_max = q_square.max();
     j = q_square.index_max();
@@ -56,27 +71,27 @@ void Matrix2Quaternion(arma::mat33 Matrix_in, arma::vec &Quaternion) {
     switch (j) {
     case 0:
         Quaternion(0) = 0.5 * sqrt(q_square_max);
-        Quaternion(1) = 0.25 * (Matrix_in(2, 1) - Matrix_in(1, 2)) / Quaternion[0];
-        Quaternion(2) = 0.25 * (Matrix_in(0, 2) - Matrix_in(2, 0)) / Quaternion[0];
-        Quaternion(3) = 0.25 * (Matrix_in(1, 0) - Matrix_in(0, 1)) / Quaternion[0];
+        Quaternion(1) = 0.25 * (T(2, 1) - T(1, 2)) / Quaternion[0];
+        Quaternion(2) = 0.25 * (T(0, 2) - T(2, 0)) / Quaternion[0];
+        Quaternion(3) = 0.25 * (T(1, 0) - T(0, 1)) / Quaternion[0];
         break;
     case 1:
         Quaternion(1) = 0.5 * sqrt(q_square_max);
-        Quaternion(0) = 0.25 * (Matrix_in(2, 1) - Matrix_in(1, 2)) / Quaternion[1];
-        Quaternion(2) = 0.25 * (Matrix_in(1, 0) + Matrix_in(0, 1)) / Quaternion[1];
-        Quaternion(3) = 0.25 * (Matrix_in(0, 2) + Matrix_in(2, 0)) / Quaternion[1];
+        Quaternion(0) = 0.25 * (T(2, 1) - T(1, 2)) / Quaternion[1];
+        Quaternion(2) = 0.25 * (T(1, 0) + T(0, 1)) / Quaternion[1];
+        Quaternion(3) = 0.25 * (T(0, 2) + T(2, 0)) / Quaternion[1];
         break;
     case 2:
         Quaternion(2) = 0.5 * sqrt(q_square_max);
-        Quaternion(0) = 0.25 * (Matrix_in(0, 2) - Matrix_in(2, 0)) / Quaternion[2];
-        Quaternion(1) = 0.25 * (Matrix_in(1, 0) + Matrix_in(0, 1)) / Quaternion[2];
-        Quaternion(3) = 0.25 * (Matrix_in(2, 1) + Matrix_in(1, 2)) / Quaternion[2];
+        Quaternion(0) = 0.25 * (T(0, 2) - T(2, 0)) / Quaternion[2];
+        Quaternion(1) = 0.25 * (T(1, 0) + T(0, 1)) / Quaternion[2];
+        Quaternion(3) = 0.25 * (T(2, 1) + T(1, 2)) / Quaternion[2];
         break;
     case 3:
         Quaternion(3) = 0.5 * sqrt(q_square_max);
-        Quaternion(0) = 0.25 * (Matrix_in(1, 0) - Matrix_in(0, 1)) / Quaternion[3];
-        Quaternion(1) = 0.25 * (Matrix_in(2, 0) + Matrix_in(0, 2)) / Quaternion[3];
-        Quaternion(2) = 0.25 * (Matrix_in(2, 1) + Matrix_in(1, 2)) / Quaternion[3];
+        Quaternion(0) = 0.25 * (T(1, 0) - T(0, 1)) / Quaternion[3];
+        Quaternion(1) = 0.25 * (T(2, 0) + T(0, 2)) / Quaternion[3];
+        Quaternion(2) = 0.25 * (T(2, 1) + T(1, 2)) / Quaternion[3];
         break;
     }
 
@@ -156,4 +171,107 @@ int sign(const double &variable)
         sign = 1;
 
     return sign;
-}
\ No newline at end of file
+}
+/* Lane type of the batch kernels: only mul/add/sub and sign flips, so a
+   vector lane rounds like the uncontracted scalar expression it replaces */
+namespace {
+
+#if defined(__AVX512F__)
+struct Lane { __m512d v; };
+const unsigned int LANES = 8;
+inline Lane lane_load(const double *p) { return {_mm512_loadu_pd(p)}; }
+inline void lane_store(double *p, Lane a) { _mm512_storeu_pd(p, a.v); }
+inline Lane lane_set(double a) { return {_mm512_set1_pd(a)}; }
+inline Lane operator+(Lane a, Lane b) { return {_mm512_add_pd(a.v, b.v)}; }
+inline Lane operator-(Lane a, Lane b) { return {_mm512_sub_pd(a.v, b.v)}; }
+inline Lane operator*(Lane a, Lane b) { return {_mm512_mul_pd(a.v, b.v)}; }
+inline Lane operator-(Lane a) {
+    return {_mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a.v), _mm512_set1_epi64(0x8000000000000000LL)))};
+}
+#elif defined(__AVX__)
+struct Lane { __m256d v; };
+const unsigned int LANES = 4;
+inline Lane lane_load(const double *p) { return {_mm256_loadu_pd(p)}; }
+inline void lane_store(double *p, Lane a) { _mm256_storeu_pd(p, a.v); }
+inline Lane lane_set(double a) { return {_mm256_set1_pd(a)}; }
+inline Lane operator+(Lane a, Lane b) { return {_mm256_add_pd(a.v, b.v)}; }
+inline Lane operator-(Lane a, Lane b) { return {_mm256_sub_pd(a.v, b.v)}; }
+inline Lane operator*(Lane a, Lane b) { return {_mm256_mul_pd(a.v, b.v)}; }
+inline Lane operator-(Lane a) { return {_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0))}; }
+#else
+const unsigned int LANES = 1;  // scalar build: the tail loops do all the work
+#endif
+
+/* The formulas of Quaternion2Matrix() and Mobilized_body::update(), written once
+   for double and Lane */
+template <typename T>
+inline void quaternion2matrix_item(const T &q0, const T &q1, const T &q2, const T &q3, const T &one,
+        const T &two, T R[9]) {
+    R[0] = two * (q0 * q0 + q1 * q1) - one;
+    R[1] = two * (q1 * q2 + q0 * q3);
+    R[2] = two * (q1 * q3 - q0 * q2);
+    R[3] = two * (q1 * q2 - q0 * q3);
+    R[4] = two * (q0 * q0 + q2 * q2) - one;
+    R[5] = two * (q2 * q3 + q0 * q1);
+    R[6] = two * (q1 * q3 + q0 * q2);
+    R[7] = two * (q2 * q3 - q0 * q1);
+    R[8] = two * (q0 * q0 + q3 * q3) - one;
+}
+
+template <typename T>
+inline void quaternion_rate_item(const T q[4], const T w[3], const T &gain, const T &one, const T &half,
+        T qd[4]) {
+    T erq = one - (q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    T ge = gain * erq;
+
+    qd[0] = half * (-w[0] * q[1] - w[1] * q[2] - w[2] * q[3]) + ge * q[0];
+    qd[1] = half * (w[0] * q[0] + w[2] * q[2] - w[1] * q[3]) + ge * q[1];
+    qd[2] = half * (w[1] * q[0] - w[2] * q[1] + w[0] * q[3]) + ge * q[2];
+    qd[3] = half * (w[2] * q[0] + w[1] * q[1] - w[0] * q[2]) + ge * q[3];
+}
+
+}  // namespace
+
+void Quaternion2Matrix_batch(unsigned int n, const double *Q_In, double *R_Out, unsigned int ld) {
+    unsigned int i = 0;
+
+#if defined(__AVX512F__) || defined(__AVX__)
+    const Lane one = lane_set(1.0), two = lane_set(2.0);
+    Lane R[9];
+
+    for (; i + LANES <= n; i += LANES) {
+        quaternion2matrix_item(lane_load(Q_In + i), lane_load(Q_In + ld + i), lane_load(Q_In + 2 * ld + i),
+            lane_load(Q_In + 3 * ld + i), one, two, R);
+        for (unsigned int k = 0; k < 9; k++) lane_store(R_Out + k * ld + i, R[k]);
+    }
+#endif
+    double r[9];
+    for (; i < n; i++) {
+        quaternion2matrix_item(Q_In[i], Q_In[ld + i], Q_In[2 * ld + i], Q_In[3 * ld + i], 1.0, 2.0, r);
+        for (unsigned int k = 0; k < 9; k++) R_Out[k * ld + i] = r[k];
+    }
+}
+
+void quaternion_rate_batch(unsigned int n, const double *Q_In, const double *W_In, const double *Gain_In,
+        double *QD_Out, unsigned int ld) {
+    unsigned int i = 0;
+
+#if defined(__AVX512F__) || defined(__AVX__)
+    const Lane one = lane_set(1.0), half = lane_set(0.5);
+    Lane q[4], w[3], qd[4];
+
+    for (; i + LANES <= n; i += LANES) {
+        for (unsigned int k = 0; k < 4; k++) q[k] = lane_load(Q_In + k * ld + i);
+        for (unsigned int k = 0; k < 3; k++) w[k] = lane_load(W_In + k * ld + i);
+        quaternion_rate_item(q, w, lane_load(Gain_In + i), one, half, qd);
+        for (unsigned int k = 0; k < 4; k++) lane_store(QD_Out + k * ld + i, qd[k]);
+    }
+#endif
+    double qs[4], ws[3], qds[4];
+    for (; i < n; i++) {
+        for (unsigned int k = 0; k < 4; k++) qs[k] = Q_In[k * ld + i];
+        for (unsigned int k = 0; k < 3; k++) ws[k] = W_In[k * ld + i];
+        quaternion_rate_item(qs, ws, Gain_In[i], 1.0, 0.5, qds);
+        for (unsigned int k = 0; k < 4; k++) QD_Out[k * ld + i] = qds[k];
+    }
+}
@@ -0,0 +1,32 @@
+#include "Object_Pool.hpp"
+#include <algorithm>
+#include <cstdint>
+
+const std::size_t Object_Arena::BLOCK_BYTES;
+
+/* Objects larger than a block get a block of their own */
+void *Object_Arena::allocate(std::size_t bytes_In, std::size_t align_In) {
+    std::size_t start = 0;
+
+    if (!blocks.empty()) {
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(blocks.back().get());
+        start = (base + used + align_In - 1) / align_In * align_In - base;
+    }
+    if (blocks.empty() || start + bytes_In > block_bytes.back()) {
+        std::size_t size = std::max(BLOCK_BYTES, bytes_In + align_In);
+
+        blocks.push_back(std::unique_ptr<char[]>(new char[size]));
+        block_bytes.push_back(size);
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(blocks.back().get());
+        start = (base + align_In - 1) / align_In * align_In - base;
+    }
+    used = start + bytes_In;
+    return blocks.back().get() + start;
+}
+
+std::size_t Object_Arena::get_bytes() const {
+    std::size_t total = 0;
+
+    for (unsigned int i = 0; i < block_bytes.size(); i++) total += block_bytes[i];
+    return total;
+}
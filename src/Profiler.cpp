@@ -0,0 +1,147 @@
+#include "Profiler.hpp"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+const char *PHASE_NAME[PROF_N_PHASE] = {"solve", "body_update", "joint_update", "constraints", "linear_solve",
+    "projection"};
+}
+
+Profiler::Profiler() {
+    summary_every = 0;
+    cond_every = 100;
+    trace_capacity = 0;
+    reset();
+}
+
+bool Profiler::enabled() {
+#ifdef MBD_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Profiler::begin(Prof_Phase phase_In) { start[phase_In] = Clock::now(); }
+
+void Profiler::end(Prof_Phase phase_In) {
+    Clock::time_point now = Clock::now();
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start[phase_In]).count();
+
+    total_ns[phase_In] += ns;
+    calls[phase_In]++;
+    if (trace.size() < trace_capacity) {
+        Trace_Event ev;
+        ev.phase = phase_In;
+        ev.begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start[phase_In] - origin).count();
+        ev.dur_ns = ns;
+        trace.push_back(ev);
+    }
+}
+
+/* Called once per solve(); drift is the norm of the constraint violation SYS_C */
+void Profiler::end_step(unsigned int kkt_dim_In, double drift_In) {
+    steps++;
+    kkt_dim = kkt_dim_In;
+    drift = drift_In;
+    if (drift > max_drift) max_drift = drift;
+    if (summary_every > 0 && steps % summary_every == 0) print_summary(std::cerr);
+}
+
+void Profiler::set_cond(double cond_In) { cond = cond_In; }
+
+void Profiler::add_iterations(unsigned int iter_In, double residual_In, bool converged_In) {
+    iter_solves++;
+    if (!converged_In) iter_fails++;
+    iterations += iter_In;
+    residual = residual_In;
+    if (residual > max_residual) max_residual = residual;
+}
+
+/* 0 turns the periodic summary off */
+void Profiler::set_summary_every(unsigned long steps_In) { summary_every = steps_In; }
+
+/* The condition estimate costs about one extra solve, so it is sampled */
+void Profiler::set_cond_every(unsigned long steps_In) { cond_every = steps_In; }
+
+/* Reserves room for events_In timeline events for write_chrome_trace() */
+void Profiler::set_trace_capacity(unsigned long events_In) {
+    trace_capacity = events_In;
+    trace.reserve(events_In);
+}
+
+bool Profiler::cond_due() const { return cond_every > 0 && steps % cond_every == 0; }
+
+double Profiler::get_time(Prof_Phase phase_In) const { return total_ns[phase_In] * 1e-9; }
+unsigned long Profiler::get_calls(Prof_Phase phase_In) const { return calls[phase_In]; }
+unsigned long Profiler::get_steps() const { return steps; }
+unsigned int Profiler::get_kkt_dim() const { return kkt_dim; }
+double Profiler::get_cond() const { return cond; }
+double Profiler::get_drift() const { return drift; }
+double Profiler::get_max_drift() const { return max_drift; }
+unsigned long Profiler::get_iter_solves() const { return iter_solves; }
+unsigned long Profiler::get_iter_fails() const { return iter_fails; }
+unsigned long Profiler::get_iterations() const { return iterations; }
+double Profiler::get_residual() const { return residual; }
+double Profiler::get_max_residual() const { return max_residual; }
+
+void Profiler::reset() {
+    origin = Clock::now();
+    for (unsigned int k = 0; k < PROF_N_PHASE; k++) {
+        total_ns[k] = 0;
+        calls[k] = 0;
+    }
+    steps = 0;
+    kkt_dim = 0;
+    cond = 0.0;
+    drift = 0.0;
+    max_drift = 0.0;
+    iter_solves = 0;
+    iter_fails = 0;
+    iterations = 0;
+    residual = 0.0;
+    max_residual = 0.0;
+    trace.clear();
+}
+
+void Profiler::print_summary(std::ostream &out_In) const {
+    double step_time = get_time(PROF_STEP);
+    std::streamsize old_precision = out_In.precision(3);
+
+    out_In << "Profiler: " << steps << " steps, KKT " << kkt_dim << " x " << kkt_dim
+           << ", cond " << cond << ", drift " << drift << " (max " << max_drift << ")\n";
+    if (iter_solves > 0) {
+        out_In << "  iterative: " << iter_solves << " solves, " << static_cast<double>(iterations) / iter_solves
+               << " iterations per solve, " << iter_fails << " unconverged, residual " << residual << " (max "
+               << max_residual << ")\n";
+    }
+    for (unsigned int k = 0; k < PROF_N_PHASE; k++) {
+        out_In << "  " << std::left << std::setw(14) << PHASE_NAME[k] << std::right
+               << std::setw(10) << calls[k] << " calls " << std::setw(10) << get_time(static_cast<Prof_Phase>(k)) << " s";
+        if (k > PROF_STEP && step_time > 0.0) {
+            out_In << std::setw(8) << 100.0 * get_time(static_cast<Prof_Phase>(k)) / step_time << " %";
+        }
+        out_In << '\n';
+    }
+    out_In.precision(old_precision);
+}
+
+/* Chrome trace event format, viewable in chrome://tracing or Perfetto */
+bool Profiler::write_chrome_trace(const std::string &file_In) const {
+    std::ofstream fout(file_In);
+
+    if (!fout) {
+        std::cerr << "Profiler: cannot open " << file_In << std::endl;
+        return false;
+    }
+    fout << "{\"traceEvents\":[";
+    fout << std::fixed << std::setprecision(3);
+    for (unsigned long k = 0; k < trace.size(); k++) {
+        if (k > 0) fout << ',';
+        fout << "\n{\"name\":\"" << PHASE_NAME[trace[k].phase] << "\",\"cat\":\"mbd\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+             << trace[k].begin_ns * 1e-3 << ",\"dur\":" << trace[k].dur_ns * 1e-3 << '}';
+    }
+    fout << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
@@ -0,0 +1,218 @@
+#include "Realtime_Runner.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <thread>
+
+namespace {
+
+const unsigned int FRESH_BIT = 4;
+const double COST_DECAY = 0.05;  // pull of a faster step on the level estimate
+const double COST_FORGET = 0.01;  // per-step decay of levels not run, so they are retried
+
+double seconds(std::chrono::steady_clock::duration d_In) {
+    return std::chrono::duration<double>(d_In).count();
+}
+
+}  // namespace
+
+Input_Mailbox::Input_Mailbox() : middle(1) {
+    back = 0;
+    front = 2;
+}
+
+void Input_Mailbox::init(unsigned int nbody_In) {
+    Load_Input zero = {{0., 0., 0.}, {0., 0., 0.}};
+
+    staged.assign(nbody_In, zero);
+    for (unsigned int k = 0; k < 3; k++) slot[k].assign(nbody_In, zero);
+    back = 0;
+    front = 2;
+    middle.store(1);
+}
+
+void Input_Mailbox::post(unsigned int body_In, const arma::vec &force_In, const arma::vec &torque_In) {
+    if (body_In >= staged.size()) return;
+    for (unsigned int k = 0; k < 3; k++) {
+        staged[body_In].force[k] = force_In(k);
+        staged[body_In].torque[k] = torque_In(k);
+    }
+}
+
+/* The filled back slot becomes the middle one, the old middle the new back */
+void Input_Mailbox::publish() {
+    std::copy(staged.begin(), staged.end(), slot[back].begin());
+    back = middle.exchange(back | FRESH_BIT, std::memory_order_acq_rel) & ~FRESH_BIT;
+}
+
+const Load_Input *Input_Mailbox::take(bool &fresh_Out) {
+    fresh_Out = (middle.load(std::memory_order_relaxed) & FRESH_BIT) != 0;
+    if (fresh_Out) front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH_BIT;
+    return slot[front].data();
+}
+
+Realtime_Runner::Realtime_Runner(Dynamics_Sys &sys_In, double period_In) : sys(sys_In), stop_flag(false) {
+    Load_Input load;
+
+    period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period_In));
+    policy = RT_CATCH_UP;
+    degrade = true;
+    max_frozen = 8;
+    frozen_run = 0;
+    spin = std::chrono::duration_cast<Clock::duration>(std::chrono::microseconds(50));
+    for (unsigned int l = 0; l < 3; l++) level_cost[l] = 0.0;
+
+    for (unsigned int i = 0; i < sys.get_nbody(); i++) {
+        for (unsigned int k = 0; k < 3; k++) {
+            load.force[k] = sys.get_body(i)->get_FORCE()(k);
+            load.torque[k] = sys.get_body(i)->get_APPLIED_TORQUE()(k);
+        }
+        base.push_back(load);
+    }
+    mailbox.init(sys.get_nbody());
+    stats.bin = 1e-5;
+    stats.jitter_hist.assign(100, 0);
+    stats.exec_hist.assign(100, 0);
+    reset_stats();
+}
+
+void Realtime_Runner::set_overrun(RT_Overrun policy_In) { policy = policy_In; }
+
+/* nbins_In bins of bin_In seconds; clears the histograms */
+void Realtime_Runner::set_histogram(double bin_In, unsigned int nbins_In) {
+    stats.bin = bin_In;
+    stats.jitter_hist.assign(nbins_In < 1 ? 1 : nbins_In, 0);
+    stats.exec_hist.assign(nbins_In < 1 ? 1 : nbins_In, 0);
+}
+
+void Realtime_Runner::set_degrade(bool allowed_In, unsigned int max_frozen_In) {
+    degrade = allowed_In;
+    max_frozen = max_frozen_In;
+}
+
+void Realtime_Runner::set_spin(double spin_In) {
+    spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spin_In));
+}
+
+Input_Mailbox &Realtime_Runner::get_mailbox() { return mailbox; }
+void Realtime_Runner::stop() { stop_flag.store(true, std::memory_order_relaxed); }
+const RT_Stats &Realtime_Runner::get_stats() const { return stats; }
+
+void Realtime_Runner::reset_stats() {
+    stats.steps = 0;
+    stats.overruns = 0;
+    stats.skipped = 0;
+    stats.degraded = 0;
+    stats.frozen = 0;
+    stats.max_jitter = 0.0;
+    stats.sum_jitter = 0.0;
+    stats.max_exec = 0.0;
+    stats.sum_exec = 0.0;
+    std::fill(stats.jitter_hist.begin(), stats.jitter_hist.end(), 0);
+    std::fill(stats.exec_hist.begin(), stats.exec_hist.end(), 0);
+}
+
+/* Releases are on a fixed grid from the first step, so lateness does not accumulate */
+unsigned long Realtime_Runner::run(unsigned long nsteps_In) {
+    unsigned long n = 0;
+    unsigned int level;
+    Clock::time_point release = Clock::now();
+    Clock::time_point start, end, deadline;
+
+    while ((nsteps_In == 0 || n < nsteps_In) && !stop_flag.load(std::memory_order_relaxed)) {
+        if (release - Clock::now() > spin) std::this_thread::sleep_until(release - spin);
+        while ((start = Clock::now()) < release) {}
+        deadline = release + period;
+
+        level = degrade ? Choose_Level(seconds(deadline - start)) : 0;
+        if (level == 2 && frozen_run >= max_frozen) level = 1;
+        sys.set_degraded(level == 2, level >= 1);
+        Apply_Inputs();
+        if (!sys.solve()) break;  // integrator failure, Dynamics_Sys::get_failed()
+        end = Clock::now();
+
+        /* Peak-hold cost per level; the levels not run slowly forget theirs */
+        double exec = seconds(end - start);
+        for (unsigned int l = 0; l < 3; l++) {
+            if (l != level) {
+                level_cost[l] -= COST_FORGET * level_cost[l];
+            } else if (exec > level_cost[l]) {
+                level_cost[l] = exec;
+            } else {
+                level_cost[l] += COST_DECAY * (exec - level_cost[l]);
+            }
+        }
+        frozen_run = (level == 2) ? frozen_run + 1 : 0;
+        if (level >= 1) stats.degraded++;
+        if (level == 2) stats.frozen++;
+        if (end > deadline) stats.overruns++;
+        Record(seconds(start - release), exec);
+        n++;
+
+        release = deadline;
+        if (policy == RT_SKIP && end > release) {
+            Clock::duration::rep missed = (end - release) / period + 1;
+            release += missed * period;
+            stats.skipped += missed;
+        }
+    }
+    sys.set_degraded(false, false);
+    return n;
+}
+
+/* Cheapest level whose recent cost fits the time left; unmeasured levels cost 0 */
+unsigned int Realtime_Runner::Choose_Level(double remaining_In) const {
+    for (unsigned int l = 0; l < 2; l++) {
+        if (level_cost[l] <= remaining_In) return l;
+    }
+    return 2;
+}
+
+/* Newly published loads on top of the ones the bodies were built with; the ground is skipped */
+void Realtime_Runner::Apply_Inputs() {
+    bool fresh;
+    const Load_Input *in = mailbox.take(fresh);
+    arma::vec3 F, T;
+
+    if (!fresh) return;
+    for (unsigned int i = 0; i < base.size(); i++) {
+        const BodyPtr &b = sys.get_body(i);
+        if (b->get_type() == 0) continue;
+        for (unsigned int k = 0; k < 3; k++) {
+            F(k) = base[i].force[k] + in[i].force[k];
+            T(k) = base[i].torque[k] + in[i].torque[k];
+        }
+        b->set_FORCE(F);
+        b->set_APPLIED_TORQUE(T);
+    }
+}
+
+void Realtime_Runner::Record(double jitter_In, double exec_In) {
+    unsigned int last = stats.jitter_hist.size() - 1;
+    unsigned int bj = static_cast<unsigned int>(std::min<double>(last, jitter_In / stats.bin));
+    unsigned int be = static_cast<unsigned int>(std::min<double>(last, exec_In / stats.bin));
+
+    stats.steps++;
+    stats.sum_jitter += jitter_In;
+    stats.sum_exec += exec_In;
+    if (jitter_In > stats.max_jitter) stats.max_jitter = jitter_In;
+    if (exec_In > stats.max_exec) stats.max_exec = exec_In;
+    stats.jitter_hist[bj]++;
+    stats.exec_hist[be]++;
+}
+
+void Realtime_Runner::print_report(std::ostream &out_In) const {
+    double mean = stats.steps > 0 ? 1.0 / stats.steps : 0.0;
+    std::streamsize old_precision = out_In.precision(3);
+
+    out_In << "Realtime_Runner: " << stats.steps << " steps, " << stats.overruns << " overruns, " << stats.skipped
+           << " skipped periods, " << stats.degraded << " degraded (" << stats.frozen << " on old factors)\n";
+    out_In << "  jitter mean " << 1e6 * stats.sum_jitter * mean << " us, max " << 1e6 * stats.max_jitter << " us\n";
+    out_In << "  solve  mean " << 1e6 * stats.sum_exec * mean << " us, max " << 1e6 * stats.max_exec << " us\n";
+    out_In << "  " << std::setw(10) << "bin [us]" << std::setw(10) << "jitter" << std::setw(10) << "solve" << '\n';
+    for (unsigned int k = 0; k < stats.jitter_hist.size(); k++) {
+        if (stats.jitter_hist[k] == 0 && stats.exec_hist[k] == 0) continue;
+        out_In << "  " << std::setw(10) << 1e6 * stats.bin * k << std::setw(10) << stats.jitter_hist[k]
+               << std::setw(10) << stats.exec_hist[k] << (k + 1 == stats.jitter_hist.size() ? " +" : "") << '\n';
+    }
+    out_In.precision(old_precision);
+}
@@ -0,0 +1,370 @@
+#include "Scene_Loader.hpp"
+#include "Checkpoint.hpp"
+#include <boost/make_shared.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(Scene_Cache_Header) == 56, "scene cache header must stay 56 bytes");
+static_assert(sizeof(Scene_Force) == 88, "scene force record must stay 88 bytes");
+
+namespace {
+
+typedef boost::property_tree::ptree Tree;
+
+const uint32_t CACHE_VERSION = 2;
+
+/* Number or bool at key_In, or Default_In when absent. ptree's own
+   get(key, default) also falls back to the default on a malformed value, and
+   its unsigned conversion wraps a leading minus */
+template <typename T>
+bool get_scalar(const Tree &t_In, const char *key_In, T &Out, const T &Default_In) {
+    boost::optional<const Tree &> child = t_In.get_child_optional(key_In);
+    boost::optional<T> x;
+
+    Out = Default_In;
+    if (!child) return true;
+    if (child->empty()) x = child->get_value_optional<T>();
+    if (!x || (std::is_unsigned<T>::value && child->data().find('-') != std::string::npos)) {
+        std::cerr << "Scene_Loader: bad value '" << child->data() << "' for " << key_In << std::endl;
+        return false;
+    }
+    Out = *x;
+    return true;
+}
+
+/* JSON array of n_In numbers at key_In; Out is left alone when absent */
+bool get_numbers(const Tree &t_In, const char *key_In, double *Out, unsigned int n_In) {
+    boost::optional<const Tree &> child = t_In.get_child_optional(key_In);
+    boost::optional<double> x;
+    unsigned int k = 0;
+
+    if (!child) return true;
+    for (const Tree::value_type &item : *child) {
+        if (k == n_In || !item.second.empty() || !(x = item.second.get_value_optional<double>())) break;
+        Out[k++] = *x;
+    }
+    if (k != n_In || child->size() != n_In) {
+        std::cerr << "Scene_Loader: '" << key_In << "' needs " << n_In << " numbers" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* JSON array of 3 numbers at key_In, or Default_In when absent */
+bool get_vec3(const Tree &t_In, const char *key_In, arma::vec3 &Out, const arma::vec3 &Default_In) {
+    Out = Default_In;
+    return get_numbers(t_In, key_In, Out.memptr(), 3);
+}
+
+/* A body given by name or by its index in "bodies" */
+bool get_body(const Tree &t_In, const char *key_In, const std::map<std::string, unsigned int> &names_In,
+        unsigned int nbody_In, unsigned int &Out) {
+    std::string ref = t_In.get<std::string>(key_In, "");
+    std::map<std::string, unsigned int>::const_iterator it = names_In.find(ref);
+    char *end = nullptr;
+
+    if (it != names_In.end()) {
+        Out = it->second;
+        return true;
+    }
+    unsigned long idx = std::strtoul(ref.c_str(), &end, 10);
+    if (!ref.empty() && *end == '\0' && idx < nbody_In) {
+        Out = idx;
+        return true;
+    }
+    std::cerr << "Scene_Loader: unknown body '" << ref << "' in " << key_In << std::endl;
+    return false;
+}
+
+template <typename Enum>
+bool get_enum(const Tree &t_In, const char *key_In, const char *const *names_In, unsigned int n_In,
+        Enum &Out) {
+    boost::optional<std::string> name = t_In.get_optional<std::string>(key_In);
+
+    if (!name) return true;
+    for (unsigned int k = 0; k < n_In; k++) {
+        if (*name == names_In[k]) {
+            Out = static_cast<Enum>(k);
+            return true;
+        }
+    }
+    std::cerr << "Scene_Loader: unknown " << key_In << " '" << *name << "'" << std::endl;
+    return false;
+}
+
+/* Names in enum order */
+const char *const SOLVER_NAME[] = {"dense", "sparse", "tree", "schur", "iterative"};
+const char *const INTEGRATOR_NAME[] = {"rk4", "dopri45", "implicit_euler"};
+const char *const JOINT_NAME[] = {"spherical", "revolute", "prismatic", "fixed", "universal"};
+const char *const FORCE_NAME[] = {"gravity", "spring"};
+
+}  // namespace
+
+/* A missing, stale or unreadable cache is rebuilt from the scene */
+DynSysPtr Scene_Loader::load(const std::string &file_In, const std::string &cache_In) {
+    std::ifstream fin(file_In, std::ios::binary);
+    std::stringstream text;
+    std::vector<Scene_Force> forces;
+    unsigned int threads, min_bodies;
+
+    if (!fin) {
+        std::cerr << "Scene_Loader: cannot open " << file_In << std::endl;
+        return DynSysPtr();
+    }
+    text << fin.rdbuf();
+    const std::string source = text.str();
+    const uint64_t hash = Checkpoint::hash(source.data(), source.size());
+
+    if (!cache_In.empty()) {
+        DynSysPtr cached = Read_Cache(cache_In, hash, source.size());
+        if (cached) return cached;
+    }
+
+    DynSysPtr sys = Build(source, forces, threads, min_bodies);
+    if (sys && !cache_In.empty()) Write_Cache(cache_In, *sys, hash, source.size(), forces, threads, min_bodies);
+    return sys;
+}
+
+DynSysPtr Scene_Loader::parse(const std::string &text_In) {
+    std::vector<Scene_Force> forces;
+    unsigned int threads, min_bodies;
+
+    return Build(text_In, forces, threads, min_bodies);
+}
+
+DynSysPtr Scene_Loader::Build(const std::string &text_In, std::vector<Scene_Force> &forces_Out,
+        unsigned int &threads_Out, unsigned int &min_bodies_Out) {
+    Tree root;
+    std::istringstream in(text_In);
+    std::map<std::string, unsigned int> names;
+    std::vector<BodyPtr> bodies;
+    const arma::vec3 zero(arma::fill::zeros);
+    const arma::vec3 one = {1.0, 1.0, 1.0};
+    arma::vec3 pos, vel, acc, ang, ang_vel, ang_acc, inertia, force, torque, pi, pj, qi, qj;
+    Solver_Type solver = DENSE_SOLVER;
+    Integrator_Type integrator = RK4_INTEGRATOR;
+    Joint_Type jtype;
+    unsigned int force_type, bi, bj;
+    double dt, mass, quat_gain;
+
+    try {
+        boost::property_tree::read_json(in, root);
+    } catch (const boost::property_tree::json_parser_error &e) {
+        std::cerr << "Scene_Loader: " << e.what() << std::endl;
+        return DynSysPtr();
+    }
+
+    if (!get_scalar(root, "dt", dt, 0.001)) return DynSysPtr();
+    if (!(dt > 0.0)) {
+        std::cerr << "Scene_Loader: dt must be positive" << std::endl;
+        return DynSysPtr();
+    }
+    DynSysPtr sys = boost::make_shared<Dynamics_Sys>(dt);
+    boost::optional<Tree &> body_list = root.get_child_optional("bodies");
+    if (!body_list || body_list->empty()) {
+        std::cerr << "Scene_Loader: no bodies" << std::endl;
+        return DynSysPtr();
+    }
+
+    /* Body numbers follow the file order; the first body defaults to a ground */
+    for (const Tree::value_type &item : *body_list) {
+        const Tree &b = item.second;
+        unsigned int num = bodies.size();
+        std::string type = b.get<std::string>("type", num == 0 ? "ground" : "mobilized");
+        bool ground = type == "ground";
+
+        if (!ground && type != "mobilized") {
+            std::cerr << "Scene_Loader: unknown body type '" << type << "'" << std::endl;
+            return DynSysPtr();
+        }
+        if (!get_vec3(b, "position", pos, zero) || !get_vec3(b, "velocity", vel, zero)
+            || !get_vec3(b, "acceleration", acc, zero) || !get_vec3(b, "angle", ang, zero)
+            || !get_vec3(b, "angular_velocity", ang_vel, zero) || !get_vec3(b, "angular_acceleration", ang_acc, zero)
+            || !get_vec3(b, "inertia", inertia, one) || !get_vec3(b, "force", force, zero)
+            || !get_vec3(b, "torque", torque, zero) || !get_scalar(b, "mass", mass, 1.0)) return DynSysPtr();
+
+        if (ground && (b.count("position") || b.count("angle"))) {
+            bodies.push_back(sys->Create<Ground>(num, pos, ang));
+        } else if (ground) {
+            bodies.push_back(sys->Create<Ground>(num));
+        } else {
+            bodies.push_back(sys->Create<Mobilized_body>(num, pos, vel, acc, ang, ang_vel, ang_acc,
+                mass, inertia, force, torque));
+            if (!get_scalar(b, "quat_gain", quat_gain, bodies.back()->get_quat_gain())) return DynSysPtr();
+            bodies.back()->set_quat_gain(quat_gain);
+        }
+        std::string name = b.get<std::string>("name", "");
+        if (!name.empty() && !names.insert(std::make_pair(name, num)).second) {
+            std::cerr << "Scene_Loader: body name '" << name << "' used twice" << std::endl;
+            return DynSysPtr();
+        }
+    }
+
+    boost::optional<Tree &> joint_list = root.get_child_optional("joints");
+    for (const Tree::value_type &item : joint_list ? *joint_list : Tree()) {
+        const Tree &j = item.second;
+
+        jtype = SPHERICAL_JOINT;
+        if (!get_enum(j, "type", JOINT_NAME, 5, jtype) || !get_body(j, "body_i", names, bodies.size(), bi)
+            || !get_body(j, "body_j", names, bodies.size(), bj) || !get_vec3(j, "pi", pi, zero)
+            || !get_vec3(j, "pj", pj, zero) || !get_vec3(j, "qi", qi, zero)
+            || !get_vec3(j, "qj", qj, zero)) return DynSysPtr();
+        sys->Create_Joint(jtype, pi, pj, qi, qj, bodies[bi], bodies[bj]);
+    }
+
+    forces_Out.clear();
+    boost::optional<Tree &> force_list = root.get_child_optional("forces");
+    for (const Tree::value_type &item : force_list ? *force_list : Tree()) {
+        const Tree &f = item.second;
+        Scene_Force rec;
+
+        std::memset(&rec, 0, sizeof(rec));
+        force_type = 0;
+        if (!get_enum(f, "type", FORCE_NAME, 2, force_type)) return DynSysPtr();
+        rec.type = force_type;
+        if (rec.type == 0) {
+            if (!get_vec3(f, "g", pi, zero)) return DynSysPtr();
+            pj = zero;
+        } else {
+            if (!get_body(f, "body_i", names, bodies.size(), bi) || !get_body(f, "body_j", names, bodies.size(), bj)
+                || !get_vec3(f, "pi", pi, zero) || !get_vec3(f, "pj", pj, zero) || !get_scalar(f, "k", rec.k, 0.0)
+                || !get_scalar(f, "c", rec.c, 0.0) || !get_scalar(f, "length", rec.L0, 0.0)) return DynSysPtr();
+            rec.body_i = bi;
+            rec.body_j = bj;
+        }
+        for (unsigned int k = 0; k < 3; k++) {
+            rec.a[k] = pi(k);
+            rec.b[k] = pj(k);
+        }
+        forces_Out.push_back(rec);
+    }
+
+    /* Settings are all read before any is applied, in the order main.cpp
+       uses them: solver, Assembly(), init(), integrator */
+    const Tree none;
+    const Tree &proj = root.get_child("projection", none);
+    const Tree &iter = root.get_child("iterative", none);
+    bool assemble, proj_position, proj_velocity;
+    double tol[2], baum[2], max_step, proj_tol, iter_tol;
+    unsigned int proj_max_iter, iter_max_iter;
+
+    if (!get_enum(root, "solver", SOLVER_NAME, 5, solver)
+        || !get_enum(root, "integrator", INTEGRATOR_NAME, 3, integrator)
+        || !get_scalar(root, "assemble", assemble, true) || !get_numbers(root, "tolerance", tol, 2)
+        || !get_scalar(root, "max_step", max_step, 0.0) || !get_numbers(root, "baumgarte", baum, 2)
+        || !get_scalar(proj, "position", proj_position, false) || !get_scalar(proj, "velocity", proj_velocity, false)
+        || !get_scalar(proj, "tol", proj_tol, 1e-10) || !get_scalar(proj, "max_iter", proj_max_iter, 3u)
+        || !get_scalar(iter, "tol", iter_tol, 1e-10) || !get_scalar(iter, "max_iter", iter_max_iter, 0u)
+        || !get_scalar(root, "threads", threads_Out, 0u)
+        || !get_scalar(root, "parallel_min_bodies", min_bodies_Out, 512u)) return DynSysPtr();
+
+    sys->set_solver(solver);
+    if (assemble) sys->Assembly();
+    sys->init();
+    if (integrator != RK4_INTEGRATOR) sys->set_integrator(integrator);
+    if (root.count("tolerance")) sys->set_tolerance(tol[0], tol[1]);
+    sys->set_max_step(max_step);
+    if (root.count("baumgarte")) sys->set_baumgarte(baum[0], baum[1]);
+    if (root.count("projection")) sys->set_projection(proj_position, proj_velocity, proj_tol, proj_max_iter);
+    if (root.count("iterative")) sys->set_iterative(iter_tol, iter_max_iter);
+    if (threads_Out > 0) sys->set_threads(threads_Out, min_bodies_Out);
+
+    Add_Forces(*sys, forces_Out);
+    return sys;
+}
+
+void Scene_Loader::Add_Forces(Dynamics_Sys &sys_In, const std::vector<Scene_Force> &forces_In) {
+    for (unsigned int i = 0; i < forces_In.size(); i++) {
+        const Scene_Force &f = forces_In[i];
+        arma::vec3 a = {f.a[0], f.a[1], f.a[2]};
+        arma::vec3 b = {f.b[0], f.b[1], f.b[2]};
+
+        if (f.type == 0) {
+            sys_In.Create<Gravity_Field>(a);
+        } else {
+            sys_In.Create<Spring_Damper>(sys_In.get_body(f.body_i), sys_In.get_body(f.body_j),
+                a, b, f.k, f.c, f.L0);
+        }
+    }
+}
+
+/* Maps the cache read-only and restores the system straight from the mapping */
+DynSysPtr Scene_Loader::Read_Cache(const std::string &cache_In, uint64_t hash_In, uint64_t bytes_In) {
+    Scene_Cache_Header header;
+    struct stat st;
+    DynSysPtr sys;
+    std::vector<Scene_Force> forces;
+
+    int fd = ::open(cache_In.c_str(), O_RDONLY);
+    if (fd < 0) return DynSysPtr();
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(header))) {
+        ::close(fd);
+        return DynSysPtr();
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return DynSysPtr();
+
+    const char *p = static_cast<const char *>(map);
+    std::memcpy(&header, p, sizeof(header));
+    uint64_t expect = sizeof(header) + header.nforce * sizeof(Scene_Force) + header.ckpt_bytes;
+    if (std::memcmp(header.magic, "MBDSCNC", 8) != 0 || header.version != CACHE_VERSION
+        || header.source_hash != hash_In || header.source_bytes != bytes_In
+        || expect != static_cast<uint64_t>(st.st_size)) {
+        std::cerr << "Scene_Loader: cache " << cache_In << " is stale, rebuilding" << std::endl;
+    } else {
+        p += sizeof(header);
+        forces.resize(header.nforce);
+        if (header.nforce > 0) std::memcpy(forces.data(), p, header.nforce * sizeof(Scene_Force));
+        p += header.nforce * sizeof(Scene_Force);
+        sys = Checkpoint::restore(p, header.ckpt_bytes);
+        if (sys) {
+            if (header.threads > 0) sys->set_threads(header.threads, header.par_min_bodies);
+            Add_Forces(*sys, forces);
+        }
+    }
+    munmap(map, st.st_size);
+    return sys;
+}
+
+bool Scene_Loader::Write_Cache(const std::string &cache_In, const Dynamics_Sys &sys_In, uint64_t hash_In,
+        uint64_t bytes_In, const std::vector<Scene_Force> &forces_In, unsigned int threads_In,
+        unsigned int min_bodies_In) {
+    Scene_Cache_Header header;
+    std::vector<char> ckpt;
+
+    if (!Checkpoint::save(sys_In, ckpt, true)) return false;
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "MBDSCNC", 8);
+    header.version = CACHE_VERSION;
+    header.nforce = forces_In.size();
+    header.source_hash = hash_In;
+    header.source_bytes = bytes_In;
+    header.threads = threads_In;
+    header.par_min_bodies = min_bodies_In;
+    header.ckpt_bytes = ckpt.size();
+
+    std::ofstream fout(cache_In, std::ios::binary | std::ios::trunc);
+    fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!forces_In.empty()) {
+        fout.write(reinterpret_cast<const char *>(forces_In.data()), forces_In.size() * sizeof(Scene_Force));
+    }
+    fout.write(ckpt.data(), ckpt.size());
+    if (!fout) {
+        std::cerr << "Scene_Loader: cannot write cache " << cache_In << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,374 @@
+#include "Schur_Solver.hpp"
+#include <algorithm>
+#include <cmath>
+
+Schur_Solver::Schur_Solver() : ground_Cq(arma::fill::eye) {
+    nbody = 0;
+    ncons = 0;
+    kd = 0;
+    iterative = false;
+    cg_tol = 1e-10;
+    cg_max_iter = 0;
+    cg_iter = 0;
+    cg_res = 0.0;
+}
+
+double &Schur_Solver::band(unsigned int i, unsigned int j) { return S[j * (kd + 1) + (i - j)]; }
+
+/* Inverts the (constant) mass blocks, groups the constraint blocks by the
+   body they act on and sizes the band from the rows sharing a body */
+void Schur_Solver::build(std::vector<BodyPtr> &Body_In, std::vector<JointPtr> &Joint_In,
+        const std::vector<unsigned int> &joint_row_In, const std::vector<unsigned int> &ground_In,
+        const std::vector<unsigned int> &ground_row_In, unsigned int ncons_In) {
+    unsigned int b, lo, hi, off;
+    std::vector<unsigned int> count;
+    Incidence tmp = Incidence();
+
+    nbody = Body_In.size();
+    ncons = ncons_In;
+
+    /* Ground bodies are held by identity rows, their KKT mass blocks are I as well */
+    Minv.assign(nbody, arma::mat66(arma::fill::eye));
+    for (unsigned int i = 0; i < nbody; i++) {
+        if (Body_In[i]->get_type() != 0) Minv[i] = arma::inv(Body_In[i]->get_M());
+    }
+
+    count.assign(nbody + 1, 0);
+    for (unsigned int g = 0; g < ground_In.size(); g++) count[ground_In[g] + 1]++;
+    for (unsigned int i = 0; i < Joint_In.size(); i++) {
+        count[Joint_In[i]->get_body_i_ptr()->get_num() + 1]++;
+        count[Joint_In[i]->get_body_j_ptr()->get_num() + 1]++;
+    }
+    for (unsigned int i = 0; i < nbody; i++) count[i + 1] += count[i];
+    inc_ptr = count;
+    inc.assign(count[nbody], tmp);
+
+    blk_row.clear();
+    blk_dim.clear();
+    blk_off.clear();
+    off = 0;
+    tmp.dim = 6;
+    tmp.Cq = ground_Cq.memptr();
+    for (unsigned int g = 0; g < ground_In.size(); g++) {
+        tmp.body = ground_In[g];
+        tmp.row = ground_row_In[g];
+        tmp.blk = blk_row.size();
+        blk_row.push_back(tmp.row);
+        blk_dim.push_back(tmp.dim);
+        blk_off.push_back(off);
+        off += tmp.dim * tmp.dim;
+        inc[count[tmp.body]++] = tmp;
+    }
+    for (unsigned int i = 0; i < Joint_In.size(); i++) {
+        tmp.row = joint_row_In[i];
+        tmp.dim = Joint_In[i]->get_Cqi().n_rows;
+        tmp.blk = blk_row.size();
+        blk_row.push_back(tmp.row);
+        blk_dim.push_back(tmp.dim);
+        blk_off.push_back(off);
+        off += tmp.dim * tmp.dim;
+
+        tmp.body = Joint_In[i]->get_body_i_ptr()->get_num();
+        tmp.Cq = Joint_In[i]->get_Cqi().memptr();
+        inc[count[tmp.body]++] = tmp;
+
+        tmp.body = Joint_In[i]->get_body_j_ptr()->get_num();
+        tmp.Cq = Joint_In[i]->get_Cqj().memptr();
+        inc[count[tmp.body]++] = tmp;
+    }
+
+    kd = 0;
+    for (b = 0; b < nbody; b++) {
+        if (inc_ptr[b] == inc_ptr[b + 1]) continue;
+        lo = ncons;
+        hi = 0;
+        for (unsigned int k = inc_ptr[b]; k < inc_ptr[b + 1]; k++) {
+            lo = std::min(lo, inc[k].row);
+            hi = std::max(hi, inc[k].row + inc[k].dim - 1);
+        }
+        kd = std::max(kd, hi - lo);
+    }
+
+    P.assign(off, 0.0);
+    S.assign(ncons * (kd + 1), 0.0);
+    y.assign(ncons, 0.0);
+    lam.assign(ncons, 0.0);
+    res.assign(ncons, 0.0);
+    z.assign(ncons, 0.0);
+    dir.assign(ncons, 0.0);
+    Sd.assign(ncons, 0.0);
+}
+
+/* The band storage stays allocated, so the mode can be switched after build() */
+void Schur_Solver::set_iterative(bool iterative_In, double tol_In, unsigned int max_iter_In) {
+    iterative = iterative_In;
+    cg_tol = tol_In;
+    cg_max_iter = max_iter_In;
+}
+
+/* Forms Cq M^-1 Cq^T body by body and factors it in place, or only its
+   diagonal blocks in iterative mode. Returns false when it is not positive
+   definite (redundant or singular constraints). */
+bool Schur_Solver::factor() {
+    unsigned int i, j, k_lo, j_end;
+    double sum, d;
+
+    if (iterative) {
+        std::fill(P.begin(), P.end(), 0.0);
+    } else {
+        std::fill(S.begin(), S.end(), 0.0);
+    }
+    for (unsigned int b = 0; b < nbody; b++) {
+        const arma::mat66 &Mi = Minv[b];
+        for (unsigned int a = inc_ptr[b]; a < inc_ptr[b + 1]; a++) {
+            Incidence &A = inc[a];
+            for (unsigned int c = 0; c < 6; c++) {
+                for (unsigned int r = 0; r < A.dim; r++) {
+                    sum = 0.0;
+                    for (unsigned int m = 0; m < 6; m++) sum += A.Cq[m * A.dim + r] * Mi(m, c);
+                    A.W[c * A.dim + r] = sum;
+                }
+            }
+        }
+        if (iterative) {
+            for (unsigned int a = inc_ptr[b]; a < inc_ptr[b + 1]; a++) {
+                const Incidence &A = inc[a];
+                double *D = &P[blk_off[A.blk]];
+                for (unsigned int s = 0; s < A.dim; s++) {
+                    for (unsigned int r = s; r < A.dim; r++) {
+                        sum = 0.0;
+                        for (unsigned int m = 0; m < 6; m++) sum += A.W[m * A.dim + r] * A.Cq[m * A.dim + s];
+                        D[s * A.dim + r] += sum;
+                    }
+                }
+            }
+            continue;
+        }
+        /* Every ordered pair of blocks on this body, lower triangle only */
+        for (unsigned int a = inc_ptr[b]; a < inc_ptr[b + 1]; a++) {
+            const Incidence &A = inc[a];
+            for (unsigned int e = inc_ptr[b]; e < inc_ptr[b + 1]; e++) {
+                const Incidence &E = inc[e];
+                for (unsigned int s = 0; s < E.dim; s++) {
+                    j = E.row + s;
+                    for (unsigned int r = 0; r < A.dim; r++) {
+                        i = A.row + r;
+                        if (i < j) continue;
+                        sum = 0.0;
+                        for (unsigned int m = 0; m < 6; m++) sum += A.W[m * A.dim + r] * E.Cq[m * E.dim + s];
+                        band(i, j) += sum;
+                    }
+                }
+            }
+        }
+    }
+
+    if (iterative) return factor_blocks();
+
+    /* Banded Cholesky, L overwrites the lower band */
+    for (j = 0; j < ncons; j++) {
+        k_lo = (j > kd) ? j - kd : 0;
+        d = band(j, j);
+        for (unsigned int k = k_lo; k < j; k++) d -= band(j, k) * band(j, k);
+        if (!(d > 0.0)) return false;
+        d = std::sqrt(d);
+        band(j, j) = d;
+
+        j_end = std::min(ncons - 1, j + kd);
+        for (i = j + 1; i <= j_end; i++) {
+            sum = band(i, j);
+            for (unsigned int k = (i > kd) ? i - kd : 0; k < j; k++) sum -= band(i, k) * band(j, k);
+            band(i, j) = sum / d;
+        }
+    }
+    return true;
+}
+
+/* RHS_In = [F; GAMMA], ANS_Out = [a; lambda] in the KKT layout */
+void Schur_Solver::solve(const arma::vec &RHS_In, arma::vec &ANS_Out) {
+    unsigned int cons_off = 6 * nbody;
+    unsigned int i_end;
+    double sum;
+    double f[6];
+
+    for (unsigned int i = 0; i < ncons; i++) y[i] = -RHS_In(cons_off + i);
+    for (unsigned int k = 0; k < inc.size(); k++) {
+        const Incidence &A = inc[k];
+        for (unsigned int r = 0; r < A.dim; r++) {
+            sum = 0.0;
+            for (unsigned int m = 0; m < 6; m++) sum += A.W[m * A.dim + r] * RHS_In(A.body * 6 + m);
+            y[A.row + r] += sum;
+        }
+    }
+
+    if (iterative) {
+        pcg(ANS_Out);
+    } else {
+        /* L L^T lambda = y */
+        for (unsigned int j = 0; j < ncons; j++) {
+            y[j] /= band(j, j);
+            i_end = std::min(ncons - 1, j + kd);
+            for (unsigned int i = j + 1; i <= i_end; i++) y[i] -= band(i, j) * y[j];
+        }
+        for (unsigned int j = ncons; j-- > 0;) {
+            sum = y[j];
+            i_end = std::min(ncons - 1, j + kd);
+            for (unsigned int i = j + 1; i <= i_end; i++) sum -= band(i, j) * y[i];
+            y[j] = sum / band(j, j);
+        }
+    }
+
+    /* a = M^-1 (F - Cq^T lambda) */
+    for (unsigned int b = 0; b < nbody; b++) {
+        for (unsigned int m = 0; m < 6; m++) f[m] = RHS_In(b * 6 + m);
+        for (unsigned int k = inc_ptr[b]; k < inc_ptr[b + 1]; k++) {
+            const Incidence &A = inc[k];
+            for (unsigned int m = 0; m < 6; m++) {
+                for (unsigned int r = 0; r < A.dim; r++) f[m] -= A.Cq[m * A.dim + r] * y[A.row + r];
+            }
+        }
+        for (unsigned int r = 0; r < 6; r++) {
+            sum = 0.0;
+            for (unsigned int m = 0; m < 6; m++) sum += Minv[b](r, m) * f[m];
+            ANS_Out(b * 6 + r) = sum;
+        }
+    }
+    for (unsigned int i = 0; i < ncons; i++) ANS_Out(cons_off + i) = y[i];
+}
+
+/* In-place Cholesky of the lower triangles of the diagonal blocks */
+bool Schur_Solver::factor_blocks() {
+    unsigned int n;
+    double d, sum;
+
+    for (unsigned int k = 0; k < blk_row.size(); k++) {
+        double *D = &P[blk_off[k]];
+        n = blk_dim[k];
+        for (unsigned int j = 0; j < n; j++) {
+            d = D[j * n + j];
+            for (unsigned int m = 0; m < j; m++) d -= D[m * n + j] * D[m * n + j];
+            if (!(d > 0.0)) return false;
+            d = std::sqrt(d);
+            D[j * n + j] = d;
+            for (unsigned int i = j + 1; i < n; i++) {
+                sum = D[j * n + i];
+                for (unsigned int m = 0; m < j; m++) sum -= D[m * n + i] * D[m * n + j];
+                D[j * n + i] = sum / d;
+            }
+        }
+    }
+    return true;
+}
+
+/* y = Cq M^-1 Cq^T x, body by body: u = Cq_b^T x, then y += W u per block */
+void Schur_Solver::multiply(const std::vector<double> &x_In, std::vector<double> &y_Out) const {
+    double u[6], sum;
+
+    std::fill(y_Out.begin(), y_Out.end(), 0.0);
+    for (unsigned int b = 0; b < nbody; b++) {
+        for (unsigned int m = 0; m < 6; m++) u[m] = 0.0;
+        for (unsigned int a = inc_ptr[b]; a < inc_ptr[b + 1]; a++) {
+            const Incidence &A = inc[a];
+            for (unsigned int m = 0; m < 6; m++) {
+                for (unsigned int r = 0; r < A.dim; r++) u[m] += A.Cq[m * A.dim + r] * x_In[A.row + r];
+            }
+        }
+        for (unsigned int a = inc_ptr[b]; a < inc_ptr[b + 1]; a++) {
+            const Incidence &A = inc[a];
+            for (unsigned int r = 0; r < A.dim; r++) {
+                sum = 0.0;
+                for (unsigned int m = 0; m < 6; m++) sum += A.W[m * A.dim + r] * u[m];
+                y_Out[A.row + r] += sum;
+            }
+        }
+    }
+}
+
+/* z = D^-1 r with the block Cholesky factors */
+void Schur_Solver::precondition(const std::vector<double> &r_In, std::vector<double> &z_Out) const {
+    unsigned int n;
+    double sum;
+
+    for (unsigned int k = 0; k < blk_row.size(); k++) {
+        const double *L = &P[blk_off[k]];
+        double *x = &z_Out[blk_row[k]];
+        n = blk_dim[k];
+        for (unsigned int i = 0; i < n; i++) {
+            sum = r_In[blk_row[k] + i];
+            for (unsigned int m = 0; m < i; m++) sum -= L[m * n + i] * x[m];
+            x[i] = sum / L[i * n + i];
+        }
+        for (unsigned int i = n; i-- > 0;) {
+            sum = x[i];
+            for (unsigned int m = i + 1; m < n; m++) sum -= L[i * n + m] * x[m];
+            x[i] = sum / L[i * n + i];
+        }
+    }
+}
+
+/* Preconditioned CG on S lambda = y from the multipliers of ANS_In, the
+   solution overwrites y */
+void Schur_Solver::pcg(const arma::vec &ANS_In) {
+    const unsigned int cons_off = 6 * nbody;
+    const unsigned int max_iter = (cg_max_iter > 0) ? cg_max_iter : ncons;
+    double ynorm = 0.0, rnorm = 0.0, rz = 0.0, rz_new, dSd, alpha, beta;
+
+    for (unsigned int i = 0; i < ncons; i++) {
+        lam[i] = ANS_In(cons_off + i);
+        ynorm += y[i] * y[i];
+    }
+    ynorm = std::sqrt(ynorm);
+    multiply(lam, Sd);
+    for (unsigned int i = 0; i < ncons; i++) {
+        res[i] = y[i] - Sd[i];
+        rnorm += res[i] * res[i];
+    }
+    rnorm = std::sqrt(rnorm);
+    precondition(res, z);
+    for (unsigned int i = 0; i < ncons; i++) {
+        dir[i] = z[i];
+        rz += res[i] * z[i];
+    }
+
+    for (cg_iter = 0; cg_iter < max_iter && rnorm > cg_tol * ynorm; cg_iter++) {
+        multiply(dir, Sd);
+        dSd = 0.0;
+        for (unsigned int i = 0; i < ncons; i++) dSd += dir[i] * Sd[i];
+        if (!(dSd > 0.0)) break;  // S singular along dir
+        alpha = rz / dSd;
+        rnorm = 0.0;
+        for (unsigned int i = 0; i < ncons; i++) {
+            lam[i] += alpha * dir[i];
+            res[i] -= alpha * Sd[i];
+            rnorm += res[i] * res[i];
+        }
+        rnorm = std::sqrt(rnorm);
+        precondition(res, z);
+        rz_new = 0.0;
+        for (unsigned int i = 0; i < ncons; i++) rz_new += res[i] * z[i];
+        beta = rz_new / rz;
+        rz = rz_new;
+        for (unsigned int i = 0; i < ncons; i++) dir[i] = z[i] + beta * dir[i];
+    }
+    cg_res = (ynorm > 0.0) ? rnorm / ynorm : rnorm;
+    y.swap(lam);
+}
+
+unsigned int Schur_Solver::get_bandwidth() const { return kd; }
+bool Schur_Solver::is_iterative() const { return iterative; }
+unsigned int Schur_Solver::get_iterations() const { return cg_iter; }
+double Schur_Solver::get_residual() const { return cg_res; }
+
+/* (max L_jj / min L_jj)^2, a cheap lower bound on cond(Cq M^-1 Cq^T);
+   0 in iterative mode, which forms no global factor */
+double Schur_Solver::pivot_ratio() const {
+    double lo = 0.0, hi = 0.0, d;
+
+    if (iterative) return 0.0;
+    for (unsigned int j = 0; j < ncons; j++) {
+        d = S[j * (kd + 1)];
+        if (j == 0 || d < lo) lo = d;
+        if (j == 0 || d > hi) hi = d;
+    }
+    return (lo > 0.0) ? (hi / lo) * (hi / lo) : 0.0;
+}
@@ -0,0 +1,167 @@
+#include "Sparse_LDL.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+Sparse_LDL::Sparse_LDL() {
+    n = 0;
+}
+
+void Sparse_LDL::set_pattern(unsigned int n_In, const std::vector<unsigned int> &rows_In,
+        const std::vector<unsigned int> &cols_In) {
+    std::vector<std::pair<unsigned int, unsigned int> > entries;
+
+    n = n_In;
+    for (unsigned int k = 0; k < rows_In.size(); k++) {
+        entries.push_back(std::make_pair(cols_In[k], rows_In[k]));
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    Ap.assign(n + 1, 0);
+    Ai.resize(entries.size());
+    for (unsigned int k = 0; k < entries.size(); k++) {
+        Ap[entries[k].first + 1]++;
+        Ai[k] = entries[k].second;
+    }
+    for (unsigned int k = 0; k < n; k++) Ap[k + 1] += Ap[k];
+    Ax.assign(entries.size(), 0.0);
+
+    P.resize(n);
+    Pinv.resize(n);
+    for (unsigned int k = 0; k < n; k++) {
+        P[k] = k;
+        Pinv[k] = k;
+    }
+}
+
+void Sparse_LDL::set_order(const std::vector<unsigned int> &P_In) {
+    P = P_In;
+    for (unsigned int k = 0; k < n; k++) Pinv[P[k]] = k;
+}
+
+/* Symbolic factorization: elimination tree and nonzero count of each column of L */
+void Sparse_LDL::analyze() {
+    unsigned int i, kk;
+
+    Lp.assign(n + 1, 0);
+    Parent.assign(n, -1);
+    Lnz.assign(n, 0);
+    Flag.assign(n, 0);
+    Pattern.assign(n, 0);
+    Y.assign(n, 0.0);
+    D.assign(n, 0.0);
+
+    for (unsigned int k = 0; k < n; k++) {
+        Flag[k] = k;
+        kk = P[k];
+        for (unsigned int p = Ap[kk]; p < Ap[kk + 1]; p++) {
+            i = Pinv[Ai[p]];
+            if (i < k) {
+                for (; Flag[i] != k; i = Parent[i]) {
+                    if (Parent[i] == -1) Parent[i] = k;
+                    Lnz[i]++;
+                    Flag[i] = k;
+                }
+            }
+        }
+    }
+
+    for (unsigned int k = 0; k < n; k++) Lp[k + 1] = Lp[k] + Lnz[k];
+    Li.assign(Lp[n], 0);
+    Lx.assign(Lp[n], 0.0);
+}
+
+/* Numeric factorization on the analysed pattern, returns false on a zero pivot */
+bool Sparse_LDL::factor() {
+    unsigned int i, kk, len, top, p2;
+    double yi, l_ki;
+
+    for (unsigned int k = 0; k < n; k++) {
+        Y[k] = 0.0;
+        top = n;
+        Flag[k] = k;
+        Lnz[k] = 0;
+        kk = P[k];
+        for (unsigned int p = Ap[kk]; p < Ap[kk + 1]; p++) {
+            i = Pinv[Ai[p]];
+            if (i <= k) {
+                Y[i] += Ax[p];
+                for (len = 0; Flag[i] != k; i = Parent[i]) {
+                    Pattern[len++] = i;
+                    Flag[i] = k;
+                }
+                while (len > 0) Pattern[--top] = Pattern[--len];
+            }
+        }
+
+        D[k] = Y[k];
+        Y[k] = 0.0;
+        for (; top < n; top++) {
+            i = Pattern[top];
+            yi = Y[i];
+            Y[i] = 0.0;
+            p2 = Lp[i] + Lnz[i];
+            for (unsigned int p = Lp[i]; p < p2; p++) {
+                Y[Li[p]] -= Lx[p] * yi;
+            }
+            l_ki = yi / D[i];
+            D[k] -= l_ki * yi;
+            Li[p2] = k;
+            Lx[p2] = l_ki;
+            Lnz[i]++;
+        }
+        if (D[k] == 0.0) return false;
+    }
+    return true;
+}
+
+/* Solve A x = b in place with the current factors */
+void Sparse_LDL::solve(arma::vec &x) {
+    for (unsigned int k = 0; k < n; k++) Y[k] = x(P[k]);
+
+    for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int p = Lp[j]; p < Lp[j + 1]; p++) Y[Li[p]] -= Lx[p] * Y[j];
+    }
+    for (unsigned int j = 0; j < n; j++) Y[j] /= D[j];
+    for (unsigned int j = n; j-- > 0;) {
+        for (unsigned int p = Lp[j]; p < Lp[j + 1]; p++) Y[j] -= Lx[p] * Y[Li[p]];
+    }
+
+    for (unsigned int k = 0; k < n; k++) {
+        x(P[k]) = Y[k];
+        Y[k] = 0.0;
+    }
+}
+
+void Sparse_LDL::multiply(const arma::vec &x, arma::vec &y) const {
+    y.zeros();
+    for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int p = Ap[j]; p < Ap[j + 1]; p++) y(Ai[p]) += Ax[p] * x(j);
+    }
+}
+
+/* Position of entry (row, col) in values(), the entry must be in the pattern */
+unsigned int Sparse_LDL::index(unsigned int row, unsigned int col) {
+    std::vector<unsigned int>::iterator it;
+
+    it = std::lower_bound(Ai.begin() + Ap[col], Ai.begin() + Ap[col + 1], row);
+    return it - Ai.begin();
+}
+
+std::vector<double> &Sparse_LDL::values() { return Ax; }
+unsigned int Sparse_LDL::get_n() { return n; }
+unsigned int Sparse_LDL::get_nnz() { return Ap.empty() ? 0 : Ap[n]; }
+unsigned int Sparse_LDL::get_L_nnz() { return Lp.empty() ? 0 : Lp[n]; }
+
+/* max|D| / min|D| of the last factorization, a cheap conditioning indicator */
+double Sparse_LDL::pivot_ratio() const {
+    double d_max = 0.0, d_min = 0.0, d;
+
+    for (unsigned int k = 0; k < D.size(); k++) {
+        d = std::fabs(D[k]);
+        if (k == 0 || d > d_max) d_max = d;
+        if (k == 0 || d < d_min) d_min = d;
+    }
+    return (d_min > 0.0) ? d_max / d_min : 0.0;
+}
@@ -0,0 +1,66 @@
+#include "Thread_Pool.hpp"
+#include <algorithm>
+
+Thread_Pool::Thread_Pool(unsigned int nthreads_In) : next(0), busy(0) {
+    generation = 0;
+    quit = false;
+    job_fn = nullptr;
+    job_ctx = nullptr;
+    job_n = 0;
+    job_chunk = 1;
+
+    if (nthreads_In == 0) nthreads_In = std::thread::hardware_concurrency();
+    for (unsigned int w = 1; w < nthreads_In; w++) workers.emplace_back(&Thread_Pool::Worker_Loop, this);
+}
+
+Thread_Pool::~Thread_Pool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_all();
+    for (unsigned int w = 0; w < workers.size(); w++) workers[w].join();
+}
+
+unsigned int Thread_Pool::get_nthreads() const { return workers.size() + 1; }
+
+/* About four chunks per thread keeps the tail short when ranges are uneven */
+void Thread_Pool::Dispatch(unsigned int n_In, Range_Fn fn_In, void *ctx_In) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job_fn = fn_In;
+        job_ctx = ctx_In;
+        job_n = n_In;
+        job_chunk = std::max(1u, n_In / (4 * get_nthreads()));
+        next.store(0);
+        busy.store(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    Run_Chunks();
+    while (busy.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+}
+
+void Thread_Pool::Worker_Loop() {
+    unsigned long seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+        Run_Chunks();
+        busy.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void Thread_Pool::Run_Chunks() {
+    unsigned int begin;
+
+    while ((begin = next.fetch_add(job_chunk)) < job_n) {
+        job_fn(job_ctx, begin, std::min(job_n, begin + job_chunk));
+    }
+}
@@ -0,0 +1,215 @@
+#include "Topology.hpp"
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+Topology::Topology() {
+    nbody = 0;
+    njoint = 0;
+    nloop = 0;
+    grounded = true;
+}
+
+void Topology::build(const std::vector<BodyPtr> &Body_In, const std::vector<JointPtr> &Joint_In) {
+    unsigned int a, b, k, start, ecc, ecc_next, next;
+    std::vector<bool> placed;
+    std::vector<int> level;
+    std::vector<unsigned int> nbr, reached;
+    std::queue<unsigned int> open;
+
+    nbody = Body_In.size();
+    njoint = Joint_In.size();
+    joint_i.clear();
+    joint_j.clear();
+    joint_dim.clear();
+    adj_ptr.assign(nbody + 1, 0);
+    for (unsigned int i = 0; i < njoint; i++) {
+        joint_i.push_back(Joint_In[i]->get_body_i_ptr()->get_num());
+        joint_j.push_back(Joint_In[i]->get_body_j_ptr()->get_num());
+        joint_dim.push_back(Joint_In[i]->get_Cqi().n_rows);
+        adj_ptr[joint_i[i] + 1]++;
+        adj_ptr[joint_j[i] + 1]++;
+    }
+    for (unsigned int i = 0; i < nbody; i++) adj_ptr[i + 1] += adj_ptr[i];
+    adj_joint.assign(adj_ptr[nbody], 0);
+    nbr = adj_ptr;
+    for (unsigned int i = 0; i < njoint; i++) {
+        adj_joint[nbr[joint_i[i]]++] = i;
+        adj_joint[nbr[joint_j[i]]++] = i;
+    }
+
+    ground.clear();
+    for (unsigned int i = 0; i < nbody; i++) {
+        if (Body_In[i]->get_type() == 0) ground.push_back(i);
+    }
+
+    /* Spanning forest breadth-first from all grounds at once; a component
+       without a ground is rooted at its lowest body, which stays where it
+       was built */
+    placed.assign(nbody, false);
+    tree_joint.clear();
+    tree_body.clear();
+    grounded = true;
+    for (unsigned int g = 0; g < ground.size(); g++) {
+        placed[ground[g]] = true;
+        open.push(ground[g]);
+    }
+    for (unsigned int s = 0; s <= nbody; s++) {
+        while (!open.empty()) {
+            a = open.front();
+            open.pop();
+            for (unsigned int p = adj_ptr[a]; p < adj_ptr[a + 1]; p++) {
+                k = adj_joint[p];
+                b = (joint_i[k] == a) ? joint_j[k] : joint_i[k];
+                if (placed[b]) continue;
+                placed[b] = true;
+                tree_joint.push_back(k);
+                tree_body.push_back(b);
+                open.push(b);
+            }
+        }
+        if (s < nbody && !placed[s]) {
+            grounded = false;
+            placed[s] = true;
+            open.push(s);
+        }
+    }
+    nloop = njoint - tree_joint.size();
+
+    /* Cuthill-McKee per component, from a pseudo-peripheral body found by
+       repeated breadth-first searches (George & Liu); grounds seed first */
+    order.clear();
+    position.assign(nbody, 0);
+    level.assign(nbody, -1);
+    placed.assign(nbody, false);
+    for (unsigned int s = 0; s < ground.size() + nbody; s++) {
+        start = (s < ground.size()) ? ground[s] : s - ground.size();
+        if (placed[start]) continue;
+
+        ecc = bfs(start, level, reached);
+        while (true) {
+            /* Lowest degree body of the last level, which ends reached */
+            next = reached.back();
+            for (unsigned int m = reached.size(); m-- > 0 && level[reached[m]] == static_cast<int>(ecc);) {
+                a = reached[m];
+                if (adj_ptr[a + 1] - adj_ptr[a] <= adj_ptr[next + 1] - adj_ptr[next]) next = a;
+            }
+            if (next == start) break;
+            ecc_next = bfs(next, level, reached);
+            if (ecc_next <= ecc) break;
+            start = next;
+            ecc = ecc_next;
+        }
+
+        /* Neighbours are queued by ascending degree */
+        placed[start] = true;
+        open.push(start);
+        while (!open.empty()) {
+            a = open.front();
+            open.pop();
+            position[a] = order.size();
+            order.push_back(a);
+            nbr.clear();
+            for (unsigned int p = adj_ptr[a]; p < adj_ptr[a + 1]; p++) {
+                k = adj_joint[p];
+                b = (joint_i[k] == a) ? joint_j[k] : joint_i[k];
+                if (placed[b]) continue;
+                placed[b] = true;
+                nbr.push_back(b);
+            }
+            std::stable_sort(nbr.begin(), nbr.end(), [this](unsigned int x, unsigned int y) {
+                return adj_ptr[x + 1] - adj_ptr[x] < adj_ptr[y + 1] - adj_ptr[y];
+            });
+            for (unsigned int m = 0; m < nbr.size(); m++) open.push(nbr[m]);
+        }
+    }
+}
+
+/* Levels of start_In's component in level_Out, the bodies in breadth-first
+   order in reached_InOut; the levels of the previous search (the bodies in
+   reached_InOut on entry) are reset first, so a search costs the size of
+   the component. Returns the eccentricity of start_In. */
+unsigned int Topology::bfs(unsigned int start_In, std::vector<int> &level_Out,
+        std::vector<unsigned int> &reached_InOut) const {
+    unsigned int a, b, k;
+
+    for (unsigned int m = 0; m < reached_InOut.size(); m++) level_Out[reached_InOut[m]] = -1;
+    reached_InOut.clear();
+    level_Out[start_In] = 0;
+    reached_InOut.push_back(start_In);
+    for (unsigned int m = 0; m < reached_InOut.size(); m++) {
+        a = reached_InOut[m];
+        for (unsigned int p = adj_ptr[a]; p < adj_ptr[a + 1]; p++) {
+            k = adj_joint[p];
+            b = (joint_i[k] == a) ? joint_j[k] : joint_i[k];
+            if (level_Out[b] >= 0) continue;
+            level_Out[b] = level_Out[a] + 1;
+            reached_InOut.push_back(b);
+        }
+    }
+    return level_Out[reached_InOut.back()];
+}
+
+unsigned int Topology::constraint_rows(std::vector<unsigned int> &ground_row_Out,
+        std::vector<unsigned int> &joint_row_Out) const {
+    unsigned int row = 0, code;
+    std::vector<std::pair<unsigned int, unsigned int> > blocks;
+
+    /* (later body, code): codes below ground.size() are grounds, so a
+       ground's rows come before the joints of the same body */
+    for (unsigned int g = 0; g < ground.size(); g++) blocks.push_back(std::make_pair(position[ground[g]], g));
+    for (unsigned int i = 0; i < njoint; i++) {
+        blocks.push_back(std::make_pair(std::max(position[joint_i[i]], position[joint_j[i]]), ground.size() + i));
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    ground_row_Out.assign(ground.size(), 0);
+    joint_row_Out.assign(njoint, 0);
+    for (unsigned int k = 0; k < blocks.size(); k++) {
+        code = blocks[k].second;
+        if (code < ground.size()) {
+            ground_row_Out[code] = row;
+            row += 6;
+        } else {
+            joint_row_Out[code - ground.size()] = row;
+            row += joint_dim[code - ground.size()];
+        }
+    }
+    return row;
+}
+
+void Topology::kkt_order(const std::vector<unsigned int> &ground_row_In, const std::vector<unsigned int> &joint_row_In,
+        std::vector<unsigned int> &P_Out) const {
+    const unsigned int cons_off = 6 * nbody;
+    unsigned int b, next = 0;
+    std::vector<std::pair<std::pair<unsigned int, unsigned int>, unsigned int> > blocks;
+
+    /* ((rank of the last body in reverse order, first row), rows) */
+    for (unsigned int g = 0; g < ground.size(); g++) {
+        blocks.push_back(std::make_pair(std::make_pair(nbody - 1 - position[ground[g]], ground_row_In[g]), 6u));
+    }
+    for (unsigned int i = 0; i < njoint; i++) {
+        b = std::min(position[joint_i[i]], position[joint_j[i]]);
+        blocks.push_back(std::make_pair(std::make_pair(nbody - 1 - b, joint_row_In[i]), joint_dim[i]));
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    P_Out.clear();
+    for (unsigned int k = 0; k < nbody; k++) {
+        b = order[nbody - 1 - k];
+        for (unsigned int c = 0; c < 6; c++) P_Out.push_back(6 * b + c);
+        for (; next < blocks.size() && blocks[next].first.first == k; next++) {
+            for (unsigned int r = 0; r < blocks[next].second; r++) {
+                P_Out.push_back(cons_off + blocks[next].first.second + r);
+            }
+        }
+    }
+}
+
+bool Topology::is_tree() const { return nloop == 0; }
+bool Topology::is_grounded() const { return grounded; }
+unsigned int Topology::get_nloop() const { return nloop; }
+const std::vector<unsigned int> &Topology::get_ground() const { return ground; }
+const std::vector<unsigned int> &Topology::get_body_order() const { return order; }
+const std::vector<unsigned int> &Topology::get_tree_joint() const { return tree_joint; }
+const std::vector<unsigned int> &Topology::get_tree_body() const { return tree_body; }
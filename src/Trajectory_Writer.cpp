@@ -0,0 +1,206 @@
+#include "Trajectory_Writer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static_assert(sizeof(Traj_Header) == 64, "trajectory header must stay 64 bytes");
+
+namespace {
+
+const unsigned int CHUNK_BYTES = 1 << 20;
+
+/* Record width and State_Slot offset of each Traj_Field bit */
+const unsigned int FIELD_BITS[4] = {TRAJ_POS, TRAJ_VEL, TRAJ_QUAT, TRAJ_ANG_VEL};
+const unsigned int FIELD_SLOT[4] = {STATE_POS, STATE_VEL, STATE_QUAT, STATE_ANG_VEL};
+const unsigned int FIELD_WIDTH[4] = {3, 3, 4, 3};
+
+}  // namespace
+
+Trajectory_Writer::Trajectory_Writer() {
+    std::memset(&header, 0, sizeof(header));
+    lambda_off = 0;
+    mode = TRAJ_BUFFERED;
+    decimation = 1;
+    ncall = 0;
+    chunk_records = 0;
+    is_open = false;
+    chunk_fill = 0;
+    fd = -1;
+    map = nullptr;
+    map_bytes = 0;
+}
+
+Trajectory_Writer::~Trajectory_Writer() { close(); }
+
+bool Trajectory_Writer::open(const std::string &file_In, const Dynamics_Sys &sys_In, unsigned int field_mask_In,
+        unsigned int decimation_In, Traj_Mode mode_In) {
+    unsigned int width = 0;
+
+    close();
+    table.clear();
+    for (unsigned int i = 0; i < sys_In.get_nbody(); i++) {
+        if (sys_In.get_body(i)->get_type() != 0) table.push_back(sys_In.get_body(i)->get_num());
+    }
+    for (unsigned int f = 0; f < 4; f++) {
+        if (field_mask_In & FIELD_BITS[f]) width += FIELD_WIDTH[f];
+    }
+    if ((width == 0 && !(field_mask_In & TRAJ_LAMBDA)) || table.empty()) {
+        std::cerr << "Trajectory_Writer: nothing to write" << std::endl;
+        return false;
+    }
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "MBDTRAJ", 8);
+    header.version = TRAJ_VERSION;
+    header.nbody = table.size();
+    header.field_mask = field_mask_In;
+    header.nlambda = (field_mask_In & TRAJ_LAMBDA) ? sys_In.get_ncons() : 0;
+    header.stride = 1 + header.nbody * width + header.nlambda;
+    header.njoint = sys_In.get_njoint();
+    for (unsigned int i = 0; i < header.njoint; i++) table.push_back(sys_In.get_joint_row(i));
+    if (table.size() % 2) table.push_back(0);
+    header.data_offset = sizeof(header) + 4 * table.size();
+    lambda_off = 6 * sys_In.get_nbody();
+    decimation = (decimation_In == 0) ? 1 : decimation_In;
+    header.dt = sys_In.get_dt() * decimation;
+    header.nrecords = 0;
+
+    mode = mode_In;
+    ncall = 0;
+    chunk_records = std::max(1u, CHUNK_BYTES / (8 * header.stride));
+
+    if (mode == TRAJ_MMAP) {
+        fd = ::open(file_In.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || !Map_Capacity(chunk_records)) {
+            std::cerr << "Trajectory_Writer: mmap of " << file_In << " failed, writing buffered" << std::endl;
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+            mode = TRAJ_BUFFERED;
+        } else {
+            std::memcpy(map + sizeof(header), table.data(), 4 * table.size());
+        }
+    }
+    if (mode == TRAJ_BUFFERED) {
+        fout.open(file_In, std::ios::binary | std::ios::trunc);
+        if (!fout) {
+            std::cerr << "Trajectory_Writer: cannot open " << file_In << std::endl;
+            return false;
+        }
+        fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        fout.write(reinterpret_cast<const char *>(table.data()), 4 * table.size());
+        chunk.assign(chunk_records * header.stride, 0.0);
+        chunk_fill = 0;
+    }
+    is_open = true;
+    return true;
+}
+
+/* Appends one record every decimation calls */
+void Trajectory_Writer::write(const Dynamics_Sys &sys_In) {
+    double *rec;
+
+    if (!is_open || (ncall++ % decimation) != 0) return;
+
+    rec = Next_Record();
+    if (rec == nullptr) return;
+    pack(sys_In, rec);
+    header.nrecords++;
+}
+
+/* Appends a record packed earlier by pack(), without decimation */
+void Trajectory_Writer::write_record(const double *record_In) {
+    double *rec;
+
+    if (!is_open) return;
+    rec = Next_Record();
+    if (rec == nullptr) return;
+    std::memcpy(rec, record_In, sizeof(double) * header.stride);
+    header.nrecords++;
+}
+
+/* Fills get_stride() doubles; reads only the layout fixed by open() */
+void Trajectory_Writer::pack(const Dynamics_Sys &sys_In, double *record_Out) const {
+    const arma::vec &q = sys_In.get_state();
+    unsigned int k = 1;
+
+    record_Out[0] = sys_In.get_time();
+    for (unsigned int b = 0; b < header.nbody; b++) {
+        const unsigned int base = table[b] * STATE_SIZE;
+        for (unsigned int f = 0; f < 4; f++) {
+            if (!(header.field_mask & FIELD_BITS[f])) continue;
+            for (unsigned int m = 0; m < FIELD_WIDTH[f]; m++) record_Out[k++] = q(base + FIELD_SLOT[f] + m);
+        }
+    }
+    if (header.nlambda > 0) {
+        const arma::vec &ans = sys_In.get_SYS_ANS();
+        for (unsigned int m = 0; m < header.nlambda; m++) record_Out[k++] = ans(lambda_off + m);
+    }
+}
+
+/* Truncates the file to the records written and patches the header */
+void Trajectory_Writer::close() {
+    if (!is_open) return;
+    is_open = false;
+
+    if (mode == TRAJ_MMAP) {
+        if (map != nullptr) {
+            std::memcpy(map, &header, sizeof(header));
+            munmap(map, map_bytes);
+        } else if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            std::cerr << "Trajectory_Writer: header write failed" << std::endl;
+        }
+        map = nullptr;
+        map_bytes = 0;
+        if (ftruncate(fd, header.data_offset + header.nrecords * header.stride * 8) != 0) {
+            std::cerr << "Trajectory_Writer: truncate failed" << std::endl;
+        }
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+    Flush_Chunk();
+    fout.seekp(0);
+    fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    fout.close();
+    chunk.clear();
+}
+
+uint64_t Trajectory_Writer::get_nrecords() const { return header.nrecords; }
+unsigned int Trajectory_Writer::get_stride() const { return header.stride; }
+
+double *Trajectory_Writer::Next_Record() {
+    if (mode == TRAJ_MMAP) {
+        if (header.data_offset + (header.nrecords + 1) * header.stride * 8 > map_bytes
+            && !Map_Capacity(2 * (header.nrecords + chunk_records))) {
+            std::cerr << "Trajectory_Writer: cannot grow mapping, record dropped" << std::endl;
+            return nullptr;
+        }
+        return reinterpret_cast<double *>(map + header.data_offset) + header.nrecords * header.stride;
+    }
+    if (chunk_fill == chunk_records) Flush_Chunk();
+    return &chunk[chunk_fill++ * header.stride];
+}
+
+/* Grow the file to hold nrec_In records and map all of it */
+bool Trajectory_Writer::Map_Capacity(uint64_t nrec_In) {
+    uint64_t bytes = header.data_offset + nrec_In * header.stride * 8;
+    void *p;
+
+    if (map != nullptr) munmap(map, map_bytes);
+    map = nullptr;
+    if (ftruncate(fd, bytes) != 0) return false;
+    p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    map = static_cast<char *>(p);
+    map_bytes = bytes;
+    return true;
+}
+
+void Trajectory_Writer::Flush_Chunk() {
+    if (chunk_fill == 0) return;
+    fout.write(reinterpret_cast<const char *>(chunk.data()), sizeof(double) * chunk_fill * header.stride);
+    chunk_fill = 0;
+}
@@ -40,27 +40,23 @@ int main(int argc, char const *argv[])
     arma::vec T = {0., 0., 0.};
     arma::vec T1 = {0., 0., 0.};
 
-    Ground_Body = boost::make_shared<Ground>(0);
-    Body_1 = boost::make_shared<Mobilized_body>(1, POS, VEL, ACC, ANG, ANG_VEL, ANG_ACC, mass, I, F, T);
-    Rev_joint_1 = boost::make_shared<Joint>(0, pi, pj, qi, qj, Ground_Body, Body_1);
-    sys->Add(Ground_Body);
-    sys->Add(Body_1);
-    sys->Add(Rev_joint_1);
+    /* Create() allocates in the system's arena and adds the object */
+    Ground_Body = sys->Create<Ground>(0);
+    Body_1 = sys->Create<Mobilized_body>(1, POS, VEL, ACC, ANG, ANG_VEL, ANG_ACC, mass, I, F, T);
+    Rev_joint_1 = sys->Create<Spherical_Joint>(pi, pj, qi, qj, Ground_Body, Body_1);
     
     Body_prev = Body_1;
     for (unsigned int i = 0; i < 10; i++) {
-        Body_now = boost::make_shared<Mobilized_body>(i + 2, POS, VEL1, ACC, ANG1, ANG_VEL1, ANG_ACC, mass, I, F, T);
-        Rev_joint = boost::make_shared<Joint>(0, pi, pj, qi, qj, Body_prev, Body_now);
+        Body_now = sys->Create<Mobilized_body>(i + 2, POS, VEL1, ACC, ANG1, ANG_VEL1, ANG_ACC, mass, I, F, T);
+        Rev_joint = sys->Create<Spherical_Joint>(pi, pj, qi, qj, Body_prev, Body_now);
 
-        sys->Add(Body_now);
-        sys->Add(Rev_joint);
         Body_prev = Body_now;
     }
     sys->Assembly();
     sys->init();
 
     for (unsigned int i = 0; i < 50000; i++) {
-        sys->solve();
+        if (!sys->solve()) break;
         
         time += 0.001;
 
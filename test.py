@@ -4,7 +4,9 @@ from matplotlib.backends.backend_qt5agg import FigureCanvasQTAgg as FigureCanvas
 from PyQt5 import QtCore, QtWidgets, QtGui
 import matplotlib.pyplot as plt
 import sys
+import numpy as np
 import pandas as pd
+import read_traj
 from mpl_toolkits.mplot3d import Axes3D
 
 class plot_window(QtWidgets.QDialog):
@@ -33,8 +35,12 @@ class plot_window(QtWidgets.QDialog):
         self.i = 1
 
     def import_csv(self):
-        self.fileName_choose, self.filetype = QtWidgets.QFileDialog.getOpenFileName(self, "Find Files", QtCore.QDir.currentPath(), 'CSV (*.csv)')
-        self.csv = pd.read_csv(self.fileName_choose, sep='\s+')
+        self.fileName_choose, self.filetype = QtWidgets.QFileDialog.getOpenFileName(self, "Find Files", QtCore.QDir.currentPath(), 'CSV (*.csv);;Trajectory (*.traj)')
+        if self.fileName_choose.endswith('.traj'):
+            header, records = read_traj.read_traj(self.fileName_choose)
+            self.csv = pd.DataFrame(np.column_stack((records[:, 0], read_traj.field(header, records, 'pos').reshape(len(records), -1))))
+        else:
+            self.csv = pd.read_csv(self.fileName_choose, sep='\s+')
         self.nbody = int(((len(self.csv.columns) - 1) / 3))
         self.timeticks = int(len(self.csv))
         